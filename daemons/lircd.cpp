@@ -53,11 +53,21 @@
 #include <fcntl.h>
 #include <sys/file.h>
 #include <pwd.h>
+#include <stdint.h>
+#include <poll.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+#ifdef HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#endif
 
 #if defined(__linux__)
 #include <linux/input.h>
 #include <linux/uinput.h>
 #include "lirc/input_map.h"
+#include "uinput_batch.h"
 #endif
 
 #ifdef HAVE_SYSTEMD
@@ -69,6 +79,7 @@
 #endif
 
 #include "lirc_private.h"
+#include "lirc_client.h"
 
 /****************************************************************************
 ** lircd.h *****************************************************************
@@ -119,7 +130,13 @@ static const char* const help =
 	"\t -u --uinput\t\t\tgenerate Linux input events\n"
 #       endif
 	"\t -e --effective-uid=uid\t\tRun as uid after init as root\n"
-	"\t -R --repeat-max=limit\t\tallow at most this many repeats\n";
+	"\t -R --repeat-max=limit\t\tallow at most this many repeats\n"
+	"\t -b --rec-buffer=items\t\tMax length of a received signal\n"
+	"\t -q --queue-size=bytes\t\tOutput queue size per client\n"
+	"\t -Q --queue-overflow=policy\tdrop, disconnect or coalesce\n"
+	"\t -C --config-cache=file\t\tCompiled config cache\n"
+	"\t -M --adaptive-order\t\tTry recently used remotes first\n"
+	"\t -B --async-log\t\t\tWrite log messages when idle\n";
 
 
 static const struct option lircd_options[] = {
@@ -147,6 +164,12 @@ static const struct option lircd_options[] = {
 	{ "uinput",	    no_argument,       NULL, 'u' },
 #        endif
 	{ "repeat-max",	    required_argument, NULL, 'R' },
+	{ "rec-buffer",	    required_argument, NULL, 'b' },
+	{ "queue-size",	    required_argument, NULL, 'q' },
+	{ "queue-overflow", required_argument, NULL, 'Q' },
+	{ "config-cache",   required_argument, NULL, 'C' },
+	{ "adaptive-order", no_argument,       NULL, 'M' },
+	{ "async-log",	    no_argument,       NULL, 'B' },
 	{ 0,		    0,		       0,    0	 }
 };
 
@@ -163,6 +186,8 @@ static int send_start(int fd, char* message, char* arguments);
 static int send_stop(int fd, char* message, char* arguments);
 static int send_core(int fd, char* message, char* arguments, int once);
 static int version(int fd, char* message, char* arguments);
+static int set_event_format(int fd, char* message, char* arguments);
+static int decode_stats(int fd, char* message, char* arguments);
 
 struct protocol_directive {
 	const char* name;
@@ -186,8 +211,6 @@ struct protocol_directive {
 static struct ir_remote* remotes;
 static struct ir_remote* free_remotes = NULL;
 
-static int repeat_fd = -1;
-static char* repeat_message = NULL;
 static __u32 repeat_max = REPEAT_MAX_DEFAULT;
 
 static const char* configfile = NULL;
@@ -205,6 +228,8 @@ static const struct protocol_directive directives[] = {
 	{ "VERSION",	      version	       },
 	{ "SET_TRANSMITTERS", set_transmitters },
 	{ "SIMULATE",	      simulate	       },
+	{ "SET_EVENT_FORMAT", set_event_format },
+	{ "DECODE_STATS",     decode_stats     },
 	{ NULL,		      NULL	       }
 	/*
 	 * {"DEBUG",debug},
@@ -232,13 +257,17 @@ static const char* const protocol_string[] = {
 
 /* substract one for lirc, sockfd, sockinet, logfile, pidfile, uinput */
 #define MAX_PEERS       ((FD_SETSIZE - 6) / 2)
-#define MAX_CLIENTS     ((FD_SETSIZE - 6) / 2)
+
+/* Max number of events handled per wakeup of the event loop. */
+#define MAX_EVENTS      64
 
 static int sockfd, sockinet;
 static int do_shutdown;
 
 static int uinputfd = -1;
-static int clis[MAX_CLIENTS];
+#if defined(__linux__)
+static struct uinput_batch uinput_out;
+#endif
 
 static int nodaemon = 0;
 static loglevel_t loglevel_opt = LIRC_NOLOG;
@@ -246,8 +275,123 @@ static loglevel_t loglevel_opt = LIRC_NOLOG;
 #define CT_LOCAL  1
 #define CT_REMOTE 2
 
-static int cli_type[MAX_CLIENTS];
-static int clin = 0; /* Number of clients */
+/* Kinds of queued output, see client_write(). */
+#define OUT_REPLY 0     /* Part of a reply packet, never dropped */
+#define OUT_EVENT 1     /* Broadcast event, might be dropped */
+
+/* What to do when a client's output queue is full (--queue-overflow). */
+#define OVERFLOW_DROP           0       /* Drop oldest queued events */
+#define OVERFLOW_DISCONNECT     1       /* Remove the client */
+#define OVERFLOW_COALESCE       2       /* Merge repeats, then drop */
+
+static const char* const overflow_policies[] = {
+	"drop", "disconnect", "coalesce", NULL
+};
+
+static unsigned int queue_size = 16384; /* Power of two */
+static int queue_overflow = OVERFLOW_DROP;
+
+/** Header of each unit in a client output queue. */
+struct out_unit {
+	unsigned int	len;
+	unsigned int	kind;   /**< OUT_REPLY or OUT_EVENT */
+};
+
+/** Bounded output ring of a client, flushed when the socket is writable. */
+struct out_queue {
+	char*		buf;    /**< queue_size bytes, allocated on demand */
+	unsigned int	head;   /**< Start of first unit, free running */
+	unsigned int	tail;   /**< End of last unit, free running */
+	unsigned int	last;   /**< Start of last unit */
+	unsigned int	sent;   /**< Bytes of first unit already written */
+};
+
+/** A connected client, see add_client(). */
+struct client {
+	int		fd;
+	int		type;   /**< CT_LOCAL, CT_REMOTE or 0 */
+	struct out_queue out;
+	int		binary;         /**< Uses binary event protocol */
+	unsigned char*	names_sent;     /**< Bitmap of name IDs sent */
+	unsigned int	names_sent_size;
+	char		in[PACKET_SIZE + 1];    /**< Unprocessed input */
+	int		in_len;
+};
+
+/*
+ * Remote and button names of the binary event protocol get an ID when
+ * first used. IDs are never reused, a name keeps its ID across config
+ * reloads.
+ */
+static char** names = NULL;             /* Name by ID */
+static unsigned int names_n = 0;
+static unsigned int names_size = 0;
+static unsigned int* name_index = NULL; /* Hash table of ID + 1 */
+static unsigned int name_index_size = 0;
+
+static struct client* clis = NULL;
+static int clis_size = 0;       /* Allocated size of clis[] */
+static int clin = 0;            /* Number of clients */
+static int resumed_input = 0;   /* A client with buffered input resumed */
+
+/* Type of a file descriptor registered in the event loop. */
+#define WATCH_NONE   0
+#define WATCH_LISTEN 1
+#define WATCH_DRIVER 2
+#define WATCH_CLIENT 3
+#define WATCH_PEER   4
+#define WATCH_TIMER  5
+
+/** Event loop bookkeeping for a file descriptor, indexed by fd. */
+struct fd_entry {
+	int	watch;          /**< WATCH_* type registered in the poll set */
+	int	output;         /**< Poll for POLLOUT too */
+	int	paused;         /**< Don't poll for POLLIN */
+	int	client;         /**< Index in clis[] or -1 */
+#ifndef HAVE_SYS_EPOLL_H
+	int	pollidx;        /**< Index in pollfds[] or -1 */
+#endif
+};
+
+static struct fd_entry* fds = NULL;
+static int fds_size = 0;
+
+#define READY_IN        1       /* Readable, hangup or error */
+#define READY_OUT       2       /* Writable */
+
+/** A file descriptor reported by poll_wait(). */
+struct ready_fd {
+	int	fd;
+	int	what;   /**< READY_* flags */
+};
+
+/** A deadline in the event loop, backed by a timerfd if available. */
+struct event_timer {
+	struct timeval	when;   /**< Absolute expiry time, cleared if unset */
+	int		fd;     /**< timerfd or -1 */
+};
+
+static struct event_timer release_timer = { { 0, 0 }, -1 };
+static struct event_timer reconnect_timer = { { 0, 0 }, -1 };
+static struct event_timer send_timer = { { 0, 0 }, -1 };
+
+static int driver_fd = -1;      /* Driver fd currently watched */
+static int driver_unpolled = 0; /* driver_fd can't be polled, always ready */
+
+/**
+ * A repeating transmission started by SEND_START or SEND_ONCE, see
+ * send_core(). There is at most one session per remote; the next
+ * repetition is due min_remaining_gap after the last one was sent.
+ */
+struct send_session {
+	struct ir_remote*	remote;
+	struct ir_ncode*	code;
+	int			fd;             /**< SEND_ONCE client waiting for reply or -1 */
+	char*			message;        /**< SEND_ONCE command to reply to */
+	struct send_session*	next;
+};
+
+static struct send_session* sessions = NULL;
 
 static int listen_tcpip = 0;
 static unsigned short int port = LIRC_INET_PORT;
@@ -261,7 +405,7 @@ static int allow_simulate = 0;
 static int userelease = 0;
 static int useuinput = 0;
 
-static sig_atomic_t term = 0, hup = 0, alrm = 0;
+static sig_atomic_t term = 0, hup = 0;
 static int termsig;
 
 static __u32 setup_min_freq = 0, setup_max_freq = 0;
@@ -272,7 +416,7 @@ static lirc_t setup_max_pulse = 0, setup_max_space = 0;
 /* Use already opened hardware? */
 int use_hw(void)
 {
-	return clin > 0 || (useuinput && uinputfd != -1) || repeat_remote != NULL;
+	return clin > 0 || (useuinput && uinputfd != -1) || sessions != NULL;
 }
 
 /* set_transmitters only supports 32 bit int */
@@ -283,6 +427,300 @@ int max(int a, int b)
 	return a > b ? a : b;
 }
 
+/*
+ * Event loop backend. All file descriptors lircd waits for are kept
+ * registered in one poll set, so adding and removing a client is O(1)
+ * and there is no FD_SETSIZE limit. epoll(7) is used where available,
+ * poll(2) otherwise.
+ */
+
+/* Make sure fds[] covers fd. */
+static int fd_reserve(int fd)
+{
+	struct fd_entry* new_fds;
+	int size, i;
+
+	if (fd < fds_size)
+		return 1;
+	size = fds_size > 0 ? fds_size : 64;
+	while (size <= fd)
+		size *= 2;
+	new_fds = (struct fd_entry*)realloc(fds, size * sizeof(struct fd_entry));
+	if (new_fds == NULL)
+		return 0;
+	for (i = fds_size; i < size; i++) {
+		new_fds[i].watch = WATCH_NONE;
+		new_fds[i].output = 0;
+		new_fds[i].paused = 0;
+		new_fds[i].client = -1;
+#ifndef HAVE_SYS_EPOLL_H
+		new_fds[i].pollidx = -1;
+#endif
+	}
+	fds = new_fds;
+	fds_size = size;
+	return 1;
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+
+static int epfd = -1;
+
+static int poll_open(void)
+{
+	epfd = epoll_create(MAX_EVENTS);
+	if (epfd == -1)
+		return 0;
+	fcntl(epfd, F_SETFD, FD_CLOEXEC);
+	return 1;
+}
+
+static int poll_add(int fd)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = (fds[fd].paused ? 0 : EPOLLIN) | (fds[fd].output ? EPOLLOUT : 0);
+	ev.data.fd = fd;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == 0)
+		return 1;
+	return errno == EEXIST && epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+static void poll_mod(int fd)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = (fds[fd].paused ? 0 : EPOLLIN) | (fds[fd].output ? EPOLLOUT : 0);
+	ev.data.fd = fd;
+	epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+static void poll_del(int fd)
+{
+	struct epoll_event ev;
+
+	/* fails harmlessly if fd already has been closed */
+	memset(&ev, 0, sizeof(ev));
+	epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+static int poll_wait(struct ready_fd* ready, int timeout)
+{
+	struct epoll_event ev[MAX_EVENTS];
+	int i, n;
+
+	n = epoll_wait(epfd, ev, MAX_EVENTS, timeout);
+	for (i = 0; i < n; i++) {
+		ready[i].fd = ev[i].data.fd;
+		ready[i].what = ev[i].events & ~EPOLLOUT ? READY_IN : 0;
+		if (ev[i].events & EPOLLOUT)
+			ready[i].what |= READY_OUT;
+	}
+	return n;
+}
+
+#else
+
+static struct pollfd* pollfds = NULL;
+static int pollfds_size = 0;
+static int npollfds = 0;
+
+static int poll_open(void)
+{
+	return 1;
+}
+
+static int poll_add(int fd)
+{
+	struct pollfd* new_pollfds;
+	int size;
+
+	if (fds[fd].pollidx != -1)
+		return 1;
+	if (npollfds == pollfds_size) {
+		size = pollfds_size > 0 ? 2 * pollfds_size : 64;
+		new_pollfds = (struct pollfd*)realloc(pollfds, size * sizeof(struct pollfd));
+		if (new_pollfds == NULL)
+			return 0;
+		pollfds = new_pollfds;
+		pollfds_size = size;
+	}
+	pollfds[npollfds].fd = fd;
+	pollfds[npollfds].events = (fds[fd].paused ? 0 : POLLIN) | (fds[fd].output ? POLLOUT : 0);
+	pollfds[npollfds].revents = 0;
+	fds[fd].pollidx = npollfds++;
+	return 1;
+}
+
+static void poll_del(int fd)
+{
+	int i = fds[fd].pollidx;
+
+	if (i == -1)
+		return;
+	pollfds[i] = pollfds[--npollfds];
+	fds[pollfds[i].fd].pollidx = i;
+	fds[fd].pollidx = -1;
+}
+
+static void poll_mod(int fd)
+{
+	int i = fds[fd].pollidx;
+
+	if (i != -1)
+		pollfds[i].events = (fds[fd].paused ? 0 : POLLIN) | (fds[fd].output ? POLLOUT : 0);
+}
+
+static int poll_wait(struct ready_fd* ready, int timeout)
+{
+	int i, n;
+
+	n = poll(pollfds, npollfds, timeout);
+	if (n <= 0)
+		return n;
+	n = 0;
+	for (i = 0; i < npollfds && n < MAX_EVENTS; i++) {
+		if (pollfds[i].revents == 0)
+			continue;
+		ready[n].fd = pollfds[i].fd;
+		ready[n].what = pollfds[i].revents & ~POLLOUT ? READY_IN : 0;
+		if (pollfds[i].revents & POLLOUT)
+			ready[n].what |= READY_OUT;
+		n++;
+	}
+	return n;
+}
+
+#endif /* HAVE_SYS_EPOLL_H */
+
+/* Register fd of given WATCH_* type in the poll set. */
+static int watch_fd(int fd, int watch)
+{
+	if (!fd_reserve(fd)) {
+		logprintf(LIRC_ERROR, "out of memory");
+		return 0;
+	}
+	/* an old entry belongs to a closed fd which has been reused */
+	if (fds[fd].watch != WATCH_NONE)
+		poll_del(fd);
+	fds[fd].watch = WATCH_NONE;
+	if (!poll_add(fd)) {
+		/* EPERM: fd does not support polling, caller decides */
+		if (errno != EPERM) {
+			logprintf(LIRC_ERROR, "cannot watch file descriptor %d", fd);
+			logperror(LIRC_ERROR, NULL);
+		}
+		return 0;
+	}
+	fds[fd].watch = watch;
+	return 1;
+}
+
+/* Remove fd from the poll set unless it has been reused for another type. */
+static void unwatch_fd(int fd, int watch)
+{
+	if (fd < 0 || fd >= fds_size || fds[fd].watch != watch)
+		return;
+	poll_del(fd);
+	fds[fd].watch = WATCH_NONE;
+}
+
+/* Enable or disable polling fd for POLLOUT. */
+static void watch_output(int fd, int on)
+{
+	if (fds[fd].output == on)
+		return;
+	fds[fd].output = on;
+	if (fds[fd].watch != WATCH_NONE)
+		poll_mod(fd);
+}
+
+/* Stop or resume reading commands from a client. */
+static void pause_client(int fd, int on)
+{
+	if (fds[fd].paused == on)
+		return;
+	fds[fd].paused = on;
+	if (!on && fds[fd].client != -1 && clis[fds[fd].client].in_len > 0)
+		resumed_input = 1;
+	if (fds[fd].watch != WATCH_NONE)
+		poll_mod(fd);
+}
+
+/* Forget the driver fd, to be called after deinit_func(). */
+static void unwatch_driver(void)
+{
+	unwatch_fd(driver_fd, WATCH_DRIVER);
+	driver_fd = -1;
+	driver_unpolled = 0;
+}
+
+static int is_client(int fd)
+{
+	return fd >= 0 && fd < fds_size && fds[fd].client != -1;
+}
+
+static void timer_open(struct event_timer* t)
+{
+#ifdef HAVE_SYS_TIMERFD_H
+	t->fd = timerfd_create(CLOCK_REALTIME, 0);
+	if (t->fd == -1)
+		return;
+	fcntl(t->fd, F_SETFL, O_NONBLOCK);
+	fcntl(t->fd, F_SETFD, FD_CLOEXEC);
+	if (!watch_fd(t->fd, WATCH_TIMER)) {
+		close(t->fd);
+		t->fd = -1;
+	}
+#endif
+}
+
+/* Set absolute expiry time, a cleared when disarms the timer. */
+static void timer_set(struct event_timer* t, const struct timeval* when)
+{
+	if (t->when.tv_sec == when->tv_sec && t->when.tv_usec == when->tv_usec)
+		return;
+	t->when = *when;
+#ifdef HAVE_SYS_TIMERFD_H
+	if (t->fd != -1) {
+		struct itimerspec its;
+
+		memset(&its, 0, sizeof(its));
+		its.it_value.tv_sec = when->tv_sec;
+		its.it_value.tv_nsec = when->tv_usec * 1000;
+		timerfd_settime(t->fd, TFD_TIMER_ABSTIME, &its, NULL);
+	}
+#endif
+}
+
+/* Return 1 and disarm t if it has expired. */
+static int timer_expired(struct event_timer* t, const struct timeval* now)
+{
+	if (!timerisset(&t->when) || timercmp(now, &t->when, <))
+		return 0;
+	timerclear(&t->when);
+	return 1;
+}
+
+/* Shorten a poll timeout [ms] to t unless t wakes us up by itself. */
+static int timer_timeout(struct event_timer* t, const struct timeval* now, int timeout)
+{
+	struct timeval gap;
+	int ms;
+
+	if (t->fd != -1 || !timerisset(&t->when))
+		return timeout;
+	if (timercmp(now, &t->when, <)) {
+		timersub(&t->when, now, &gap);
+		ms = gap.tv_sec * 1000 + (gap.tv_usec + 999) / 1000;
+	} else {
+		ms = 0;
+	}
+	return timeout == -1 || ms < timeout ? ms : timeout;
+}
+
 /* cut'n'paste from fileutils-3.16: */
 
 #define isodigit(c) ((c) >= '0' && (c) <= '7')
@@ -303,11 +741,377 @@ static int oatoi(const char* s)
 	return i;
 }
 
+/*
+ * Client output queues. Clients are non-blocking; whatever can't be
+ * written at once is queued and flushed when the socket becomes
+ * writable, so a stalled client never blocks lircd. The queue is a ring
+ * of units, each an out_unit header followed by the data.
+ */
+
+static void ring_copy_in(struct out_queue* q, unsigned int pos, const void* src, unsigned int len)
+{
+	unsigned int off = pos & (queue_size - 1);
+	unsigned int n = len < queue_size - off ? len : queue_size - off;
+
+	memcpy(q->buf + off, src, n);
+	memcpy(q->buf, (const char*)src + n, len - n);
+}
+
+static void ring_copy_out(const struct out_queue* q, unsigned int pos, void* dst, unsigned int len)
+{
+	unsigned int off = pos & (queue_size - 1);
+	unsigned int n = len < queue_size - off ? len : queue_size - off;
+
+	memcpy(dst, q->buf + off, n);
+	memcpy((char*)dst + n, q->buf, len - n);
+}
+
+static unsigned int queue_free(const struct out_queue* q)
+{
+	return queue_size - (q->tail - q->head);
+}
+
+static int queue_put(struct out_queue* q, const char* buf, unsigned int len, unsigned int kind)
+{
+	struct out_unit unit;
+
+	if (q->buf == NULL) {
+		q->buf = (char*)malloc(queue_size);
+		if (q->buf == NULL)
+			return 0;
+	}
+	unit.len = len;
+	unit.kind = kind;
+	ring_copy_in(q, q->tail, &unit, sizeof(unit));
+	ring_copy_in(q, q->tail + sizeof(unit), buf, len);
+	q->last = q->tail;
+	q->tail += sizeof(unit) + len;
+	return 1;
+}
+
+/* Drop the oldest events not being written yet until need bytes are free. */
+static void queue_drop_events(struct out_queue* q, unsigned int need)
+{
+	struct out_unit unit;
+	unsigned int src, dst, last, size, used, dropped;
+	char* buf;
+
+	/* linearize into a new buffer, then compact it in place */
+	buf = (char*)malloc(queue_size);
+	if (buf == NULL)
+		return;
+	used = q->tail - q->head;
+	ring_copy_out(q, q->head, buf, used);
+	src = dst = last = dropped = 0;
+	while (src < used) {
+		memcpy(&unit, buf + src, sizeof(unit));
+		size = sizeof(unit) + unit.len;
+		if (unit.kind == OUT_EVENT && !(src == 0 && q->sent > 0)
+		    && queue_size - used + dropped < need) {
+			dropped += size;
+		} else {
+			memmove(buf + dst, buf + src, size);
+			last = dst;
+			dst += size;
+		}
+		src += size;
+	}
+	free(q->buf);
+	q->buf = buf;
+	q->head = 0;
+	q->tail = dst;
+	q->last = last;
+	LOGPRINTF(1, "output queue full, dropped %u bytes of events", dropped);
+}
+
+/* Is msg a repeat of the last queued event, which isn't being written yet? */
+static int queue_is_repeat(const struct out_queue* q, const char* msg, int binary)
+{
+	struct out_unit unit;
+	char last[PACKET_SIZE + 1];
+	const char* s;
+	const char* t;
+	struct lirc_frame_event ev, last_ev;
+
+	if (q->head == q->tail || (q->last == q->head && q->sent > 0))
+		return 0;
+	ring_copy_out(q, q->last, &unit, sizeof(unit));
+	if (unit.kind != OUT_EVENT || unit.len > PACKET_SIZE)
+		return 0;
+	ring_copy_out(q, q->last + sizeof(unit), last, unit.len);
+	if (binary) {
+		/* all units are frames, events have the same size */
+		if (unit.len != sizeof(struct lirc_frame_hdr) + sizeof(ev))
+			return 0;
+		memcpy(&ev, msg + sizeof(struct lirc_frame_hdr), sizeof(ev));
+		memcpy(&last_ev, last + sizeof(struct lirc_frame_hdr), sizeof(ev));
+		return ev.reps != 0 && ev.code == last_ev.code
+		       && ev.remote_id == last_ev.remote_id
+		       && ev.button_id == last_ev.button_id
+		       && ev.flags == last_ev.flags;
+	}
+	last[unit.len] = 0;
+	/* "code repeat button remote\n", compare all but the repeat count */
+	s = strchr(msg, ' ');
+	t = strchr(last, ' ');
+	if (s == NULL || t == NULL || strtoul(s + 1, NULL, 16) == 0)
+		return 0;
+	if (s - msg != t - last || strncmp(msg, last, s - msg) != 0)
+		return 0;
+	s = strchr(s + 1, ' ');
+	t = strchr(t + 1, ' ');
+	return s != NULL && t != NULL && strcmp(s, t) == 0;
+}
+
+/* Write what can be written of the queued output, return 0 on errors. */
+static int flush_client(struct client* c)
+{
+	struct out_queue* q = &c->out;
+	struct out_unit unit;
+	unsigned int off, n;
+	int done;
+
+	while (q->head != q->tail) {
+		ring_copy_out(q, q->head, &unit, sizeof(unit));
+		off = (q->head + sizeof(unit) + q->sent) & (queue_size - 1);
+		n = unit.len - q->sent;
+		if (n > queue_size - off)
+			n = queue_size - off;
+		done = write(c->fd, q->buf + off, n);
+		if (done == -1)
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		q->sent += done;
+		if (q->sent == unit.len) {
+			q->head += sizeof(unit) + unit.len;
+			q->sent = 0;
+		}
+	}
+	watch_output(c->fd, 0);
+	return 1;
+}
+
+/*
+ * Send len bytes to a client, queueing what can't be written at once.
+ * Returns len, or -1 if the client should be removed.
+ */
+static int client_write(struct client* c, const char* buf, int len, unsigned int kind)
+{
+	struct out_queue* q = &c->out;
+	unsigned int need = sizeof(struct out_unit) + len;
+	int done = 0;
+
+	if (q->head == q->tail) {
+		done = write(c->fd, buf, len);
+		if (done == len)
+			return len;
+		if (done == -1) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				return -1;
+			done = 0;
+		}
+		if (need > queue_size || !queue_put(q, buf, len, kind))
+			return -1;
+		/* a unit being written is never dropped */
+		q->sent = done;
+		watch_output(c->fd, 1);
+		return len;
+	}
+	if (kind == OUT_EVENT && queue_overflow == OVERFLOW_COALESCE
+	    && queue_is_repeat(q, buf, c->binary)
+	    && queue_free(q) + (q->tail - q->last) >= need)
+		q->tail = q->last;      /* replaced by this repeat */
+	if (queue_free(q) < need && queue_overflow != OVERFLOW_DISCONNECT)
+		queue_drop_events(q, need);
+	if (queue_free(q) < need) {
+		if (kind == OUT_EVENT && queue_overflow != OVERFLOW_DISCONNECT) {
+			LOGPRINTF(1, "output queue full, event dropped");
+			return len;
+		}
+		logprintf(LIRC_WARNING, "output queue of client overflows");
+		return -1;
+	}
+	return queue_put(q, buf, len, kind) ? len : -1;
+}
+
+/*
+ * Binary event protocol, see set_event_format(). Button events are sent
+ * as LIRC_FRAME_EVENT frames, names as LIRC_FRAME_NAME frames before
+ * their first use and everything else wrapped in LIRC_FRAME_TEXT frames.
+ */
+
+static unsigned int name_hash(const char* name)
+{
+	unsigned int h = 2166136261u;
+
+	while (*name)
+		h = (h ^ (unsigned char)*name++) * 16777619u;
+	return h;
+}
+
+/* Return the ID of name, adding it if it's new; -1 if out of memory. */
+static int intern_name(const char* name)
+{
+	unsigned int i, id, size;
+	unsigned int* index;
+	char** new_names;
+
+	for (i = name_hash(name) & (name_index_size - 1);
+	     name_index_size > 0 && name_index[i] != 0;
+	     i = (i + 1) & (name_index_size - 1))
+		if (strcmp(names[name_index[i] - 1], name) == 0)
+			return name_index[i] - 1;
+	if (names_n == names_size) {
+		size = names_size > 0 ? 2 * names_size : 64;
+		new_names = (char**)realloc(names, size * sizeof(char*));
+		if (new_names == NULL)
+			return -1;
+		names = new_names;
+		names_size = size;
+	}
+	if (2 * (names_n + 1) > name_index_size) {
+		/* keep the table at most half full */
+		size = name_index_size > 0 ? 2 * name_index_size : 128;
+		index = (unsigned int*)calloc(size, sizeof(unsigned int));
+		if (index == NULL)
+			return -1;
+		for (id = 0; id < names_n; id++) {
+			for (i = name_hash(names[id]) & (size - 1); index[i] != 0; i = (i + 1) & (size - 1))
+				;
+			index[i] = id + 1;
+		}
+		free(name_index);
+		name_index = index;
+		name_index_size = size;
+	}
+	names[names_n] = strdup(name);
+	if (names[names_n] == NULL)
+		return -1;
+	for (i = name_hash(name) & (name_index_size - 1); name_index[i] != 0; i = (i + 1) & (name_index_size - 1))
+		;
+	name_index[i] = names_n + 1;
+	return names_n++;
+}
+
+/*
+ * Fill ev from a "code reps button remote\n" event message. Names are
+ * taken from the message unless given. Returns 0 if malformed.
+ */
+static int parse_event(const char* message, const char* remote_name,
+		       const char* button_name, int release, struct lirc_frame_event* ev)
+{
+	char remote[PACKET_SIZE + 1];
+	char button[PACKET_SIZE + 1];
+	unsigned long long code;
+	unsigned int reps;
+	struct timespec now;
+	int remote_id, button_id;
+
+	if (remote_name == NULL || button_name == NULL) {
+		if (sscanf(message, "%llx %x %256s %256s", &code, &reps, button, remote) != 4)
+			return 0;
+		remote_name = remote;
+		button_name = button;
+	} else if (sscanf(message, "%llx %x", &code, &reps) != 2) {
+		return 0;
+	}
+	remote_id = intern_name(remote_name);
+	button_id = intern_name(button_name);
+	if (remote_id == -1 || button_id == -1)
+		return 0;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ev->code = code;
+	ev->timestamp = (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+	ev->remote_id = remote_id;
+	ev->button_id = button_id;
+	ev->reps = reps;
+	ev->flags = release ? LIRC_EVENT_RELEASE : 0;
+	return 1;
+}
+
+/* Send len bytes of text to a binary protocol client, see client_write(). */
+static int client_write_text(struct client* c, const char* buf, int len, unsigned int kind)
+{
+	char frame[sizeof(struct lirc_frame_hdr) + PACKET_SIZE];
+	struct lirc_frame_hdr hdr;
+	int done, n;
+
+	for (done = 0; done < len; done += n) {
+		n = len - done < PACKET_SIZE ? len - done : PACKET_SIZE;
+		hdr.type = LIRC_FRAME_TEXT;
+		hdr.len = n;
+		memcpy(frame, &hdr, sizeof(hdr));
+		memcpy(frame + sizeof(hdr), buf + done, n);
+		if (client_write(c, frame, sizeof(hdr) + n, kind) == -1)
+			return -1;
+	}
+	return len;
+}
+
+/* Make sure a binary protocol client knows name id, return 0 on errors. */
+static int client_name(struct client* c, unsigned int id)
+{
+	char frame[sizeof(struct lirc_frame_hdr) + sizeof(uint32_t) + PACKET_SIZE + 1];
+	struct lirc_frame_hdr hdr;
+	uint32_t id32 = id;
+	unsigned char* bits;
+	unsigned int size, len;
+
+	if (id / 8 < c->names_sent_size && c->names_sent[id / 8] & (1 << id % 8))
+		return 1;
+	if (id / 8 >= c->names_sent_size) {
+		size = c->names_sent_size > 0 ? c->names_sent_size : 16;
+		while (size <= id / 8)
+			size *= 2;
+		bits = (unsigned char*)realloc(c->names_sent, size);
+		if (bits == NULL)
+			return 0;
+		memset(bits + c->names_sent_size, 0, size - c->names_sent_size);
+		c->names_sent = bits;
+		c->names_sent_size = size;
+	}
+	len = strlen(names[id]) + 1;
+	if (len > PACKET_SIZE + 1)
+		return 0;
+	hdr.type = LIRC_FRAME_NAME;
+	hdr.len = sizeof(id32) + len;
+	memcpy(frame, &hdr, sizeof(hdr));
+	memcpy(frame + sizeof(hdr), &id32, sizeof(id32));
+	memcpy(frame + sizeof(hdr) + sizeof(id32), names[id], len);
+	/* never dropped, events refer to it */
+	if (client_write(c, frame, sizeof(hdr) + hdr.len, OUT_REPLY) == -1)
+		return 0;
+	c->names_sent[id / 8] |= 1 << id % 8;
+	return 1;
+}
+
+/* Send an event to a binary protocol client, see client_write(). */
+static int client_event(struct client* c, const struct lirc_frame_event* ev)
+{
+	char frame[sizeof(struct lirc_frame_hdr) + sizeof(struct lirc_frame_event)];
+	struct lirc_frame_hdr hdr;
+
+	if (!client_name(c, ev->remote_id) || !client_name(c, ev->button_id))
+		return -1;
+	hdr.type = LIRC_FRAME_EVENT;
+	hdr.len = sizeof(*ev);
+	memcpy(frame, &hdr, sizeof(hdr));
+	memcpy(frame + sizeof(hdr), ev, sizeof(*ev));
+	return client_write(c, frame, sizeof(frame), OUT_EVENT);
+}
+
 /* A safer write(), since sockets might not write all but only some of the
  * bytes requested */
 int write_socket(int fd, const char* buf, int len)
 {
 	int done, todo = len;
+	struct client* c;
+
+	if (is_client(fd)) {
+		c = &clis[fds[fd].client];
+		if (c->binary)
+			return client_write_text(c, buf, len, OUT_REPLY);
+		return client_write(c, buf, len, OUT_REPLY);
+	}
 
 	while (todo) {
 #ifdef SIM_REC
@@ -337,32 +1141,22 @@ int write_socket_len(int fd, const char* buf)
 
 int read_timeout(int fd, char* buf, int len, int timeout)
 {
-	fd_set fds;
-	struct timeval tv;
+	struct pollfd pfd;
 	int ret, n;
 
-	FD_ZERO(&fds);
-	FD_SET(fd, &fds);
-	tv.tv_sec = timeout;
-	tv.tv_usec = 0;
-
-	/* CAVEAT: (from libc documentation)
-	 * Any signal will cause `select' to return immediately.  So if your
-	 * program uses signals, you can't rely on `select' to keep waiting
-	 * for the full time specified.  If you want to be sure of waiting
-	 * for a particular amount of time, you must check for `EINTR' and
-	 * repeat the `select' with a newly calculated timeout based on the
-	 * current time.  See the example below.
-	 *
-	 * Obviously the timeout is not recalculated in the example because
-	 * this is done automatically on Linux systems...
-	 */
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	/* CAVEAT: Any signal will cause poll() to return immediately.
+	 * It is restarted with the full timeout, which thus might be
+	 * extended by signals. Unlike select(), poll() works for any fd. */
 
 	do
-		ret = select(fd + 1, &fds, NULL, NULL, &tv);
+		ret = poll(&pfd, 1, timeout * 1000);
 	while (ret == -1 && errno == EINTR);
 	if (ret == -1) {
-		logprintf(LIRC_ERROR, "select() failed");
+		logprintf(LIRC_ERROR, "poll() failed");
 		logperror(LIRC_ERROR, NULL);
 		return -1;
 	} else if (ret == 0) {
@@ -537,7 +1331,8 @@ void config(void)
 		return;
 	}
 	configfile = filename;
-	config_remotes = read_config(fd, configfile);
+	config_remotes = read_config_cached(fd, configfile,
+					    options_getstring("lircd:config-cache"));
 	fclose(fd);
 	if (config_remotes == (void*)-1) {
 		logprintf(LIRC_ERROR, "reading of config file failed");
@@ -564,23 +1359,38 @@ void config(void)
 
 void remove_client(int fd)
 {
+	struct send_session* s;
 	int i;
 
-	for (i = 0; i < clin; i++) {
-		if (clis[i] == fd) {
-			shutdown(clis[i], 2);
-			close(clis[i]);
-			logprintf(LIRC_INFO, "removed client");
-
-			clin--;
-			if (!use_hw() && curr_driver->deinit_func)
-				curr_driver->deinit_func();
-			for (; i < clin; i++)
-				clis[i] = clis[i + 1];
-			return;
-		}
+	if (!is_client(fd)) {
+		LOGPRINTF(1, "internal error in remove_client: no such fd");
+		return;
+	}
+	i = fds[fd].client;
+	unwatch_fd(fd, WATCH_CLIENT);
+	fds[fd].output = 0;
+	fds[fd].paused = 0;
+	for (s = sessions; s != NULL; s = s->next)
+		if (s->fd == fd)
+			s->fd = -1;
+	shutdown(fd, 2);
+	close(fd);
+	if (clis[i].out.buf != NULL)
+		free(clis[i].out.buf);
+	if (clis[i].names_sent != NULL)
+		free(clis[i].names_sent);
+	logprintf(LIRC_INFO, "removed client");
+
+	/* move the last client into the free slot */
+	clin--;
+	clis[i] = clis[clin];
+	fds[clis[i].fd].client = i;
+	fds[fd].client = -1;
+	if (!use_hw() && curr_driver->deinit_func) {
+		curr_driver->deinit_func();
+		unwatch_driver();
+		rec_buffer_init();
 	}
-	LOGPRINTF(1, "internal error in remove_client: no such fd");
 }
 
 
@@ -597,7 +1407,6 @@ void dosigterm(int sig)
 {
 	int i;
 
-	signal(SIGALRM, SIG_IGN);
 	logprintf(LIRC_NOTICE, "caught signal");
 
 	if (free_remotes != NULL)
@@ -605,8 +1414,8 @@ void dosigterm(int sig)
 	free_config(remotes);
 	repeat_remote = NULL;
 	for (i = 0; i < clin; i++) {
-		shutdown(clis[i], 2);
-		close(clis[i]);
+		shutdown(clis[i].fd, 2);
+		close(clis[i].fd);
 	}
 	;
 	if (do_shutdown)
@@ -615,6 +1424,8 @@ void dosigterm(int sig)
 
 #if defined(__linux__)
 	if (uinputfd != -1) {
+		logprintf(LIRC_INFO, "uinput: %lu events in %lu writes",
+			  uinput_out.events, uinput_out.writes);
 		ioctl(uinputfd, UI_DEV_DESTROY);
 		close(uinputfd);
 		uinputfd = -1;
@@ -658,10 +1469,10 @@ void dosighup(int sig)
 
 	for (i = 0; i < clin; i++) {
 		if (!
-		    (write_socket_len(clis[i], protocol_string[P_BEGIN])
-		     && write_socket_len(clis[i], protocol_string[P_SIGHUP])
-		     && write_socket_len(clis[i], protocol_string[P_END]))) {
-			remove_client(clis[i]);
+		    (write_socket_len(clis[i].fd, protocol_string[P_BEGIN])
+		     && write_socket_len(clis[i].fd, protocol_string[P_SIGHUP])
+		     && write_socket_len(clis[i].fd, protocol_string[P_END]))) {
+			remove_client(clis[i].fd);
 			i--;
 		}
 	}
@@ -757,7 +1568,8 @@ void add_client(int sock)
 	int fd;
 	socklen_t clilen;
 	struct sockaddr client_addr;
-	int flags;
+	struct client* new_clis;
+	int flags, size;
 
 	clilen = sizeof(client_addr);
 	fd = accept(sock, (struct sockaddr*)&client_addr, &clilen);
@@ -768,7 +1580,15 @@ void add_client(int sock)
 	}
 	;
 
-	if (fd >= FD_SETSIZE || clin >= MAX_CLIENTS) {
+	if (clin == clis_size) {
+		size = clis_size > 0 ? 2 * clis_size : 16;
+		new_clis = (struct client*)realloc(clis, size * sizeof(struct client));
+		if (new_clis != NULL) {
+			clis = new_clis;
+			clis_size = size;
+		}
+	}
+	if (clin == clis_size || !watch_fd(fd, WATCH_CLIENT)) {
 		logprintf(LIRC_ERROR, "connection rejected");
 		shutdown(fd, 2);
 		close(fd);
@@ -779,16 +1599,22 @@ void add_client(int sock)
 	if (flags != -1)
 		fcntl(fd, F_SETFL, flags | O_NONBLOCK);
 	if (client_addr.sa_family == AF_UNIX) {
-		cli_type[clin] = CT_LOCAL;
+		clis[clin].type = CT_LOCAL;
 		logprintf(LIRC_NOTICE, "accepted new client on %s", lircdfile);
 	} else if (client_addr.sa_family == AF_INET) {
-		cli_type[clin] = CT_REMOTE;
+		clis[clin].type = CT_REMOTE;
 		logprintf(LIRC_NOTICE, "accepted new client from %s",
 			  inet_ntoa(((struct sockaddr_in*)&client_addr)->sin_addr));
 	} else {
-		cli_type[clin] = 0;     /* what? */
-	}
-	clis[clin] = fd;
+		clis[clin].type = 0;     /* what? */
+	}
+	clis[clin].fd = fd;
+	memset(&clis[clin].out, 0, sizeof(clis[clin].out));
+	clis[clin].binary = 0;
+	clis[clin].names_sent = NULL;
+	clis[clin].names_sent_size = 0;
+	clis[clin].in_len = 0;
+	fds[fd].client = clin;
 	if (!use_hw()) {
 		if (curr_driver->init_func) {
 			if (!curr_driver->init_func())
@@ -798,8 +1624,10 @@ void add_client(int sock)
 			 * it impossible to connect to when we
 			 * have a device actually plugged
 			 * in. */
-			else
+			else {
+				rec_buffer_init();
 				setup_hardware();
+			}
 		}
 	}
 	clin++;
@@ -900,8 +1728,26 @@ void connect_to_peers(void)
 			}
 			logprintf(LIRC_NOTICE, "connected to %s", peers[i]->host);
 			peers[i]->connection_failure = 0;
+			watch_fd(peers[i]->socket, WATCH_PEER);
+		}
+	}
+}
+
+/* Send the event lines in buffer to a binary protocol client. */
+static int relay_events(struct client* c, const char* buffer)
+{
+	struct lirc_frame_event ev;
+	const char* line;
+
+	for (line = buffer; *line != '\0'; line = strchr(line, '\n') + 1) {
+		if (!parse_event(line, NULL, NULL, 0, &ev)) {
+			LOGPRINTF(1, "not relayed to binary client: %s", line);
+			continue;
 		}
+		if (client_event(c, &ev) == -1)
+			return -1;
 	}
+	return 0;
 }
 
 int get_peer_message(struct peer_connection* peer)
@@ -909,7 +1755,7 @@ int get_peer_message(struct peer_connection* peer)
 	int length;
 	char buffer[PACKET_SIZE + 1];
 	char* end;
-	int i;
+	int i, r;
 
 	length = read_timeout(peer->socket, buffer, PACKET_SIZE, 0);
 	if (length) {
@@ -926,11 +1772,15 @@ int get_peer_message(struct peer_connection* peer)
 		LOGPRINTF(1, "received peer message: \"%s\"", buffer);
 		for (i = 0; i < clin; i++) {
 			/* don't relay messages to remote clients */
-			if (cli_type[i] == CT_REMOTE)
+			if (clis[i].type == CT_REMOTE)
 				continue;
 			LOGPRINTF(1, "writing to client %d", i);
-			if (write_socket(clis[i], buffer, length) < length) {
-				remove_client(clis[i]);
+			if (clis[i].binary)
+				r = relay_events(&clis[i], buffer);
+			else
+				r = client_write(&clis[i], buffer, length, OUT_EVENT);
+			if (r == -1) {
+				remove_client(clis[i].fd);
 				i--;
 			}
 		}
@@ -1049,6 +1899,9 @@ void start_server(mode_t permission, int nodaemon, loglevel_t loglevel)
 
 	if (useuinput)
 		uinputfd = setup_uinputfd(progname);
+#if defined(__linux__)
+	uinput_batch_init(&uinput_out, uinputfd);
+#endif
 	drop_privileges();
 	if (listen_tcpip) {
 		int enable = 1;
@@ -1159,56 +2012,93 @@ int send_error(int fd, char* message, const char* format_str, ...)
 }
 
 
-void sigalrm(int sig)
+static struct send_session* find_session(const struct ir_remote* remote, int fd)
+{
+	struct send_session* s;
+
+	for (s = sessions; s != NULL; s = s->next)
+		if (s->remote == remote || (fd != -1 && s->fd == fd))
+			return s;
+	return NULL;
+}
+
+/* Time when the next repetition of s is due. */
+static void session_due(const struct send_session* s, struct timeval* due)
 {
-	alrm = 1;
+	due->tv_sec = s->remote->last_send.tv_sec + s->remote->min_remaining_gap / 1000000;
+	due->tv_usec = s->remote->last_send.tv_usec + s->remote->min_remaining_gap % 1000000;
+	if (due->tv_usec >= 1000000) {
+		due->tv_sec++;
+		due->tv_usec -= 1000000;
+	}
 }
 
+/* Remove s, reply to a waiting SEND_ONCE client. */
+static void end_session(struct send_session* s, int interrupted)
+{
+	struct send_session** p;
+
+	for (p = &sessions; *p != s; p = &(*p)->next)
+		;
+	*p = s->next;
+	if (s->fd != -1) {
+		pause_client(s->fd, 0);
+		if (interrupted)
+			send_error(s->fd, s->message, "repeating interrupted\n");
+		else
+			send_success(s->fd, s->message);
+	}
+	if (s->message != NULL)
+		free(s->message);
+	free(s);
+	if (!use_hw() && curr_driver->deinit_func) {
+		curr_driver->deinit_func();
+		unwatch_driver();
+		rec_buffer_init();
+	}
+}
 
-void dosigalrm(int sig)
+static void repeat_session(struct send_session* s)
 {
-	struct itimerval repeat_timer;
+	struct ir_remote* remote = s->remote;
+	struct ir_ncode* code = s->code;
+	int ok;
 
-	if (repeat_remote->last_code != repeat_code) {
+	if (remote->last_code != code) {
 		/* we received a different code from the original
 		 * remote control we could repeat the wrong code so
 		 * better stop repeating */
-		if (repeat_fd != -1)
-			send_error(repeat_fd, repeat_message, "repeating interrupted\n");
-
-		repeat_remote = NULL;
-		repeat_code = NULL;
-		repeat_fd = -1;
-		if (repeat_message != NULL) {
-			free(repeat_message);
-			repeat_message = NULL;
-		}
-		if (!use_hw() && curr_driver->deinit_func)
-			curr_driver->deinit_func();
-		return;
-	}
-	if (repeat_code->next == NULL
-	    || (repeat_code->transmit_state != NULL && repeat_code->transmit_state->next == NULL))
-		repeat_remote->repeat_countdown--;
-	if (send_ir_ncode(repeat_remote, repeat_code, 1) && repeat_remote->repeat_countdown > 0) {
-		repeat_timer.it_value.tv_sec = 0;
-		repeat_timer.it_value.tv_usec = repeat_remote->min_remaining_gap;
-		repeat_timer.it_interval.tv_sec = 0;
-		repeat_timer.it_interval.tv_usec = 0;
-
-		setitimer(ITIMER_REAL, &repeat_timer, NULL);
+		end_session(s, 1);
 		return;
 	}
+	if (code->next == NULL
+	    || (code->transmit_state != NULL && code->transmit_state->next == NULL))
+		remote->repeat_countdown--;
+	/* tells the transmit code that this is a repetition */
+	repeat_remote = remote;
+	repeat_code = code;
+	ok = send_ir_ncode(remote, code, 1);
 	repeat_remote = NULL;
 	repeat_code = NULL;
-	if (repeat_fd != -1) {
-		send_success(repeat_fd, repeat_message);
-		free(repeat_message);
-		repeat_message = NULL;
-		repeat_fd = -1;
+	if (!ok || remote->repeat_countdown <= 0)
+		end_session(s, 0);
+}
+
+/* Send the next repetition of all sessions which are due. */
+static void run_sessions(void)
+{
+	struct send_session* s;
+	struct send_session* next;
+	struct timeval now, due;
+
+	for (s = sessions; s != NULL; s = next) {
+		next = s->next;
+		/* sending takes time, check each against the clock */
+		gettimeofday(&now, NULL);
+		session_due(s, &due);
+		if (!timercmp(&now, &due, <))
+			repeat_session(s);
 	}
-	if (!use_hw() && curr_driver->deinit_func)
-		curr_driver->deinit_func();
 }
 
 
@@ -1373,6 +2263,52 @@ static int list(int fd, char* message, char* arguments)
 	return send_name(fd, message, code);
 }
 
+/*
+ * DECODE_STATS: List the remotes in the order they are tried when
+ * decoding, with their hit and miss counters and current hit rate.
+ */
+static int decode_stats(int fd, char* message, char* arguments)
+{
+	char buffer[PACKET_SIZE + 1];
+	struct ir_remote** order;
+	int n, i, len;
+
+	if (arguments != NULL)
+		return send_error(fd, message, "bad send packet\n");
+	n = get_decode_order(remotes, NULL, 0);
+	order = (struct ir_remote**)malloc((n + 1) * sizeof(*order));
+	if (order == NULL)
+		return send_error(fd, message, "out of memory\n");
+	get_decode_order(remotes, order, n);
+
+	if (!(write_socket_len(fd, protocol_string[P_BEGIN]) && write_socket_len(fd, message)
+	      && write_socket_len(fd, protocol_string[P_SUCCESS]))) {
+		free(order);
+		return 0;
+	}
+	if (n == 0) {
+		free(order);
+		return write_socket_len(fd, protocol_string[P_END]);
+	}
+	sprintf(buffer, "%d\n", n);
+	if (!(write_socket_len(fd, protocol_string[P_DATA]) && write_socket_len(fd, buffer))) {
+		free(order);
+		return 0;
+	}
+	for (i = 0; i < n; i++) {
+		len = snprintf(buffer, PACKET_SIZE + 1, "%s %u %u %u\n", order[i]->name,
+			       order[i]->decode_hits, order[i]->decode_misses, order[i]->decode_score);
+		if (len >= PACKET_SIZE + 1)
+			len = sprintf(buffer, "name_too_long\n");
+		if (write_socket(fd, buffer, len) < len) {
+			free(order);
+			return 0;
+		}
+	}
+	free(order);
+	return write_socket_len(fd, protocol_string[P_END]);
+}
+
 static int set_transmitters(int fd, char* message, char* arguments)
 {
 	char* next_arg = NULL;
@@ -1417,21 +2353,46 @@ string_error:
 }
 
 
-void broadcast_message(const char* message)
+/*
+ * Send an event message to all clients. Binary protocol clients get it
+ * as a frame using remote_name and button_name, if NULL these are taken
+ * from the message.
+ */
+static void broadcast_event(const char* message,
+			    const char* remote_name, const char* button_name, int release)
 {
-	int len, i;
+	struct lirc_frame_event ev;
+	int len, i, r, parsed = 0;
 
 	len = strlen(message);
 
 	for (i = 0; i < clin; i++) {
 		LOGPRINTF(1, "writing to client %d: %s", i, message);
-		if (write_socket(clis[i], message, len) < len) {
-			remove_client(clis[i]);
+		if (!clis[i].binary) {
+			r = client_write(&clis[i], message, len, OUT_EVENT);
+		} else {
+			/* once for all binary clients */
+			if (parsed == 0)
+				parsed = parse_event(message, remote_name, button_name,
+						     release, &ev) ? 1 : -1;
+			if (parsed == -1) {
+				LOGPRINTF(1, "not sent to binary client: %s", message);
+				continue;
+			}
+			r = client_event(&clis[i], &ev);
+		}
+		if (r == -1) {
+			remove_client(clis[i].fd);
 			i--;
 		}
 	}
 }
 
+void broadcast_message(const char* message)
+{
+	broadcast_event(message, NULL, NULL, 0);
+}
+
 
 static int simulate(int fd, char* message, char* arguments)
 {
@@ -1495,7 +2456,7 @@ static int send_core(int fd, char* message, char* arguments, int once)
 {
 	struct ir_remote* remote;
 	struct ir_ncode* code;
-	struct itimerval repeat_timer;
+	struct send_session* s;
 	unsigned int reps;
 	int err;
 
@@ -1510,10 +2471,10 @@ static int send_core(int fd, char* message, char* arguments, int once)
 		return 1;
 
 	if (once) {
-		if (repeat_remote != NULL)
+		if (find_session(remote, fd) != NULL)
 			return send_error(fd, message, "busy: repeating\n");
 	} else {
-		if (repeat_remote != NULL)
+		if (find_session(remote, -1) != NULL)
 			return send_error(fd, message, "already repeating\n");
 	}
 	if (has_toggle_mask(remote))
@@ -1531,26 +2492,29 @@ static int send_core(int fd, char* message, char* arguments, int once)
 		/* you've been warned, now we have a limit */
 		remote->repeat_countdown = repeat_max;
 	if (remote->repeat_countdown > 0 || code->next != NULL) {
-		repeat_remote = remote;
-		repeat_code = code;
-		repeat_timer.it_value.tv_sec = 0;
-		repeat_timer.it_value.tv_usec = remote->min_remaining_gap;
-		repeat_timer.it_interval.tv_sec = 0;
-		repeat_timer.it_interval.tv_usec = 0;
+		s = (struct send_session*)calloc(1, sizeof(struct send_session));
+		if (s == NULL)
+			return send_error(fd, message, "out of memory\n");
+		s->remote = remote;
+		s->code = code;
+		s->fd = -1;
 		if (once) {
-			repeat_message = strdup(message);
-			if (repeat_message == NULL) {
-				repeat_remote = NULL;
-				repeat_code = NULL;
+			s->message = strdup(message);
+			if (s->message == NULL) {
+				free(s);
 				return send_error(fd, message, "out of memory\n");
 			}
-			repeat_fd = fd;
+			/* Reply when done. Don't read further commands from
+			 * this client until then, otherwise we could mix up
+			 * answer packets and send them in the wrong order. */
+			s->fd = fd;
+			pause_client(fd, 1);
 		} else if (!send_success(fd, message)) {
-			repeat_remote = NULL;
-			repeat_code = NULL;
+			free(s);
 			return 0;
 		}
-		setitimer(ITIMER_REAL, &repeat_timer, NULL);
+		s->next = sessions;
+		sessions = s;
 		return 1;
 	} else {
 		return send_success(fd, message);
@@ -1561,44 +2525,40 @@ static int send_stop(int fd, char* message, char* arguments)
 {
 	struct ir_remote* remote;
 	struct ir_ncode* code;
-	struct itimerval repeat_timer;
-	int err;
+	struct send_session* s;
+	struct send_session* next;
+	int err, done, stopped = 0;
+	const char* mismatch = "not repeating\n";
 
 	if (parse_rc(fd, message, arguments, &remote, &code, 0, 0, &err) == 0)
 		return 0;
 	if (err)
 		return 1;
 
-	if (repeat_remote && repeat_code) {
-		int done;
-
-		if (remote && strcasecmp(remote->name, repeat_remote->name) != 0)
-			return send_error(fd, message, "specified remote does not match\n");
-		if (code && strcasecmp(code->name, repeat_code->name) != 0)
-			return send_error(fd, message, "specified code does not match\n");
-
-		done = repeat_max - repeat_remote->repeat_countdown;
-		if (done < repeat_remote->min_repeat) {
+	for (s = sessions; s != NULL; s = next) {
+		next = s->next;
+		if (remote && strcasecmp(remote->name, s->remote->name) != 0) {
+			mismatch = "specified remote does not match\n";
+			continue;
+		}
+		if (code && strcasecmp(code->name, s->code->name) != 0) {
+			mismatch = "specified code does not match\n";
+			continue;
+		}
+		stopped++;
+		done = repeat_max - s->remote->repeat_countdown;
+		if (done < s->remote->min_repeat) {
 			/* we still have some repeats to do */
-			repeat_remote->repeat_countdown = repeat_remote->min_repeat - done;
-			return send_success(fd, message);
+			s->remote->repeat_countdown = s->remote->min_repeat - done;
+			continue;
 		}
-		repeat_timer.it_value.tv_sec = 0;
-		repeat_timer.it_value.tv_usec = 0;
-		repeat_timer.it_interval.tv_sec = 0;
-		repeat_timer.it_interval.tv_usec = 0;
-
-		setitimer(ITIMER_REAL, &repeat_timer, NULL);
-
-		repeat_remote->toggle_mask_state = 0;
-		repeat_remote = NULL;
-		repeat_code = NULL;
+		s->remote->toggle_mask_state = 0;
 		/* clin!=0, so we don't have to deinit hardware */
-		alrm = 0;
-		return send_success(fd, message);
-	} else {
-		return send_error(fd, message, "not repeating\n");
+		end_session(s, 0);
 	}
+	if (stopped == 0)
+		return send_error(fd, message, "%s", mismatch);
+	return send_success(fd, message);
 }
 
 
@@ -1618,6 +2578,44 @@ static int version(int fd, char* message, char* arguments)
 }
 
 
+/*
+ * SET_EVENT_FORMAT TEXT|BINARY [version]: Switch the client to the text
+ * or the binary event protocol after the reply.
+ */
+static int set_event_format(int fd, char* message, char* arguments)
+{
+	struct client* c;
+	char* format;
+	char* version;
+	char* end;
+
+	if (!is_client(fd))
+		return send_error(fd, message, "not a client\n");
+	format = arguments != NULL ? strtok(arguments, WHITE_SPACE) : NULL;
+	if (format == NULL)
+		return send_error(fd, message, "no event format given\n");
+	if (strcasecmp(format, "TEXT") == 0) {
+		if (!send_success(fd, message))
+			return 0;
+		clis[fds[fd].client].binary = 0;
+		return 1;
+	}
+	if (strcasecmp(format, "BINARY") != 0)
+		return send_error(fd, message, "unknown event format: \"%s\"\n", format);
+	version = strtok(NULL, WHITE_SPACE);
+	if (version != NULL && (strtol(version, &end, 10) != LIRC_EVENT_PROTOCOL || *end != '\0'))
+		return send_error(fd, message, "unsupported protocol version: %s\n", version);
+	if (!send_success(fd, message))
+		return 0;
+	c = &clis[fds[fd].client];
+	c->binary = 1;
+	/* names are sent again, the client might have forgotten them */
+	if (c->names_sent != NULL)
+		memset(c->names_sent, 0, c->names_sent_size);
+	return 1;
+}
+
+
 static int drv_option(int fd, char* message, char* arguments)
 {
 	struct option_t option;
@@ -1668,30 +2666,39 @@ static int set_inputlog(int fd, char* message, char* arguments)
 }
 
 
-int get_command(int fd)
+/*
+ * Run the complete commands buffered for a client, in order, until it
+ * is paused. Return 0 if the client should be removed.
+ */
+static int run_commands(int fd)
 {
-	int length;
+	struct client* c;
 	char buffer[PACKET_SIZE + 1], backup[PACKET_SIZE + 1];
 	char* end;
-	int packet_length, i;
+	int len, i;
 	char* directive;
 
-	length = read_timeout(fd, buffer, PACKET_SIZE, 0);
-	packet_length = 0;
-	while (length > packet_length) {
-		buffer[length] = 0;
-		end = strchr(buffer, '\n');
+	/* A directive may remove this or another client, moving clis[] */
+	while (is_client(fd) && !fds[fd].paused) {
+		c = &clis[fds[fd].client];
+		end = (char*)memchr(c->in, '\n', c->in_len);
 		if (end == NULL) {
-			logprintf(LIRC_ERROR, "bad send packet: \"%s\"", buffer);
+			if (c->in_len < PACKET_SIZE)
+				return 1;
+			c->in[c->in_len] = 0;
+			logprintf(LIRC_ERROR, "bad send packet: \"%s\"", c->in);
 			/* remove clients that behave badly */
 			return 0;
 		}
-		end[0] = 0;
+		len = end + 1 - c->in;
+		memcpy(backup, c->in, len);
+		backup[len] = 0;
+		c->in_len -= len;
+		memmove(c->in, c->in + len, c->in_len);
+
+		memcpy(buffer, backup, len - 1);
+		buffer[len - 1] = 0;
 		LOGPRINTF(1, "received command: \"%s\"", buffer);
-		packet_length = strlen(buffer) + 1;
-
-		strcpy(backup, buffer);
-		strcat(backup, "\n");
 
 		/* remove DOS line endings */
 		end = strrchr(buffer, '\r');
@@ -1702,87 +2709,88 @@ int get_command(int fd)
 		if (directive == NULL) {
 			if (!send_error(fd, backup, "bad send packet\n"))
 				return 0;
-			goto skip;
-		}
-		for (i = 0; directives[i].name != NULL; i++) {
-			if (strcasecmp(directive, directives[i].name) == 0) {
-				if (!directives[i].function(fd, backup, strtok(NULL, "")))
-					return 0;
-				goto skip;
-			}
+			continue;
 		}
-
-		if (!send_error(fd, backup, "unknown directive: \"%s\"\n", directive))
+		for (i = 0; directives[i].name != NULL; i++)
+			if (strcasecmp(directive, directives[i].name) == 0)
+				break;
+		if (directives[i].name != NULL) {
+			if (!directives[i].function(fd, backup, strtok(NULL, "")))
+				return 0;
+		} else if (!send_error(fd, backup, "unknown directive: \"%s\"\n", directive)) {
 			return 0;
-skip:
-		if (length > packet_length) {
-			int new_length;
-
-			memmove(buffer, buffer + packet_length, length - packet_length + 1);
-			if (strchr(buffer, '\n') == NULL) {
-				new_length =
-					read_timeout(fd, buffer + length - packet_length,
-						     PACKET_SIZE - (length - packet_length), 5);
-				if (new_length > 0)
-					length = length - packet_length + new_length;
-				else
-					length = new_length;
-			} else {
-				length -= packet_length;
-			}
-			packet_length = 0;
 		}
 	}
-
-	if (length == 0)        /* EOF: connection closed by client */
-		return 0;
 	return 1;
 }
 
-void input_message(const char* message, const char* remote_name, const char* button_name, int reps, int release)
+/*
+ * Read what is available from a client without blocking, and run the
+ * complete commands. A partial command is kept until the rest arrives.
+ */
+int get_command(int fd)
 {
-	const char* release_message;
-	const char* release_remote_name;
-	const char* release_button_name;
+	struct client* c = &clis[fds[fd].client];
+	int n;
 
-	release_message = check_release_event(&release_remote_name, &release_button_name);
-	if (release_message)
-		input_message(release_message, release_remote_name, release_button_name, 0, 1);
+	n = read(fd, c->in + c->in_len, PACKET_SIZE - c->in_len);
+	if (n == -1) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 1;
+		logprintf(LIRC_ERROR, "read() failed");
+		logperror(LIRC_ERROR, NULL);
+		return 0;
+	}
+	if (n == 0)             /* EOF: connection closed by client */
+		return 0;
+	c->in_len += n;
+	return run_commands(fd);
+}
+
+/* Broadcast one event and queue its uinput key event, if any. */
+static void queue_message(const char* message, const char* remote_name, const struct ir_ncode* ncode, int reps, int release)
+{
+	const char* button_name = ncode != NULL ? ncode->name : "(NULL)";
 
 	if (!release || userelease)
-		broadcast_message(message);
+		broadcast_event(message, remote_name, button_name, release);
 
 #ifdef __linux__
 	if (uinputfd == -1 || reps >= 2)
 		return;
 
-	linux_input_code input_code;
-
-	if (get_input_code(button_name, &input_code) != -1) {
-		struct input_event event;
-
-		memset(&event, 0, sizeof(event));
-		event.type = EV_KEY;
-		event.code = input_code;
-		event.value = release ? 0 : (reps > 0 ? 2 : 1);
-		if (write(uinputfd, &event, sizeof(event)) != sizeof(event)) {
-			logprintf(LIRC_ERROR, "writing to uinput failed");
-			logperror(LIRC_ERROR, NULL);
-		}
-
-		/* Need to write sync event */
-		memset(&event, 0, sizeof(event));
-		event.type = EV_SYN;
-		event.code = SYN_REPORT;
-		event.value = 0;
-		if (write(uinputfd, &event, sizeof(event)) != sizeof(event)) {
-			logprintf(LIRC_ERROR, "writing EV_SYN to uinput failed");
-			logperror(LIRC_ERROR, NULL);
-		}
+	/* The input code was looked up when the config was read */
+	if (ncode != NULL && ncode->input_code != -1) {
+		uinput_batch_add(&uinput_out, EV_KEY, ncode->input_code,
+				 release ? 0 : (reps > 0 ? 2 : 1));
 	} else {
 		logprintf(LIRC_DEBUG,
 			  "Dropping non-standard symbol %s in uinput mode",
-			  button_name == NULL ? "Null" : button_name);
+			  button_name);
+	}
+#endif
+}
+
+/*
+ * Deliver an event, preceded by a pending release event if any. Both
+ * key events go to uinput as a single frame.
+ */
+void input_message(const char* message, const char* remote_name, const struct ir_ncode* ncode, int reps, int release)
+{
+	const char* release_message;
+	const char* release_remote_name;
+	const struct ir_ncode* release_ncode;
+
+	release_message = check_release_ncode(&release_remote_name, &release_ncode);
+	if (release_message)
+		queue_message(release_message, release_remote_name, release_ncode, 0, 1);
+	queue_message(message, remote_name, ncode, reps, release);
+
+#ifdef __linux__
+	uinput_batch_sync(&uinput_out);
+	if (!uinput_batch_flush(&uinput_out)) {
+		logprintf(LIRC_ERROR, "writing to uinput failed");
+		logperror(LIRC_ERROR, NULL);
 	}
 #endif
 }
@@ -1797,14 +2805,15 @@ void free_old_remotes(void)
 	struct ir_ncode* code;
 	const char* release_event;
 	const char* release_remote_name;
-	const char* release_button_name;
+	const struct ir_ncode* release_ncode;
+	struct send_session* s;
 
 	if (get_decoding() == free_remotes)
 		return;
 
-	release_event = release_map_remotes(free_remotes, remotes, &release_remote_name, &release_button_name);
+	release_event = release_map_remotes_ncode(free_remotes, remotes, &release_remote_name, &release_ncode);
 	if (release_event != NULL)
-		input_message(release_event, release_remote_name, release_button_name, 0, 1);
+		input_message(release_event, release_remote_name, release_ncode, 0, 1);
 	if (last_remote != NULL) {
 		if (is_in_remotes(free_remotes, last_remote)) {
 			logprintf(LIRC_INFO, "last_remote found");
@@ -1828,45 +2837,24 @@ void free_old_remotes(void)
 	}
 	/* check if last config is still needed */
 	found = NULL;
-	if (repeat_remote != NULL) {
-		scan_remotes = free_remotes;
-		while (scan_remotes != NULL) {
-			if (repeat_remote == scan_remotes) {
-				found = repeat_remote;
-				break;
-			}
-			scan_remotes = scan_remotes->next;
-		}
-		if (found != NULL) {
-			found = get_ir_remote(remotes, repeat_remote->name);
-			if (found != NULL) {
-				code = get_code_by_name(found, repeat_code->name);
-				if (code != NULL) {
-					struct itimerval repeat_timer;
-
-					repeat_timer.it_value.tv_sec = 0;
-					repeat_timer.it_value.tv_usec = 0;
-					repeat_timer.it_interval.tv_sec = 0;
-					repeat_timer.it_interval.tv_usec = 0;
-
-					found->last_code = code;
-					found->last_send = repeat_remote->last_send;
-					found->toggle_bit_mask_state = repeat_remote->toggle_bit_mask_state;
-					found->min_remaining_gap = repeat_remote->min_remaining_gap;
-					found->max_remaining_gap = repeat_remote->max_remaining_gap;
-
-					setitimer(ITIMER_REAL, &repeat_timer, &repeat_timer);
-					/* "atomic" (shouldn't be necessary any more) */
-					repeat_remote = found;
-					repeat_code = code;
-					/* end "atomic" */
-					setitimer(ITIMER_REAL, &repeat_timer, NULL);
-					found = NULL;
-				}
-			} else {
-				found = repeat_remote;
-			}
+	for (s = sessions; s != NULL; s = s->next) {
+		if (!is_in_remotes(free_remotes, s->remote))
+			continue;
+		scan_remotes = get_ir_remote(remotes, s->remote->name);
+		code = scan_remotes ? get_code_by_name(scan_remotes, s->code->name) : NULL;
+		if (code == NULL) {
+			/* keep repeating from the old config */
+			found = s->remote;
+			continue;
 		}
+		scan_remotes->last_code = code;
+		scan_remotes->last_send = s->remote->last_send;
+		scan_remotes->toggle_bit_mask_state = s->remote->toggle_bit_mask_state;
+		scan_remotes->min_remaining_gap = s->remote->min_remaining_gap;
+		scan_remotes->max_remaining_gap = s->remote->max_remaining_gap;
+		scan_remotes->repeat_countdown = s->remote->repeat_countdown;
+		s->remote = scan_remotes;
+		s->code = code;
 	}
 	if (found == NULL && get_decoding() != free_remotes) {
 		free_config(free_remotes);
@@ -1877,11 +2865,82 @@ void free_old_remotes(void)
 }
 
 
-static int mywaitfordata(unsigned long maxusec)
+/* Bring the poll set in line with the driver state. */
+static void sync_watches(void)
+{
+	int fd;
+
+	fd = use_hw() && curr_driver->rec_mode != 0 ? curr_driver->fd : -1;
+	if (fd != driver_fd) {
+		unwatch_driver();
+		driver_fd = fd;
+		/* Some drivers hand out e. g. /dev/zero while they have
+		 * buffered data. Like select() would, treat such a fd as
+		 * always readable. */
+		driver_unpolled = fd != -1 && !watch_fd(fd, WATCH_DRIVER);
+	}
+}
+
+/* Arm the release, send and peer reconnect timers, return poll timeout [ms]. */
+static int set_timers(void)
+{
+	struct timeval tv, due, now;
+	struct send_session* s;
+	int i, timeout;
+
+	get_release_time(&tv);
+	timer_set(&release_timer, &tv);
+
+	timerclear(&tv);
+	for (i = 0; i < peern; i++) {
+		if (peers[i]->socket != -1)
+			continue;
+		if (!timerisset(&tv) || timercmp(&tv, &peers[i]->reconnect, >))
+			tv = peers[i]->reconnect;
+	}
+	timer_set(&reconnect_timer, &tv);
+
+	timerclear(&tv);
+	for (s = sessions; s != NULL; s = s->next) {
+		session_due(s, &due);
+		if (!timerisset(&tv) || timercmp(&tv, &due, >))
+			tv = due;
+	}
+	timer_set(&send_timer, &tv);
+
+	/* try to reconnect the driver once a second */
+	timeout = curr_driver->fd == -1 && use_hw() ? 1000 : -1;
+	if (driver_unpolled || (driver_fd != -1 && rec_buffer_pending()))
+		timeout = 0;
+	if (resumed_input)
+		timeout = 0;
+	gettimeofday(&now, NULL);
+	timeout = timer_timeout(&release_timer, &now, timeout);
+	timeout = timer_timeout(&reconnect_timer, &now, timeout);
+	timeout = timer_timeout(&send_timer, &now, timeout);
+#ifdef SIM_REC
+	timeout = -1;
+#endif
+	return timeout;
+}
+
+static void peer_disconnected(struct peer_connection* peer)
 {
-	fd_set fds;
-	int maxfd, i, ret, reconnect;
-	struct timeval tv, start, now, timeout, release_time;
+	unwatch_fd(peer->socket, WATCH_PEER);
+	shutdown(peer->socket, 2);
+	close(peer->socket);
+	peer->socket = -1;
+	peer->connection_failure = 1;
+	gettimeofday(&peer->reconnect, NULL);
+	peer->reconnect.tv_sec += 5;
+}
+
+static int mywaitfordata(void)
+{
+	struct ready_fd ready[MAX_EVENTS];
+	int i, j, n, fd, have_data;
+	struct timeval now;
+	uint64_t expirations;
 	loglevel_t oldlevel;
 
 	while (1) {
@@ -1894,169 +2953,107 @@ static int mywaitfordata(unsigned long maxusec)
 				dosighup(SIGHUP);
 				hup = 0;
 			}
-			if (alrm) {
-				dosigalrm(SIGALRM);
-				alrm = 0;
-			}
-			FD_ZERO(&fds);
-			FD_SET(sockfd, &fds);
-
-			maxfd = sockfd;
-			if (listen_tcpip) {
-				FD_SET(sockinet, &fds);
-				maxfd = max(maxfd, sockinet);
-			}
-			if (use_hw() && curr_driver->rec_mode != 0 && curr_driver->fd != -1) {
-				FD_SET(curr_driver->fd, &fds);
-				maxfd = max(maxfd, curr_driver->fd);
-			}
-
-			for (i = 0; i < clin; i++) {
-				/* Ignore this client until codes have been
-				 * sent and it will get an answer. Otherwise
-				 * we could mix up answer packets and send
-				 * them back in the wrong order. */
-				if (clis[i] != repeat_fd) {
-					FD_SET(clis[i], &fds);
-					maxfd = max(maxfd, clis[i]);
-				}
-			}
-			timerclear(&tv);
-			reconnect = 0;
-			for (i = 0; i < peern; i++) {
-				if (peers[i]->socket != -1) {
-					FD_SET(peers[i]->socket, &fds);
-					maxfd = max(maxfd, peers[i]->socket);
-				} else if (timerisset(&tv)) {
-					if (timercmp(&tv, &peers[i]->reconnect, >))
-						tv = peers[i]->reconnect;
-				} else {
-					tv = peers[i]->reconnect;
-				}
-			}
-			if (timerisset(&tv)) {
-				gettimeofday(&now, NULL);
-				if (timercmp(&now, &tv, >)) {
-					timerclear(&tv);
-				} else {
-					timersub(&tv, &now, &start);
-					tv = start;
-				}
-				reconnect = 1;
-			}
-			gettimeofday(&start, NULL);
-			if (maxusec > 0) {
-				tv.tv_sec = maxusec / 1000000;
-				tv.tv_usec = maxusec % 1000000;
-			}
-			if (curr_driver->fd == -1 && use_hw()) {
-				/* try to reconnect */
-				timerclear(&timeout);
-				timeout.tv_sec = 1;
-
-				if (timercmp(&tv, &timeout, >)
-				    || (!reconnect && !timerisset(&tv)))
-					tv = timeout;
-			}
-			get_release_time(&release_time);
-			if (timerisset(&release_time)) {
-				gettimeofday(&now, NULL);
-				if (timercmp(&now, &release_time, >)) {
-					timerclear(&tv);
-				} else {
-					struct timeval gap;
-
-					timersub(&release_time, &now, &gap);
-					if (!(timerisset(&tv)
-					      || reconnect)
-					    || timercmp(&tv, &gap, >))
-						tv = gap;
-				}
-			}
-#ifdef SIM_REC
-			ret = select(maxfd + 1, &fds, NULL, NULL, NULL);
-#else
-			if (timerisset(&tv) || timerisset(&release_time) || reconnect)
-				ret = select(maxfd + 1, &fds, NULL, NULL, &tv);
-			else
-				ret = select(maxfd + 1, &fds, NULL, NULL, NULL);
-
-#endif
-			if (ret == -1 && errno != EINTR) {
-				logprintf(LIRC_ERROR, "select() failed");
+			sync_watches();
+			lirc_log_drain();
+			n = poll_wait(ready, set_timers());
+			if (n == -1 && errno != EINTR) {
+				logprintf(LIRC_ERROR, "poll failed");
 				logperror(LIRC_ERROR, NULL);
 				raise(SIGTERM);
 				continue;
 			}
 			gettimeofday(&now, NULL);
-			if (timerisset(&release_time) && timercmp(&now, &release_time, >)) {
+			if (timer_expired(&release_timer, &now)) {
 				const char* release_message;
 				const char* release_remote_name;
-				const char* release_button_name;
+				const struct ir_ncode* release_ncode;
 
 				release_message =
-					trigger_release_event(&release_remote_name,
-							      &release_button_name);
+					trigger_release_ncode(&release_remote_name,
+							      &release_ncode);
 				if (release_message) {
 					input_message(release_message,
 						      release_remote_name,
-						      release_button_name,
+						      release_ncode,
 						      0, 1);
 				}
 			}
+			if (timer_expired(&send_timer, &now))
+				run_sessions();
 			if (free_remotes != NULL)
 				free_old_remotes();
-			if (maxusec > 0) {
-				if (ret == 0)
-					return 0;
-				if (time_elapsed(&start, &now) >= maxusec)
-					return 0;
-				maxusec -= time_elapsed(&start, &now);
-			}
-			if (reconnect)
+			if (timer_expired(&reconnect_timer, &now))
 				connect_to_peers();
-		} while (ret == -1 && errno == EINTR);
+		} while (n == -1 && errno == EINTR);
 
 		if (curr_driver->fd == -1 && use_hw() && curr_driver->init_func) {
 			oldlevel = loglevel;
 			lirc_log_setlevel(LIRC_ERROR);
 			curr_driver->init_func();
+			rec_buffer_init();
 			setup_hardware();
 			lirc_log_setlevel(oldlevel);
 		}
-		for (i = 0; i < clin; i++) {
-			if (FD_ISSET(clis[i], &fds)) {
-				FD_CLR(clis[i], &fds);
-				if (get_command(clis[i]) == 0) {
-					remove_client(clis[i]);
-					i--;
-				}
+		/* Clients first, listening sockets last: a fd closed while
+		 * handling the events can't be reused before we are done. */
+		for (i = 0; i < n; i++) {
+			fd = ready[i].fd;
+			if (fds[fd].watch != WATCH_CLIENT || !is_client(fd))
+				continue;
+			if ((ready[i].what & READY_OUT)
+			    && !flush_client(&clis[fds[fd].client])) {
+				remove_client(fd);
+				continue;
 			}
+			if (!(ready[i].what & READY_IN))
+				continue;
+			/* POLLIN is off while paused, so it's a hangup */
+			if (fds[fd].paused || get_command(fd) == 0)
+				remove_client(fd);
 		}
-		for (i = 0; i < peern; i++) {
-			if (peers[i]->socket != -1 && FD_ISSET(peers[i]->socket, &fds)) {
-				if (get_peer_message(peers[i]) == 0) {
-					shutdown(peers[i]->socket, 2);
-					close(peers[i]->socket);
-					peers[i]->socket = -1;
-					peers[i]->connection_failure = 1;
-					gettimeofday(&peers[i]->reconnect, NULL);
-					peers[i]->reconnect.tv_sec += 5;
-				}
+		/* Run commands read ahead while a client was paused. Going
+		 * backwards, remove_client() only moves visited clients;
+		 * commands resuming a visited client need another pass. */
+		while (resumed_input) {
+			resumed_input = 0;
+			for (i = clin - 1; i >= 0; i--) {
+				if (i >= clin || clis[i].in_len == 0)
+					continue;
+				fd = clis[i].fd;
+				if (run_commands(fd) == 0)
+					remove_client(fd);
 			}
 		}
-
-		if (FD_ISSET(sockfd, &fds)) {
-			LOGPRINTF(1, "registering local client");
-			add_client(sockfd);
+		for (i = 0; i < n; i++) {
+			fd = ready[i].fd;
+			if (fds[fd].watch != WATCH_PEER)
+				continue;
+			for (j = 0; j < peern; j++)
+				if (peers[j]->socket == fd && get_peer_message(peers[j]) == 0)
+					peer_disconnected(peers[j]);
 		}
-		if (listen_tcpip && FD_ISSET(sockinet, &fds)) {
-			LOGPRINTF(1, "registering inet client");
-			add_client(sockinet);
+		/* data read ahead by readdata_batch() is ready, too */
+		have_data = (driver_unpolled || rec_buffer_pending())
+			    && driver_fd != -1 && driver_fd == curr_driver->fd;
+		for (i = 0; i < n; i++) {
+			fd = ready[i].fd;
+			switch (fds[fd].watch) {
+			case WATCH_LISTEN:
+				LOGPRINTF(1, "registering %s client", fd == sockfd ? "local" : "inet");
+				add_client(fd);
+				break;
+			case WATCH_TIMER:
+				/* expiry is checked against the clock above */
+				if (read(fd, &expirations, sizeof(expirations)) == -1)
+					LOGPRINTF(1, "timer read failed");
+				break;
+			case WATCH_DRIVER:
+				have_data = fd == curr_driver->fd && use_hw()
+					    && curr_driver->rec_mode != 0;
+				break;
+			}
 		}
-		if (use_hw() && curr_driver->rec_mode != 0
-		    && curr_driver->fd != -1
-		    && FD_ISSET(curr_driver->fd, &fds)) {
+		if (have_data) {
 			register_input();
 			/* we will read later */
 			return 1;
@@ -2068,24 +3065,37 @@ void loop(void)
 {
 	char* message;
 
+	/* after daemonize(), the poll set is not shared across fork() */
+	if (!poll_open()) {
+		logprintf(LIRC_ERROR, "cannot create poll set");
+		logperror(LIRC_ERROR, NULL);
+		dosigterm(SIGTERM);
+	}
+	if (!watch_fd(sockfd, WATCH_LISTEN)
+	    || (listen_tcpip && !watch_fd(sockinet, WATCH_LISTEN)))
+		dosigterm(SIGTERM);
+	timer_open(&release_timer);
+	timer_open(&reconnect_timer);
+	timer_open(&send_timer);
+
 	logprintf(LIRC_NOTICE, "lircd(%s) ready, using %s", curr_driver->name, lircdfile);
 	while (1) {
-		(void)mywaitfordata(0);
+		(void)mywaitfordata();
 		if (!curr_driver->rec_func)
 			continue;
 		message = curr_driver->rec_func(remotes);
 
 		if (message != NULL) {
 			const char* remote_name;
-			const char* button_name;
+			const struct ir_ncode* ncode;
 			int reps;
 
 			if (curr_driver->drvctl_func && (curr_driver->features & LIRC_CAN_NOTIFY_DECODE))
 				curr_driver->drvctl_func(LIRC_NOTIFY_DECODE, NULL);
 
-			get_release_data(&remote_name, &button_name, &reps);
+			get_release_ncode(&remote_name, &ncode, &reps);
 
-			input_message(message, remote_name, button_name, reps, 0);
+			input_message(message, remote_name, ncode, reps, 0);
 		}
 	}
 }
@@ -2146,6 +3156,12 @@ static void lircd_add_defaults(void)
 		"lircd:plugindir",	PLUGINDIR,
 		"lircd:uinput",		"False",
 		"lircd:repeat-max",	DEFAULT_REPEAT_MAX,
+		"lircd:rec-buffer",	"512",
+		"lircd:queue-size",	"16384",
+		"lircd:queue-overflow",	"drop",
+		"lircd:config-cache",	"",
+		"lircd:adaptive-order",	"False",
+		"lircd:async-log",	"False",
 		"lircd:configfile",	LIRCDCFGFILE,
 		"lircd:driver-options",	"",
 		"lircd:effective-user",	"",
@@ -2176,7 +3192,7 @@ int parse_peer_connections(const char* opt)
 static void lircd_parse_options(int argc, char** const argv)
 {
 	int c;
-	const char* optstring = "A:e:O:hvnp:H:d:o:U:P:l::L:c:r::aR:D::Y"
+	const char* optstring = "A:e:O:hvnp:H:d:o:U:P:l::L:c:r::aR:D::Yb:q:Q:C:MB"
 #       if defined(__linux__)
 				"u"
 #       endif
@@ -2259,6 +3275,24 @@ static void lircd_parse_options(int argc, char** const argv)
 		case 'R':
 			options_set_opt("lircd:repeat-max", optarg);
 			break;
+		case 'b':
+			options_set_opt("lircd:rec-buffer", optarg);
+			break;
+		case 'q':
+			options_set_opt("lircd:queue-size", optarg);
+			break;
+		case 'Q':
+			options_set_opt("lircd:queue-overflow", optarg);
+			break;
+		case 'C':
+			options_set_opt("lircd:config-cache", optarg);
+			break;
+		case 'M':
+			options_set_opt("lircd:adaptive-order", "True");
+			break;
+		case 'B':
+			options_set_opt("lircd:async-log", "True");
+			break;
 		case 'Y':
 			options_set_opt("lircd:dynamic-codes", "True");
 			break;
@@ -2286,6 +3320,7 @@ int main(int argc, char** argv)
 	const char* device = NULL;
 	char errmsg[128];
 	const char* opt;
+	int i;
 
 	address.s_addr = htonl(INADDR_ANY);
 	hw_choose_driver(NULL);
@@ -2348,10 +3383,32 @@ int main(int argc, char** argv)
 	userelease = options_getboolean("lircd:release");
 	set_release_suffix(options_getstring("lircd:release_suffix"));
 	allow_simulate = options_getboolean("lircd:allow-simulate");
+	set_adaptive_order(options_getboolean("lircd:adaptive-order"));
 #       if defined(__linux__)
 	useuinput = options_getboolean("lircd:uinput");
 #       endif
 	repeat_max = options_getint("lircd:repeat-max");
+	i = options_getint("lircd:rec-buffer");
+	if (i <= 0 || !rec_buffer_set_size(i)) {
+		fprintf(stderr, "%s: bad receive buffer size\n", progname);
+		return EXIT_FAILURE;
+	}
+	i = options_getint("lircd:queue-size");
+	if (i < 1024) {
+		fprintf(stderr, "%s: queue size must be at least 1024\n", progname);
+		return EXIT_FAILURE;
+	}
+	for (queue_size = 1024; queue_size < (unsigned int)i; queue_size *= 2)
+		;
+	opt = options_getstring("lircd:queue-overflow");
+	for (i = 0; overflow_policies[i] != NULL; i++)
+		if (strcasecmp(opt, overflow_policies[i]) == 0)
+			break;
+	if (overflow_policies[i] == NULL) {
+		fprintf(stderr, "%s: bad queue overflow policy \"%s\"\n", progname, opt);
+		return EXIT_FAILURE;
+	}
+	queue_overflow = i;
 	configfile = options_getstring("lircd:configfile");
 	curr_driver->open_func(device);
 	if (strcmp(curr_driver->name, "null") == 0 && peern == 0) {
@@ -2374,11 +3431,6 @@ int main(int argc, char** argv)
 	sigaction(SIGTERM, &act, NULL);
 	sigaction(SIGINT, &act, NULL);
 
-	act.sa_handler = sigalrm;
-	sigemptyset(&act.sa_mask);
-	act.sa_flags = SA_RESTART;      /* don't fiddle with EINTR */
-	sigaction(SIGALRM, &act, NULL);
-
 	act.sa_handler = dosigterm;
 	sigemptyset(&act.sa_mask);
 	act.sa_flags = SA_RESTART;
@@ -2395,6 +3447,9 @@ int main(int argc, char** argv)
 	/* ready to accept connections */
 	if (!nodaemon)
 		daemonize();
+	/* after daemonize(), only the daemon process drains the log */
+	if (options_getboolean("lircd:async-log") && !lirc_log_set_async(1))
+		logprintf(LIRC_WARNING, "cannot enable async logging");
 
 #if defined(SIM_SEND)
 	{
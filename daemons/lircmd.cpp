@@ -33,6 +33,7 @@
 #if defined(__linux__)
 #include <linux/input.h>
 #include <linux/uinput.h>
+#include "uinput_batch.h"
 #else
 #include <stdint.h>
 typedef int8_t __s8;
@@ -69,6 +70,9 @@ typedef uint64_t __u64;
 	" TRACE2 or a number in the range 3..10.\n"
 
 static int uinputfd = -1;
+#if defined(__linux__)
+static struct uinput_batch uinput_out;
+#endif
 static int useuinput = 0;
 static loglevel_t loglevel_opt = LIRC_NOLOG;
 
@@ -315,17 +319,11 @@ setup_error:
 	return -1;
 }
 
-void write_uinput(__u16 type, __u16 code, __s32 value)
+/* Write the frames queued in uinput_out. */
+void flush_uinput(void)
 {
 #ifdef __linux__
-	struct input_event event;
-
-	memset(&event, 0, sizeof(event));
-	event.type = type;
-	event.code = code;
-	event.value = value;
-
-	if (write(uinputfd, &event, sizeof(event)) != sizeof(event)) {
+	if (!uinput_batch_flush(&uinput_out)) {
 		static int once = 1;
 
 		if (once) {
@@ -398,41 +396,29 @@ void msend(int dx, int dy, int dz, int rep, int buttp, int buttr)
 
 #if defined(__linux__)
 	if (uinputfd != -1) {
+		/* One frame per step, all steps in one write */
 		for (i = 0; i < f; i++) {
 			if ((dx != 0) || (dy != 0)) {
-				write_uinput(EV_REL, REL_X, dx);
-				write_uinput(EV_REL, REL_Y, dy);
-				write_uinput(EV_SYN, SYN_REPORT, 0);
-			}
-			if (dz != 0) {
-				write_uinput(EV_REL, REL_WHEEL, dz);
-				write_uinput(EV_SYN, SYN_REPORT, 0);
-			}
-			if (buttp & BUTTON1) {
-				write_uinput(EV_KEY, BTN_LEFT, 1);
-				write_uinput(EV_SYN, SYN_REPORT, 0);
-			}
-			if (buttr & BUTTON1) {
-				write_uinput(EV_KEY, BTN_LEFT, 0);
-				write_uinput(EV_SYN, SYN_REPORT, 0);
-			}
-			if (buttp & BUTTON2) {
-				write_uinput(EV_KEY, BTN_MIDDLE, 1);
-				write_uinput(EV_SYN, SYN_REPORT, 0);
-			}
-			if (buttr & BUTTON2) {
-				write_uinput(EV_KEY, BTN_MIDDLE, 0);
-				write_uinput(EV_SYN, SYN_REPORT, 0);
-			}
-			if (buttp & BUTTON3) {
-				write_uinput(EV_KEY, BTN_RIGHT, 1);
-				write_uinput(EV_SYN, SYN_REPORT, 0);
-			}
-			if (buttr & BUTTON3) {
-				write_uinput(EV_KEY, BTN_RIGHT, 0);
-				write_uinput(EV_SYN, SYN_REPORT, 0);
+				uinput_batch_add(&uinput_out, EV_REL, REL_X, dx);
+				uinput_batch_add(&uinput_out, EV_REL, REL_Y, dy);
 			}
+			if (dz != 0)
+				uinput_batch_add(&uinput_out, EV_REL, REL_WHEEL, dz);
+			if (buttp & BUTTON1)
+				uinput_batch_add(&uinput_out, EV_KEY, BTN_LEFT, 1);
+			if (buttr & BUTTON1)
+				uinput_batch_add(&uinput_out, EV_KEY, BTN_LEFT, 0);
+			if (buttp & BUTTON2)
+				uinput_batch_add(&uinput_out, EV_KEY, BTN_MIDDLE, 1);
+			if (buttr & BUTTON2)
+				uinput_batch_add(&uinput_out, EV_KEY, BTN_MIDDLE, 0);
+			if (buttp & BUTTON3)
+				uinput_batch_add(&uinput_out, EV_KEY, BTN_RIGHT, 1);
+			if (buttr & BUTTON3)
+				uinput_batch_add(&uinput_out, EV_KEY, BTN_RIGHT, 0);
+			uinput_batch_sync(&uinput_out);
 		}
+		flush_uinput();
 	}
 #endif
 }
@@ -906,6 +892,9 @@ int main(int argc, char** argv)
 		/* create uinput device */
 
 		uinputfd = setup_uinputfd(progname);
+#if defined(__linux__)
+		uinput_batch_init(&uinput_out, uinputfd);
+#endif
 	} else {
 		/* open fifo */
 
@@ -107,6 +107,9 @@ static int daemonized = 0;
 
 static struct lirc_config* config;
 
+/** Input from lircd, read with lirc_code_read(). */
+static lirc_code_ctx lircd_input;
+
 static int send_error(int fd, char* message, const char* format_str, ...);
 static int handle_input(void);
 
@@ -699,9 +702,9 @@ static int schedule(int index, char* config_string)
 	return 1;
 }
 
-static int handle_input(void)
+/** Queue a button event from lircd for all clients and run its configs. */
+static int handle_code(char* code)
 {
-	char* code;
 	char* config_string;
 	char* prog;
 	int ret;
@@ -709,10 +712,6 @@ static int handle_input(void)
 	struct event_info* n;
 	int i;
 
-	LOGPRINTF(1, "input from lircd");
-	if (lirc_nextcode(&code) != 0)
-		return 0;
-
 	for (i = 0; i < clin; i++) {
 		n = (struct event_info*) malloc(sizeof(*n));
 
@@ -766,11 +765,22 @@ static int handle_input(void)
 			free(backup);
 		}
 	}
-	free(code);
-
 	return 1;
 }
 
+
+static int handle_input(void)
+{
+	struct lirc_code_event event;
+	int r;
+
+	LOGPRINTF(1, "input from lircd");
+	while ((r = lirc_code_read(&lircd_input, &event)) == 1)
+		if (!handle_code(event.line))
+			return 0;
+	return r == 0;
+}
+
 int main(int argc, char** argv)
 {
 	char* configfile;
@@ -831,6 +841,7 @@ int main(int argc, char** argv)
 	lircdfd = lirc_init("lircrcd", 0);
 	if (lircdfd == -1)
 		return EXIT_FAILURE;
+	lirc_code_start(&lircd_input, lircdfd);
 
 	/* read config file */
 	if (lirc_readconfig_only(configfile, &config, NULL) != 0) {
@@ -0,0 +1,96 @@
+/****************************************************************************
+** uinput_batch.c **********************************************************
+****************************************************************************
+*
+* uinput_batch.c - queue input events and write them to uinput in frames
+*
+*/
+
+/**
+ * @file uinput_batch.c
+ * @brief Implements uinput_batch.h
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <string.h>
+#include <unistd.h>
+
+#include "uinput_batch.h"
+
+#if defined __linux__
+
+void uinput_batch_init(struct uinput_batch* batch, int fd)
+{
+	memset(batch, 0, sizeof(*batch));
+	batch->fd = fd;
+}
+
+
+/* Queue one event; the caller makes sure there is room for it. */
+static void queue_event(struct uinput_batch* batch,
+			__u16 type, __u16 code, __s32 value)
+{
+	struct input_event* event = &batch->queue[batch->count++];
+
+	memset(event, 0, sizeof(*event));
+	event->type = type;
+	event->code = code;
+	event->value = value;
+}
+
+
+void uinput_batch_sync(struct uinput_batch* batch)
+{
+	if (batch->count == batch->frame)
+		return;
+	if (batch->count == UINPUT_BATCH_SIZE)
+		uinput_batch_flush(batch);
+	queue_event(batch, EV_SYN, SYN_REPORT, 0);
+	batch->frame = batch->count;
+}
+
+
+void uinput_batch_add(struct uinput_batch* batch,
+		      __u16 type, __u16 code, __s32 value)
+{
+	int i;
+
+	for (i = batch->frame; i < batch->count; i++) {
+		if (batch->queue[i].type == type
+		    && batch->queue[i].code == code) {
+			uinput_batch_sync(batch);
+			break;
+		}
+	}
+	/* Keep a slot for the SYN_REPORT ending the frame */
+	if (batch->count >= UINPUT_BATCH_SIZE - 1)
+		uinput_batch_flush(batch);
+	queue_event(batch, type, code, value);
+}
+
+
+int uinput_batch_flush(struct uinput_batch* batch)
+{
+	size_t size = batch->count * sizeof(struct input_event);
+	int ok = 1;
+
+	if (batch->count == 0)
+		return 1;
+	if (batch->fd != -1) {
+		batch->writes++;
+		if (write(batch->fd, batch->queue, size) == (ssize_t)size) {
+			batch->events += batch->count;
+		} else {
+			batch->errors++;
+			ok = 0;
+		}
+	}
+	batch->count = 0;
+	batch->frame = 0;
+	return ok;
+}
+
+#endif /* __linux__ */
@@ -0,0 +1,78 @@
+/****************************************************************************
+** uinput_batch.h **********************************************************
+****************************************************************************
+*
+* uinput_batch.h - queue input events and write them to uinput in frames
+*
+*/
+
+/**
+ * @file uinput_batch.h
+ * @brief Batched output of events to a Linux uinput device.
+ * @ingroup private_api
+ *
+ * Events are queued with uinput_batch_add(), uinput_batch_sync() ends
+ * a frame with EV_SYN/SYN_REPORT and uinput_batch_flush() writes all
+ * queued frames in a single write(). A frame may carry several key and
+ * axis events; adding an event for a type and code which is already in
+ * the current frame ends the frame first, so e. g. a release and the
+ * next press of different keys share one frame while a release and
+ * press of the same key do not.
+ */
+
+#ifndef UINPUT_BATCH_H
+#define UINPUT_BATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined __linux__
+
+#include <linux/input.h>
+
+/** Max number of queued events, the batch is flushed when full. */
+#define UINPUT_BATCH_SIZE 64
+
+/** Event queue for one uinput device. */
+struct uinput_batch {
+	/** uinput device, -1 if none. */
+	int			fd;
+	/** Number of queued events. */
+	int			count;
+	/** Index of the first event in the current frame. */
+	int			frame;
+	/** Number of write() calls done. */
+	unsigned long		writes;
+	/** Number of events written. */
+	unsigned long		events;
+	/** Number of failed write() calls. */
+	unsigned long		errors;
+	/** The queued events. */
+	struct input_event	queue[UINPUT_BATCH_SIZE];
+};
+
+/** Set up an empty batch writing to fd. */
+void uinput_batch_init(struct uinput_batch* batch, int fd);
+
+/** Queue an event, ending the frame first if it already has type/code. */
+void uinput_batch_add(struct uinput_batch* batch,
+		      __u16 type, __u16 code, __s32 value);
+
+/** End the current frame with EV_SYN/SYN_REPORT, if it is not empty. */
+void uinput_batch_sync(struct uinput_batch* batch);
+
+/**
+ * Write all queued events in one write() and empty the queue.
+ *
+ * @return 1 on success or if nothing was queued, 0 on errors.
+ */
+int uinput_batch_flush(struct uinput_batch* batch);
+
+#endif /* __linux__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UINPUT_BATCH_H */
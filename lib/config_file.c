@@ -33,6 +33,9 @@
 #include <sys/types.h>
 #include <fcntl.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/mman.h>
 
 #include "include/media/lirc.h"
 #include "lirc/lirc_log.h"
@@ -41,6 +44,7 @@
 #include "lirc/config_file.h"
 #include "lirc/transmit.h"
 #include "lirc/config_flags.h"
+#include "lirc/input_map.h"
 
 
 enum directive { ID_none, ID_remote, ID_codes, ID_raw_codes, ID_raw_name };
@@ -59,6 +63,26 @@ struct void_array {
 };
 
 
+/*
+ * All data of a config generation, i. e. the remotes returned by one
+ * read_config(), is allocated from an arena which free_config() frees
+ * as a whole.
+ */
+struct arena_chunk {
+	struct arena_chunk*	next;
+	size_t			size;   /**< Bytes available after header. */
+	size_t			used;
+};
+
+struct ir_arena {
+	struct arena_chunk*	chunks;         /**< Current chunk first. */
+};
+
+#define ARENA_CHUNK_SIZE	(64 * 1024)
+#define ARENA_ALIGN		16
+#define ARENA_HDR_SIZE \
+	((sizeof(struct arena_chunk) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
 #define LINE_LEN 1024
 #define MAX_INCLUDES 10
 
@@ -67,8 +91,62 @@ const char* whitespace = " \t";
 static int line;
 static int parse_error;
 
+/** Arena of config being read, NULL if none. */
+static struct ir_arena* arena;
+
 static struct ir_remote* read_config_recursive(FILE* f, const char* name, int depth);
+static void clear_sources(void);
+static void add_source(const char* path);
 static void calculate_signal_lengths(struct ir_remote* remote);
+static void set_input_codes(struct ir_remote* remote);
+
+static struct ir_arena* arena_new(void)
+{
+	return calloc(1, sizeof(struct ir_arena));
+}
+
+
+static void* arena_alloc(struct ir_arena* a, size_t size)
+{
+	struct arena_chunk* c = a->chunks;
+	int large;
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	if (c == NULL || c->used + size > c->size) {
+		large = size > ARENA_CHUNK_SIZE / 4;
+		c = malloc(ARENA_HDR_SIZE + (large ? size : ARENA_CHUNK_SIZE));
+		if (c == NULL)
+			return NULL;
+		c->size = large ? size : ARENA_CHUNK_SIZE;
+		c->used = 0;
+		if (large && a->chunks != NULL) {
+			/* Large block, keep using the current chunk. */
+			c->next = a->chunks->next;
+			a->chunks->next = c;
+		} else {
+			c->next = a->chunks;
+			a->chunks = c;
+		}
+	}
+	c->used += size;
+	return (char*)c + ARENA_HDR_SIZE + c->used - size;
+}
+
+
+static void arena_free(struct ir_arena* a)
+{
+	struct arena_chunk* next;
+
+	if (a == NULL)
+		return;
+	while (a->chunks != NULL) {
+		next = a->chunks->next;
+		free(a->chunks);
+		a->chunks = next;
+	}
+	free(a);
+}
+
 
 void** init_void_array(struct void_array* ar, size_t chunk_size, size_t item_size)
 {
@@ -140,7 +218,7 @@ void* s_malloc(size_t size)
 {
 	void* ptr;
 
-	ptr = malloc(size);
+	ptr = arena != NULL ? arena_alloc(arena, size) : malloc(size);
 	if (ptr == NULL) {
 		logprintf(LIRC_ERROR, "out of memory");
 		parse_error = 1;
@@ -154,7 +232,13 @@ char* s_strdup(char* string)
 {
 	char* ptr;
 
-	ptr = strdup(string);
+	if (arena != NULL) {
+		ptr = arena_alloc(arena, strlen(string) + 1);
+		if (ptr != NULL)
+			strcpy(ptr, string);
+	} else {
+		ptr = strdup(string);
+	}
 	if (!ptr) {
 		logprintf(LIRC_ERROR, "out of memory");
 		parse_error = 1;
@@ -163,6 +247,32 @@ char* s_strdup(char* string)
 	return ptr;
 }
 
+/** Free memory from s_malloc() or s_strdup(). */
+static void s_free(void* ptr)
+{
+	if (arena == NULL)
+		free(ptr);
+}
+
+/**
+ * Return the items of ar including the terminating zeroed one, moved to
+ * one block from s_malloc(). ar is empty afterwards.
+ */
+static void* finish_void_array(struct void_array* ar)
+{
+	size_t size = ar->item_size * (ar->nr_items + 1);
+	void* ptr;
+
+	if (arena == NULL || ar->ptr == NULL)
+		return ar->ptr;
+	ptr = s_malloc(size);
+	if (ptr != NULL)
+		memcpy(ptr, ar->ptr, size);
+	free(ar->ptr);
+	ar->ptr = NULL;
+	return ptr;
+}
+
 ir_code s_strtocode(const char* val)
 {
 	ir_code code = 0;
@@ -355,7 +465,7 @@ int defineRemote(char* key, char* val, char* val2, struct ir_remote* rem)
 {
 	if ((strcasecmp("name", key)) == 0) {
 		if (rem->name != NULL)
-			free((void*)(rem->name));
+			s_free((void*)(rem->name));
 		rem->name = s_strdup(val);
 		logprintf(LIRC_INFO, "Using remote: %s.", val);
 		return 1;
@@ -363,13 +473,13 @@ int defineRemote(char* key, char* val, char* val2, struct ir_remote* rem)
 	if (options_getboolean("lircd:dynamic-codes")) {
 		if ((strcasecmp("dyncodes_name", key)) == 0) {
 			if (rem->dyncodes_name != NULL)
-				free(rem->dyncodes_name);
+				s_free(rem->dyncodes_name);
 			rem->dyncodes_name = s_strdup(val);
 			return 1;
 		}
 	} else if (strcasecmp("driver", key) == 0) {
 		if (rem->driver != NULL)
-			free((void*)(rem->driver));
+			s_free((void*)(rem->driver));
 		rem->driver = s_strdup(val);
 		return 1;
 	} else if ((strcasecmp("bits", key)) == 0) {
@@ -744,8 +854,17 @@ struct ir_remote* read_config(FILE* f, const char* name)
 {
 	struct ir_remote* head;
 
+	clear_sources();
+	arena = arena_new();
+	if (arena == NULL) {
+		logprintf(LIRC_ERROR, "out of memory");
+		return NULL;
+	}
 	head = read_config_recursive(f, name, 0);
 	head = sort_by_bit_count(head);
+	if (head == NULL || head == (void*)-1)
+		arena_free(arena);
+	arena = NULL;
 	return head;
 }
 
@@ -783,6 +902,7 @@ read_included(const char* name, int depth, char* val, struct ir_remote* top_rem)
 		logprintf(LIRC_ERROR, "error opening child file '%s' defined at line %d:",
 			  childName, line);
 		logprintf(LIRC_ERROR, "ignoring this child file for now.");
+		add_source(childName);
 		return NULL;
 	}
 	rem = read_config_recursive(childFile, childName, depth + 1);
@@ -810,11 +930,15 @@ static struct ir_remote* read_all_included(const char*		name,
 	int i;
 	glob_t globbuf;
 	char buff[256] = { '\0' };
+	char dir[256] = { '\0' };
 
 	memset(&globbuf, 0, sizeof(globbuf));
 	val = val + 1;   // Strip quotes
 	val[strlen(val) - 1] = '\0';
 	lirc_parse_relative(buff, sizeof(buff), val, name);
+	/* Files added or removed change the directory */
+	memcpy(dir, buff, sizeof(dir));
+	add_source(dirname(dir));
 	glob(buff, 0, NULL, &globbuf);
 	for (i = 0; i < globbuf.gl_pathc; i += 1) {
 		snprintf(buff, sizeof(buff), "\"%s\"", globbuf.gl_pathv[i]);
@@ -843,6 +967,7 @@ read_config_recursive(FILE* f, const char* name, int depth)
 	line = 0;
 	parse_error = 0;
 	LOGPRINTF(2, "parsing '%s'", name);
+	add_source(name);
 
 	while (fgets(buf, LINE_LEN, f) != NULL) {
 		line++;
@@ -922,10 +1047,16 @@ read_config_recursive(FILE* f, const char* name, int depth)
 						/* create first remote */
 						LOGPRINTF(2, "creating first remote");
 						rem = top_rem = s_malloc(sizeof(struct ir_remote));
+						if (rem == NULL)
+							break;
+						rem->arena = arena;
 					} else {
 						/* create new remote */
 						LOGPRINTF(2, "creating next remote");
 						rem = s_malloc(sizeof(struct ir_remote));
+						if (rem == NULL)
+							break;
+						rem->arena = arena;
 						ir_remotes_append(top_rem, rem);
 					}
 				} else if (mode == ID_codes) {
@@ -955,14 +1086,14 @@ read_config_recursive(FILE* f, const char* name, int depth)
 					LOGPRINTF(2, "    end codes");
 					if (!checkMode(mode, ID_codes, "end codes"))
 						break;
-					rem->codes = get_void_array(&codes_list);
+					rem->codes = finish_void_array(&codes_list);
 					mode = ID_remote;       /* switch back */
 				} else if (strcasecmp("raw_codes", val) == 0) {
 					/* end raw codes mode */
 					LOGPRINTF(2, "    end raw_codes");
 
 					if (mode == ID_raw_name) {
-						raw_code.signals = get_void_array(&signals);
+						raw_code.signals = finish_void_array(&signals);
 						raw_code.length = signals.nr_items;
 						if (raw_code.length % 2 == 0) {
 							logprintf(LIRC_ERROR, "error in configfile line %d:", line);
@@ -975,7 +1106,7 @@ read_config_recursive(FILE* f, const char* name, int depth)
 					}
 					if (!checkMode(mode, ID_raw_codes, "end raw_codes"))
 						break;
-					rem->codes = get_void_array(&raw_codes);
+					rem->codes = finish_void_array(&raw_codes);
 					mode = ID_remote;       /* switch back */
 				} else if (strcasecmp("remote", val) == 0) {
 					/* end remote mode */
@@ -1048,7 +1179,7 @@ read_config_recursive(FILE* f, const char* name, int depth)
 					if (strcasecmp("name", key) == 0) {
 						LOGPRINTF(3, "Button: \"%s\"", val);
 						if (mode == ID_raw_name) {
-							raw_code.signals = get_void_array(&signals);
+							raw_code.signals = finish_void_array(&signals);
 							raw_code.length = signals.nr_items;
 							if (raw_code.length % 2 == 0) {
 								logprintf(LIRC_ERROR, "error in configfile line %d:",
@@ -1107,15 +1238,15 @@ read_config_recursive(FILE* f, const char* name, int depth)
 		switch (mode) {
 		case ID_raw_name:
 			if (raw_code.name != NULL) {
-				free(raw_code.name);
+				s_free(raw_code.name);
 				if (get_void_array(&signals) != NULL)
 					free(get_void_array(&signals));
 			}
 		case ID_raw_codes:
-			rem->codes = get_void_array(&raw_codes);
+			rem->codes = finish_void_array(&raw_codes);
 			break;
 		case ID_codes:
-			rem->codes = get_void_array(&codes_list);
+			rem->codes = finish_void_array(&codes_list);
 			break;
 		}
 		if (!parse_error) {
@@ -1130,7 +1261,9 @@ read_config_recursive(FILE* f, const char* name, int depth)
 			logprintf(LIRC_ERROR, "reading of file '%s' failed", name);
 			print_error = 0;
 		}
-		free_config(top_rem);
+		/* The arena is freed by read_config(). */
+		for (rem = top_rem; rem != NULL; rem = rem->next)
+			free_code_index(rem);
 		if (depth == 0)
 			print_error = 1;
 		return (void*)-1;
@@ -1200,6 +1333,8 @@ read_config_recursive(FILE* f, const char* name, int depth)
 			}
 		}
 		calculate_signal_lengths(rem);
+		build_code_index(rem);
+		set_input_codes(rem);
 		rem = rem->next;
 	}
 
@@ -1288,13 +1423,47 @@ void calculate_signal_lengths(struct ir_remote* remote)
 	}
 	LOGPRINTF(1, "lengths: %lu %lu %lu %lu", remote->min_total_signal_length, remote->max_total_signal_length,
 		  remote->min_gap_length, remote->max_gap_length);
+	set_decode_hint(remote);
+	set_bit_kernel(remote);
 }
 
+static int lookup_input_code(const char* name)
+{
+	linux_input_code code;
+
+	return get_input_code(name, &code) == -1 ? -1 : code;
+}
+
+
+/**
+ * Look up the input code of all commands once, so forwarding them to
+ * uinput needs no name lookup.
+ */
+static void set_input_codes(struct ir_remote* remote)
+{
+	struct ir_ncode* codes;
+
+	for (codes = remote->codes; codes != NULL && codes->name != NULL; codes++)
+		codes->input_code = lookup_input_code(codes->name);
+	remote->dyncodes[0].input_code = lookup_input_code(remote->dyncodes_name);
+	remote->dyncodes[1].input_code = remote->dyncodes[0].input_code;
+}
+
+
 void free_config(struct ir_remote* remotes)
 {
 	struct ir_remote* next;
 	struct ir_ncode* codes;
-
+	struct ir_arena* a;
+
+	forget_decode_order(remotes);
+	if (remotes != NULL && remotes->arena != NULL) {
+		a = remotes->arena;
+		for (; remotes != NULL; remotes = remotes->next)
+			free_code_index(remotes);
+		arena_free(a);
+		return;
+	}
 	while (remotes != NULL) {
 		next = remotes->next;
 
@@ -1321,7 +1490,554 @@ void free_config(struct ir_remote* remotes)
 			}
 			free(remotes->codes);
 		}
+		free_code_index(remotes);
 		free(remotes);
 		remotes = next;
 	}
 }
+
+
+/*
+ * Compiled config cache, see read_config_cached(). The cache is an image
+ * of the parsed remotes together with the stat() data of all files read
+ * or looked for while parsing. All data is in host format, the header
+ * makes sure it's only used by the same lirc build.
+ */
+
+#define CACHE_MAGIC	"LIRCCCH"
+#define CACHE_VERSION	1
+#define CACHE_NONE	UINT64_MAX      /**< Length of a NULL string/array. */
+
+/** Cache file header. */
+struct cache_header {
+	char		magic[8];
+	uint32_t	version;
+	uint16_t	remote_size;    /**< sizeof(struct ir_remote) */
+	uint16_t	ncode_size;     /**< sizeof(struct ir_ncode) */
+	uint16_t	code_size;      /**< sizeof(ir_code) */
+	uint16_t	lirc_t_size;    /**< sizeof(lirc_t) */
+	uint32_t	n_sources;
+	uint32_t	n_remotes;
+	uint32_t	reserved;
+	uint64_t	size;           /**< Total file size. */
+	uint64_t	checksum;       /**< FNV-1a hash of data after header. */
+	char		lirc_version[32];
+};
+
+/** stat() data of a file read while parsing, followed by its path. */
+struct cache_source {
+	int64_t		mtime;          /**< -1 if file did not exist. */
+	int64_t		ctime;
+	int64_t		size;
+	uint64_t	ino;
+	uint64_t	path_len;       /**< Including trailing NUL. */
+};
+
+/** Output buffer used when writing the cache. */
+struct cache_writer {
+	char*	data;
+	size_t	len;
+	size_t	size;
+	int	error;
+};
+
+/** Input state when reading the cache. */
+struct cache_reader {
+	const char*	p;
+	const char*	end;
+	int		error;
+};
+
+/** Files read by last read_config(). */
+static struct cache_source* sources;
+static char** source_paths;
+static unsigned int sources_n;
+static unsigned int sources_size;
+/** A source could not be registered, the config must not be cached. */
+static int sources_lost;
+
+
+static void clear_sources(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < sources_n; i++)
+		free(source_paths[i]);
+	sources_n = 0;
+	sources_lost = 0;
+}
+
+
+static void stat_source(const char* path, struct cache_source* src)
+{
+	struct stat st;
+
+	memset(src, 0, sizeof(*src));
+	src->path_len = strlen(path) + 1;
+	if (stat(path, &st) != 0) {
+		src->mtime = -1;
+		return;
+	}
+	src->mtime = st.st_mtime;
+	src->ctime = st.st_ctime;
+	src->size = st.st_size;
+	src->ino = st.st_ino;
+}
+
+
+/** Register a file (or directory) which determines the parsed config. */
+static void add_source(const char* path)
+{
+	unsigned int size;
+	struct cache_source* new_sources;
+	char** new_paths;
+
+	if (sources_n == sources_size) {
+		size = sources_size > 0 ? 2 * sources_size : 16;
+		new_sources = malloc(size * sizeof(*sources));
+		new_paths = malloc(size * sizeof(*source_paths));
+		if (new_sources == NULL || new_paths == NULL) {
+			free(new_sources);
+			free(new_paths);
+			sources_lost = 1;
+			return;
+		}
+		if (sources_n > 0) {
+			memcpy(new_sources, sources, sources_n * sizeof(*sources));
+			memcpy(new_paths, source_paths,
+			       sources_n * sizeof(*source_paths));
+		}
+		free(sources);
+		free(source_paths);
+		sources = new_sources;
+		source_paths = new_paths;
+		sources_size = size;
+	}
+	source_paths[sources_n] = strdup(path);
+	if (source_paths[sources_n] == NULL) {
+		sources_lost = 1;
+		return;
+	}
+	stat_source(path, &sources[sources_n]);
+	sources_n++;
+}
+
+
+static uint64_t cache_hash(const char* data, size_t len)
+{
+	uint64_t h = 14695981039346656037ULL;
+
+	while (len-- > 0)
+		h = (h ^ (unsigned char)*data++) * 1099511628211ULL;
+	return h;
+}
+
+
+/** Append len bytes, padded to 8 bytes alignment. */
+static void put(struct cache_writer* w, const void* data, size_t len)
+{
+	size_t padded = (len + 7) & ~(size_t)7;
+	size_t size;
+	char* p;
+
+	if (w->error)
+		return;
+	if (w->len + padded > w->size) {
+		for (size = w->size > 0 ? w->size : 4096; size < w->len + padded; size *= 2)
+			;
+		p = realloc(w->data, size);
+		if (p == NULL) {
+			w->error = 1;
+			return;
+		}
+		w->data = p;
+		w->size = size;
+	}
+	memcpy(w->data + w->len, data, len);
+	memset(w->data + w->len + len, 0, padded - len);
+	w->len += padded;
+}
+
+
+static void put_len(struct cache_writer* w, uint64_t len)
+{
+	put(w, &len, sizeof(len));
+}
+
+
+static void put_string(struct cache_writer* w, const char* s)
+{
+	if (s == NULL) {
+		put_len(w, CACHE_NONE);
+		return;
+	}
+	put_len(w, strlen(s) + 1);
+	put(w, s, strlen(s) + 1);
+}
+
+
+static void put_remote(struct cache_writer* w, const struct ir_remote* rem)
+{
+	const struct ir_ncode* code;
+	const struct ir_code_node* node;
+	uint64_t n;
+
+	put(w, rem, sizeof(*rem));
+	put_string(w, rem->name);
+	put_string(w, rem->driver);
+	put_string(w, rem->dyncodes_name);
+	n = 0;
+	for (code = rem->codes; code != NULL && code->name != NULL; code++)
+		n++;
+	put_len(w, rem->codes != NULL ? n : CACHE_NONE);
+	for (code = rem->codes; code != NULL && code->name != NULL; code++) {
+		put(w, code, sizeof(*code));
+		put_string(w, code->name);
+		if (code->signals != NULL) {
+			put_len(w, code->length);
+			put(w, code->signals, code->length * sizeof(lirc_t));
+		} else {
+			put_len(w, CACHE_NONE);
+		}
+		n = 0;
+		for (node = code->next; node != NULL; node = node->next)
+			n++;
+		put_len(w, n);
+		for (node = code->next; node != NULL; node = node->next)
+			put(w, &node->code, sizeof(node->code));
+	}
+}
+
+
+/** Return next len bytes (8 bytes aligned) or NULL on errors. */
+static const void* get(struct cache_reader* r, size_t len)
+{
+	size_t padded = (len + 7) & ~(size_t)7;
+	const char* p = r->p;
+
+	if (r->error || len > (size_t)(r->end - r->p) || padded > (size_t)(r->end - r->p)) {
+		r->error = 1;
+		return NULL;
+	}
+	r->p += padded;
+	return p;
+}
+
+
+static uint64_t get_len(struct cache_reader* r)
+{
+	const uint64_t* p = get(r, sizeof(uint64_t));
+
+	return p != NULL ? *p : CACHE_NONE;
+}
+
+
+/** Return a malloc()'d string, NULL if the string or r is bad. */
+static char* get_string(struct cache_reader* r)
+{
+	uint64_t len = get_len(r);
+	const char* s;
+
+	if (len == CACHE_NONE || len == 0)
+		return NULL;
+	s = get(r, len);
+	if (s == NULL || s[len - 1] != '\0') {
+		r->error = 1;
+		return NULL;
+	}
+	return s_strdup((char*)s);
+}
+
+
+/** Rebuild a remote from its cache image. Returns NULL on errors. */
+static struct ir_remote* get_remote(struct cache_reader* r)
+{
+	const struct ir_remote* image;
+	const struct ir_ncode* code_image;
+	const lirc_t* signals;
+	const ir_code* node_code;
+	struct ir_remote* rem;
+	struct ir_ncode* code;
+	struct ir_code_node** tail;
+	uint64_t n, i, j, n_nodes;
+
+	image = get(r, sizeof(*image));
+	if (image == NULL)
+		return NULL;
+	rem = s_malloc(sizeof(*rem));
+	if (rem == NULL)
+		return NULL;
+	memcpy(rem, image, sizeof(*rem));
+	rem->arena = arena;
+	rem->codes = NULL;
+	rem->last_code = NULL;
+	rem->toggle_code = NULL;
+	rem->code_index = NULL;
+	rem->next = NULL;
+	rem->name = get_string(r);
+	rem->driver = get_string(r);
+	rem->dyncodes_name = get_string(r);
+	for (i = 0; i < 2; i++) {
+		memset(&rem->dyncodes[i], 0, sizeof(rem->dyncodes[i]));
+		rem->dyncodes[i].name = rem->dyncodes_name;
+		rem->dyncodes[i].code = image->dyncodes[i].code;
+	}
+	n = get_len(r);
+	if (n != CACHE_NONE && !r->error) {
+		if (n > (uint64_t)(r->end - r->p) / sizeof(*code_image)) {
+			r->error = 1;
+			return rem;
+		}
+		rem->codes = s_malloc((n + 1) * sizeof(struct ir_ncode));
+		if (rem->codes == NULL) {
+			r->error = 1;
+			return rem;
+		}
+	}
+	for (i = 0; rem->codes != NULL && i < n && !r->error; i++) {
+		code_image = get(r, sizeof(*code_image));
+		if (code_image == NULL)
+			break;
+		code = &rem->codes[i];
+		code->code = code_image->code;
+		code->length = code_image->length;
+		code->name = get_string(r);
+		if (code->name == NULL) {
+			r->error = 1;
+			break;
+		}
+		j = get_len(r);
+		if (j != CACHE_NONE) {
+			signals = get(r, j * sizeof(lirc_t));
+			if (signals == NULL || j != (uint64_t)code->length)
+				break;
+			code->signals = s_malloc(j * sizeof(lirc_t));
+			if (code->signals == NULL) {
+				r->error = 1;
+				break;
+			}
+			memcpy(code->signals, signals, j * sizeof(lirc_t));
+		}
+		n_nodes = get_len(r);
+		tail = &code->next;
+		for (j = 0; j < n_nodes && !r->error; j++) {
+			node_code = get(r, sizeof(*node_code));
+			if (node_code == NULL)
+				break;
+			*tail = s_malloc(sizeof(struct ir_code_node));
+			if (*tail == NULL) {
+				r->error = 1;
+				break;
+			}
+			(*tail)->code = *node_code;
+			(*tail)->next = NULL;
+			tail = &(*tail)->next;
+		}
+	}
+	if (rem->name == NULL)
+		r->error = 1;
+	return rem;
+}
+
+
+/** Check that all files are unchanged since the cache was written. */
+static int sources_unchanged(struct cache_reader* r, uint32_t n, const char* name)
+{
+	const struct cache_source* src;
+	struct cache_source now;
+	const char* path;
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		src = get(r, sizeof(*src));
+		if (src == NULL || src->path_len == 0)
+			return 0;
+		path = get(r, src->path_len);
+		if (path == NULL || path[src->path_len - 1] != '\0')
+			return 0;
+		if (i == 0 && strcmp(path, name) != 0) {
+			LOGPRINTF(1, "config cache is for %s", path);
+			return 0;
+		}
+		stat_source(path, &now);
+		if (now.mtime != src->mtime || now.ctime != src->ctime
+		    || now.size != src->size || now.ino != src->ino) {
+			LOGPRINTF(1, "config cache: %s has changed", path);
+			return 0;
+		}
+	}
+	return n > 0;
+}
+
+
+/** Load remotes from cache if valid and up to date, else return NULL. */
+static struct ir_remote* load_cache(const char* cache, const char* name)
+{
+	struct cache_header hdr;
+	struct cache_reader r;
+	struct ir_remote* top_rem = NULL;
+	struct ir_remote* last = NULL;
+	struct ir_remote* rem;
+	struct stat st;
+	void* map;
+	uint32_t i;
+	int fd;
+
+	fd = open(cache, O_RDONLY);
+	if (fd == -1) {
+		LOGPRINTF(1, "no config cache %s", cache);
+		return NULL;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(hdr)) {
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+	memcpy(&hdr, map, sizeof(hdr));
+	if (memcmp(hdr.magic, CACHE_MAGIC, sizeof(hdr.magic)) != 0
+	    || hdr.version != CACHE_VERSION
+	    || hdr.remote_size != sizeof(struct ir_remote)
+	    || hdr.ncode_size != sizeof(struct ir_ncode)
+	    || hdr.code_size != sizeof(ir_code)
+	    || hdr.lirc_t_size != sizeof(lirc_t)
+	    || strncmp(hdr.lirc_version, VERSION, sizeof(hdr.lirc_version)) != 0
+	    || hdr.size != (uint64_t)st.st_size
+	    || hdr.checksum != cache_hash((char*)map + sizeof(hdr), st.st_size - sizeof(hdr))) {
+		logprintf(LIRC_NOTICE, "ignoring invalid config cache %s", cache);
+		munmap(map, st.st_size);
+		return NULL;
+	}
+	r.p = (const char*)map + sizeof(hdr);
+	r.end = (const char*)map + st.st_size;
+	r.error = 0;
+	if (!sources_unchanged(&r, hdr.n_sources, name)) {
+		munmap(map, st.st_size);
+		return NULL;
+	}
+	arena = arena_new();
+	if (arena == NULL) {
+		munmap(map, st.st_size);
+		return NULL;
+	}
+	for (i = 0; i < hdr.n_remotes && !r.error; i++) {
+		rem = get_remote(&r);
+		if (rem == NULL)
+			break;
+		if (last == NULL)
+			top_rem = rem;
+		else
+			last->next = rem;
+		last = rem;
+	}
+	munmap(map, st.st_size);
+	if (i < hdr.n_remotes || r.error || r.p != r.end) {
+		logprintf(LIRC_NOTICE, "ignoring invalid config cache %s", cache);
+		arena_free(arena);
+		arena = NULL;
+		return NULL;
+	}
+	arena = NULL;
+	for (rem = top_rem; rem != NULL; rem = rem->next) {
+		build_code_index(rem);
+		set_input_codes(rem);
+	}
+	return top_rem;
+}
+
+
+/** Write remotes and current sources to cache, return 0 on errors. */
+static int save_cache(const char* cache, const struct ir_remote* remotes)
+{
+	struct cache_writer w;
+	struct cache_header hdr;
+	const struct ir_remote* rem;
+	char tmp[PATH_MAX];
+	time_t now;
+	unsigned int i;
+	int fd;
+	int ok;
+
+	if (sources_lost) {
+		LOGPRINTF(1, "not caching, out of memory tracking sources");
+		return 1;
+	}
+	now = time(NULL);
+	for (i = 0; i < sources_n; i++) {
+		/* A change within the same second might go unnoticed. */
+		if (sources[i].mtime >= now - 1) {
+			LOGPRINTF(1, "not caching recently modified %s", source_paths[i]);
+			return 1;
+		}
+	}
+	memset(&w, 0, sizeof(w));
+	memset(&hdr, 0, sizeof(hdr));
+	put(&w, &hdr, sizeof(hdr));
+	for (i = 0; i < sources_n; i++) {
+		put(&w, &sources[i], sizeof(sources[i]));
+		put(&w, source_paths[i], sources[i].path_len);
+	}
+	for (rem = remotes; rem != NULL; rem = rem->next) {
+		put_remote(&w, rem);
+		hdr.n_remotes++;
+	}
+	if (w.error) {
+		free(w.data);
+		return 0;
+	}
+	memcpy(hdr.magic, CACHE_MAGIC, sizeof(hdr.magic));
+	hdr.version = CACHE_VERSION;
+	hdr.remote_size = sizeof(struct ir_remote);
+	hdr.ncode_size = sizeof(struct ir_ncode);
+	hdr.code_size = sizeof(ir_code);
+	hdr.lirc_t_size = sizeof(lirc_t);
+	strncpy(hdr.lirc_version, VERSION, sizeof(hdr.lirc_version) - 1);
+	hdr.n_sources = sources_n;
+	hdr.size = w.len;
+	hdr.checksum = cache_hash(w.data + sizeof(hdr), w.len - sizeof(hdr));
+	memcpy(w.data, &hdr, sizeof(hdr));
+
+	/* Write a new file and rename, readers never see partial data. */
+	if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", cache) >= (int)sizeof(tmp)) {
+		free(w.data);
+		return 0;
+	}
+	fd = mkstemp(tmp);
+	if (fd == -1) {
+		free(w.data);
+		return 0;
+	}
+	ok = write(fd, w.data, w.len) == (ssize_t)w.len;
+	ok = fchmod(fd, 0644) == 0 && ok;
+	ok = close(fd) == 0 && ok;
+	if (ok)
+		ok = rename(tmp, cache) == 0;
+	if (!ok)
+		unlink(tmp);
+	free(w.data);
+	return ok;
+}
+
+
+struct ir_remote* read_config_cached(FILE* f, const char* name, const char* cache)
+{
+	struct ir_remote* remotes;
+
+	if (cache == NULL || *cache == '\0')
+		return read_config(f, name);
+	remotes = load_cache(cache, name);
+	if (remotes != NULL) {
+		logprintf(LIRC_INFO, "using config cache %s", cache);
+		return remotes;
+	}
+	remotes = read_config(f, name);
+	if (remotes != NULL && remotes != (void*)-1) {
+		if (!save_cache(cache, remotes)) {
+			logprintf(LIRC_WARNING, "cannot write config cache %s", cache);
+			logperror(LIRC_WARNING, NULL);
+		}
+	}
+	return remotes;
+}
@@ -37,6 +37,19 @@ extern "C" {
  */
 struct ir_remote* read_config(FILE* f, const char* name);
 
+/**
+ * Like read_config(), but use a compiled cache if possible. The cache is
+ * used if it was created from the same config file and neither this nor
+ * any included file has changed since; else the text file is parsed and
+ * a new cache is written.
+ *
+ * @param f Open FILE* connection to file, not used if the cache is valid.
+ * @param name Path for the open file f.
+ * @param cache Path to cache file. If NULL or empty, no cache is used.
+ * @return As read_config().
+ */
+struct ir_remote* read_config_cached(FILE* f, const char* name, const char* cache);
+
 /** Free() an ir_remote instance obtained using read_config(). */
 void free_config(struct ir_remote* remotes);
 
@@ -187,6 +187,20 @@ struct driver {
 	const char*	info;                   /**< Free text driver info. */
 
 	int (*const close_func)(void);          /**< Hard closing, returns 0 on OK.*/
+
+/* API version 3 addons: */
+
+	/**
+	 * Optional: get several pulse/space lengths at once, reducing the
+	 * number of system calls compared to readdata(). Used instead of
+	 * readdata() by the receive code if api_version >= 3 and set.
+	 * @param buf Buffer to store items in, each as returned by readdata().
+	 * @param n Max number of items to store, at least 1.
+	 * @param timeout Max time to wait for the first item (us). Further
+	 *     items are only stored if they are available without waiting.
+	 * @return Number of items stored in buf, 0 on timeout or errors.
+	 */
+	int (*const readdata_batch)(lirc_t* buf, size_t n, lirc_t timeout);
 };
 
 /** @} */
@@ -19,6 +19,7 @@
 
 #include "lirc/input_map.h"
 
+/** Sorted on the lower case name by input_map.sh. */
 struct {
 	char*			name;
 	linux_input_code	code;
@@ -31,13 +32,23 @@ struct {
 
 int get_input_code(const char* name, linux_input_code* code)
 {
-	int i;
+	int low = 0;
+	int high = sizeof(input_map) / sizeof(input_map[0]) - 2;
+
+	if (name == NULL)
+		return -1;
+	while (low <= high) {
+		int i = (low + high) / 2;
+		int cmp = strcasecmp(name, input_map[i].name);
 
-	for (i = 0; input_map[i].name != NULL; i++) {
-		if (strcasecmp(name, input_map[i].name) == 0) {
+		if (cmp == 0) {
 			*code = input_map[i].code;
 			return i;
 		}
+		if (cmp < 0)
+			high = i - 1;
+		else
+			low = i + 1;
 	}
 	return -1;
 }
@@ -1,7 +1,19 @@
 #!/bin/sh
+#
+# Generate the input_map[] table for input_map.c. The entries are sorted
+# on the lower case name, get_input_code() relies on this to do a binary
+# search with strcasecmp().
 
 TYPES="KEY BTN"
-file=${1:-/usr/include/linux/input.h}
+if test -n "$1"; then
+	files="$1"
+else
+	files=/usr/include/linux/input.h
+	# Newer kernels keep the codes in a separate header.
+	if test -f /usr/include/linux/input-event-codes.h; then
+		files="$files /usr/include/linux/input-event-codes.h"
+	fi
+fi
 
 # Use gnu-sed on Macosx
 if test "`uname`" = 'Darwin'; then
@@ -11,6 +23,6 @@ else
 fi
 
 for type in $TYPES; do
-	grep "^#define ${type}_" < $file|sort|$SED -n --expression="s/^#define \([^ \t]*\)[ \t][ \t]*\([0-9][0-9a-fA-FxX]*\).*/{\"\1\", \2},/p"
-done
-
+	cat $files | grep "^#define ${type}_" | $SED -n --expression="s/^#define \([^ \t]*\)[ \t][ \t]*\([0-9][0-9a-fA-FxX]*\).*/\1 \2/p"
+done | awk '{ print tolower($1), $1, $2 }' | LC_ALL=C sort -u -k1,1 | \
+	awk '{ printf("{\"%s\", %s},\n", $2, $3) }'
@@ -31,7 +31,9 @@
 
 #include "include/media/lirc.h"
 #include "lirc/ir_remote.h"
+#include "ir_remote_private.h"
 #include "lirc/driver.h"
+#include "lirc/receive.h"
 #include "lirc/release.h"
 #include "lirc/lirc_log.h"
 
@@ -460,12 +462,433 @@ void find_longest_match(struct ir_remote*	remote,
 }
 
 
-static struct ir_ncode* get_code(struct ir_remote*	remote,
-				 ir_code		pre,
-				 ir_code		code,
-				 ir_code		post,
-				 int*			repeat_flag,
-				 ir_code*		toggle_bit_mask_statep)
+/** Set w to the durations expect(remote, duration, val) accepts. */
+static void set_window(struct ir_window* w, const struct ir_remote* remote, lirc_t val)
+{
+	int aeps = curr_driver->resolution > remote->aeps ?
+		   curr_driver->resolution : remote->aeps;
+	lirc_t tolerance = val * remote->eps / 100;
+
+	if (tolerance < aeps)
+		tolerance = aeps;
+	w->min = val - tolerance;
+	w->max = val + tolerance;
+}
+
+
+/**
+ * Open addressing hash table of the codes in a remote which are not
+ * sequences, keyed on the full code with ignore_mask bits set.
+ * Sequences are matched against their current position, and are
+ * kept in a separate list scanned in config file order.
+ */
+struct ir_code_index {
+	/* Remote data the index is built from, see code_index_valid(). */
+	struct ir_ncode*	codes;
+	int			count;
+	int			flags;
+	int			bits;
+	int			pre_data_bits;
+	int			post_data_bits;
+	ir_code			pre_data;
+	ir_code			post_data;
+	ir_code			ignore_mask;
+
+	unsigned int		mask;           /**< Table size - 1 */
+	struct {
+		ir_code			key;
+		struct ir_ncode*	ncode;  /**< NULL: empty slot */
+	}*			slots;
+	struct ir_ncode**	sequences;      /**< NULL-terminated */
+
+	/* Trie of raw codes, see build_raw_index(). */
+	struct ir_raw_node*	raw_nodes;      /**< Root first, NULL: no trie. */
+	int			raw_size;       /**< Allocated nodes. */
+	int			raw_count;      /**< Used nodes. */
+	int			raw_eps;        /**< Tolerances the windows are built for. */
+	unsigned int		raw_aeps;
+	unsigned int		raw_resolution;
+};
+
+
+static ir_code code_index_key(const struct ir_remote* remote, ir_code code)
+{
+	return gen_ir_code(remote, remote->pre_data, code, remote->post_data)
+	       | remote->ignore_mask;
+}
+
+
+static unsigned int code_index_hash(ir_code key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	return (unsigned int)key;
+}
+
+
+void free_code_index(struct ir_remote* remote)
+{
+	if (remote->code_index == NULL)
+		return;
+	free(remote->code_index->slots);
+	free(remote->code_index->sequences);
+	free(remote->code_index->raw_nodes);
+	free(remote->code_index);
+	remote->code_index = NULL;
+}
+
+
+/** Position in the raw codes compare_raw() sorts on. */
+static int raw_sort_depth;
+
+static int compare_raw(const void* a, const void* b)
+{
+	const struct ir_ncode* c1 = *(struct ir_ncode* const*)a;
+	const struct ir_ncode* c2 = *(struct ir_ncode* const*)b;
+	lirc_t v1 = c1->signals[raw_sort_depth];
+	lirc_t v2 = c2->signals[raw_sort_depth];
+
+	return v1 < v2 ? -1 : v1 > v2 ? 1 : 0;
+}
+
+
+/** Append count nodes to the trie, return index of first or -1. */
+static int add_raw_nodes(struct ir_code_index* index, int count)
+{
+	struct ir_raw_node* nodes;
+	int size;
+
+	if (index->raw_count + count > index->raw_size) {
+		size = 2 * index->raw_size + count;
+		nodes = realloc(index->raw_nodes, size * sizeof(*nodes));
+		if (nodes == NULL)
+			return -1;
+		index->raw_nodes = nodes;
+		index->raw_size = size;
+	}
+	memset(index->raw_nodes + index->raw_count, 0, count * sizeof(*nodes));
+	index->raw_count += count;
+	return index->raw_count - count;
+}
+
+
+/**
+ * Build the subtree of node for the codes in members[0..n - 1], all
+ * matching the node's path up to depth. Codes ending at depth are
+ * stored in the node, the others are sorted on their signal at depth
+ * and split in runs with overlapping windows, one child per run.
+ * @return 0 on errors.
+ */
+static int build_raw_node(const struct ir_remote*	remote,
+			  struct ir_code_index*		index,
+			  int				node,
+			  struct ir_ncode**		members,
+			  int				n,
+			  int				depth)
+{
+	struct ir_ncode* tmp;
+	struct ir_window w;
+	struct ir_raw_node* child;
+	int ended, runs, first, i, j;
+
+	for (i = ended = 0; i < n; i++) {
+		if (members[i]->length > depth)
+			continue;
+		if (index->raw_nodes[node].code == NULL || members[i] < index->raw_nodes[node].code)
+			index->raw_nodes[node].code = members[i];
+		tmp = members[ended];
+		members[ended++] = members[i];
+		members[i] = tmp;
+	}
+	members += ended;
+	n -= ended;
+	if (n == 0)
+		return 1;
+
+	raw_sort_depth = depth;
+	qsort(members, n, sizeof(*members), compare_raw);
+	for (i = 0, runs = 0; i < n; runs++) {
+		set_window(&w, remote, members[i]->signals[depth]);
+		for (i++; i < n; i++) {
+			struct ir_window next;
+
+			set_window(&next, remote, members[i]->signals[depth]);
+			if (next.min > w.max)
+				break;
+			w.min = next.min;
+		}
+	}
+	first = add_raw_nodes(index, runs);
+	if (first < 0)
+		return 0;
+	index->raw_nodes[node].child = first;
+	index->raw_nodes[node].n_children = runs;
+
+	for (i = 0, runs = 0; i < n; runs++) {
+		/* Intersection of the windows in the run and their union. */
+		child = index->raw_nodes + first + runs;
+		set_window(&w, remote, members[i]->signals[depth]);
+		child->min = child->outer_min = w.min;
+		child->max = child->outer_max = w.max;
+		for (j = i + 1; j < n; j++) {
+			set_window(&w, remote, members[j]->signals[depth]);
+			if (w.min > child->max)
+				break;
+			child->min = w.min;
+			if (w.max < child->max)
+				child->max = w.max;
+			if (w.max > child->outer_max)
+				child->outer_max = w.max;
+		}
+		child->timeout = members[j - 1]->signals[depth];
+		if (!build_raw_node(remote, index, first + runs, members + i, j - i, depth + 1))
+			return 0;
+		/* The nodes may have moved. */
+		child = index->raw_nodes + first + runs;
+		if (child->code != NULL
+		    && (child->first == NULL || child->code < child->first))
+			child->first = child->code;
+		if (child->first != NULL
+		    && (index->raw_nodes[node].first == NULL
+			|| child->first < index->raw_nodes[node].first))
+			index->raw_nodes[node].first = child->first;
+		i = j;
+	}
+	return 1;
+}
+
+
+/** Build the trie of raw codes returned by get_raw_index(). */
+static void build_raw_index(struct ir_remote* remote, struct ir_code_index* index)
+{
+	struct ir_ncode** members;
+	int i;
+
+	free(index->raw_nodes);
+	index->raw_nodes = NULL;
+	index->raw_size = index->raw_count = 0;
+	for (i = 0; i < index->count; i++)
+		if (remote->codes[i].length <= 0 || remote->codes[i].signals == NULL)
+			return;
+	members = malloc((index->count + 1) * sizeof(*members));
+	if (members == NULL || add_raw_nodes(index, 1) < 0) {
+		free(members);
+		return;
+	}
+	for (i = 0; i < index->count; i++)
+		members[i] = remote->codes + i;
+	index->raw_eps = remote->eps;
+	index->raw_aeps = remote->aeps;
+	index->raw_resolution = curr_driver->resolution;
+	if (!build_raw_node(remote, index, 0, members, index->count, 0)) {
+		logprintf(LIRC_WARNING, "out of memory, no raw code index for %s", remote->name);
+		free(index->raw_nodes);
+		index->raw_nodes = NULL;
+	}
+	free(members);
+}
+
+
+void build_code_index(struct ir_remote* remote)
+{
+	struct ir_code_index* index;
+	struct ir_ncode* codes;
+	unsigned int size;
+	unsigned int i;
+	int count;
+	int sequences;
+
+	free_code_index(remote);
+	if (remote->codes == NULL)
+		return;
+	count = sequences = 0;
+	for (codes = remote->codes; codes->name != NULL; codes++) {
+		count++;
+		if (codes->next != NULL)
+			sequences++;
+	}
+	for (size = 16; size < 2 * count; size *= 2)
+		;
+	index = calloc(1, sizeof(*index));
+	if (index != NULL) {
+		index->slots = calloc(size, sizeof(*index->slots));
+		index->sequences = calloc(sequences + 1, sizeof(*index->sequences));
+	}
+	if (index == NULL || index->slots == NULL || index->sequences == NULL) {
+		logprintf(LIRC_WARNING, "out of memory, no code index for %s", remote->name);
+		if (index != NULL) {
+			free(index->slots);
+			free(index->sequences);
+			free(index);
+		}
+		return;
+	}
+	index->codes = remote->codes;
+	index->count = count;
+	index->flags = remote->flags;
+	index->bits = remote->bits;
+	index->pre_data_bits = remote->pre_data_bits;
+	index->post_data_bits = remote->post_data_bits;
+	index->pre_data = remote->pre_data;
+	index->post_data = remote->post_data;
+	index->ignore_mask = remote->ignore_mask;
+	index->mask = size - 1;
+
+	sequences = 0;
+	for (codes = remote->codes; codes->name != NULL; codes++) {
+		ir_code key;
+
+		if (codes->next != NULL) {
+			index->sequences[sequences++] = codes;
+			continue;
+		}
+		/* keep the first of duplicate codes, like a linear scan */
+		key = code_index_key(remote, codes->code);
+		for (i = code_index_hash(key) & index->mask;
+		     index->slots[i].ncode != NULL;
+		     i = (i + 1) & index->mask)
+			if (index->slots[i].key == key)
+				break;
+		if (index->slots[i].ncode == NULL) {
+			index->slots[i].key = key;
+			index->slots[i].ncode = codes;
+		}
+	}
+	if (is_raw(remote))
+		build_raw_index(remote, index);
+	remote->code_index = index;
+}
+
+
+/** Return true if remote is unchanged since its index was built. */
+static int code_index_valid(const struct ir_remote* remote)
+{
+	const struct ir_code_index* index = remote->code_index;
+
+	return index != NULL
+	       && index->codes == remote->codes
+	       && remote->codes[index->count].name == NULL
+	       && (index->count == 0 || remote->codes[index->count - 1].name != NULL)
+	       && index->flags == remote->flags
+	       && index->bits == remote->bits
+	       && index->pre_data_bits == remote->pre_data_bits
+	       && index->post_data_bits == remote->post_data_bits
+	       && index->pre_data == remote->pre_data
+	       && index->post_data == remote->post_data
+	       && index->ignore_mask == remote->ignore_mask;
+}
+
+
+const struct ir_raw_node* get_raw_index(struct ir_remote* remote)
+{
+	struct ir_code_index* index = remote->code_index;
+
+	if (!is_raw(remote) || !code_index_valid(remote))
+		return NULL;
+	if (index->raw_nodes != NULL
+	    && (index->raw_eps != remote->eps
+		|| index->raw_aeps != remote->aeps
+		|| index->raw_resolution != curr_driver->resolution))
+		build_raw_index(remote, index);
+	return index->raw_nodes;
+}
+
+
+static struct ir_ncode* code_index_lookup(const struct ir_code_index* index, ir_code key)
+{
+	unsigned int i;
+
+	for (i = code_index_hash(key) & index->mask;
+	     index->slots[i].ncode != NULL;
+	     i = (i + 1) & index->mask)
+		if (index->slots[i].key == key)
+			return index->slots[i].ncode;
+	return NULL;
+}
+
+
+/**
+ * Return the first code which is not a sequence matching all as
+ * match_ir_code() does, also trying all ^ repeat_mask for repeats.
+ */
+static struct ir_ncode* code_index_find(struct ir_remote* remote, ir_code all, int repeat_flag)
+{
+	const struct ir_code_index* index = remote->code_index;
+	ir_code keys[4];
+	struct ir_ncode* found = NULL;
+	struct ir_ncode* ncode;
+	int n = 0;
+	int i;
+
+	keys[n++] = all;
+	keys[n++] = all ^ remote->toggle_bit_mask;
+	if (repeat_flag && has_repeat_mask(remote)) {
+		keys[n++] = all ^ remote->repeat_mask;
+		keys[n++] = all ^ remote->repeat_mask ^ remote->toggle_bit_mask;
+	}
+	for (i = 0; i < n; i++) {
+		ncode = code_index_lookup(index, keys[i] | remote->ignore_mask);
+		if (ncode != NULL && (found == NULL || ncode < found))
+			found = ncode;
+	}
+	return found;
+}
+
+
+/** Match one code in get_code(), updating the sequence state. */
+static void match_ncode(struct ir_remote*	remote,
+			struct ir_ncode*	codes,
+			ir_code			all,
+			int			repeat_flag,
+			struct ir_ncode**	found,
+			int*			found_code,
+			int*			have_code)
+{
+	ir_code next_all;
+
+	next_all = gen_ir_code(remote,
+			       remote->pre_data,
+			       get_ir_code(codes,
+					   codes->current),
+			       remote->post_data);
+	if (match_ir_code(remote, next_all, all) ||
+	    (repeat_flag &&
+	     has_repeat_mask(remote) &&
+	     match_ir_code(remote,
+			   next_all,
+			   all ^ remote->repeat_mask))) {
+		*found_code = 1;
+		if (codes->next != NULL) {
+			if (codes->current == NULL)
+				codes->current = codes->next;
+			else
+				codes->current =
+					codes->current->next;
+		}
+		if (!*have_code) {
+			*found = codes;
+			if (codes->current == NULL)
+				*have_code = 1;
+		}
+	} else {
+		find_longest_match(remote,
+				   codes,
+				   all,
+				   &next_all,
+				   *have_code,
+				   found,
+				   found_code);
+	}
+}
+
+
+struct ir_ncode* get_code(struct ir_remote*	remote,
+			  ir_code		pre,
+			  ir_code		code,
+			  ir_code		post,
+			  int*			repeat_flag,
+			  ir_code*		toggle_bit_mask_statep)
 {
 	ir_code pre_mask, code_mask, post_mask, toggle_bit_mask_state, all;
 	int found_code, have_code;
@@ -538,43 +961,36 @@ static struct ir_ncode* get_code(struct ir_remote*	remote,
 	found_code = 0;
 	have_code = 0;
 	codes = remote->codes;
-	if (codes != NULL) {
-		while (codes->name != NULL) {
-			ir_code next_all;
-
-			next_all = gen_ir_code(remote,
-					       remote->pre_data,
-					       get_ir_code(codes,
-							   codes->current),
-					       remote->post_data);
-			if (match_ir_code(remote, next_all, all) ||
-			    (*repeat_flag &&
-			     has_repeat_mask(remote) &&
-			     match_ir_code(remote,
-					   next_all,
-					   all ^ remote->repeat_mask))) {
+	if (codes != NULL && code_index_valid(remote)) {
+		struct ir_ncode** seq;
+		struct ir_ncode* plain;
+
+		/*
+		 * Same result as the scan below: the plain code match is
+		 * merged with the sequences in config file order.
+		 */
+		plain = code_index_find(remote, all, *repeat_flag);
+		for (seq = remote->code_index->sequences; *seq != NULL; seq++) {
+			if (plain != NULL && *seq > plain) {
 				found_code = 1;
-				if (codes->next != NULL) {
-					if (codes->current == NULL)
-						codes->current = codes->next;
-					else
-						codes->current =
-							codes->current->next;
-				}
 				if (!have_code) {
-					found = codes;
-					if (codes->current == NULL)
-						have_code = 1;
+					found = plain;
+					have_code = 1;
 				}
-			} else {
-				find_longest_match(remote,
-						   codes,
-						   all,
-						   &next_all,
-						   have_code,
-						   &found,
-						   &found_code);
+				plain = NULL;
 			}
+			match_ncode(remote, *seq, all, *repeat_flag,
+				    &found, &found_code, &have_code);
+		}
+		if (plain != NULL) {
+			found_code = 1;
+			if (!have_code)
+				found = plain;
+		}
+	} else if (codes != NULL) {
+		while (codes->name != NULL) {
+			match_ncode(remote, codes, all, *repeat_flag,
+				    &found, &found_code, &have_code);
 			codes++;
 		}
 	}
@@ -721,6 +1137,355 @@ int write_message(char*		buffer,
 }
 
 
+void set_decode_hint(struct ir_remote* remote)
+{
+	remote->decode_hint = 0;
+	/* get_header() must match the pulse, else receive_decode() fails. */
+	if (!has_header(remote) || remote->flags & NO_HEAD_REP
+	    || is_rcmm(remote) || is_bo(remote))
+		return;
+	remote->decode_hint |= DECODE_HINT_HEAD_PULSE;
+
+	/*
+	 * The header space is left pending. It is checked by the next
+	 * expectpulse() or, for expectspace(), merged with the first
+	 * space of the data which then must be at least as long.
+	 */
+	if (is_raw(remote))
+		return;
+	if (remote->plead > 0) {
+		remote->decode_hint |= DECODE_HINT_HEAD_SPACE;
+		return;
+	}
+	if (bit_count(remote) == 0)
+		return;
+	if (is_biphase(remote)) {
+		if (remote->sone > 0)
+			remote->decode_hint |= DECODE_HINT_HEAD_SPACE;
+	} else if (is_space_first(remote)) {
+		if ((remote->sone > 0 || remote->pone > 0)
+		    && (remote->szero > 0 || remote->pzero > 0))
+			remote->decode_hint |= DECODE_HINT_HEAD_SPACE;
+	} else if (is_space_enc(remote)) {
+		if (remote->pone > 0)
+			remote->decode_hint |= DECODE_HINT_HEAD_SPACE;
+	}
+}
+
+
+void set_bit_kernel(struct ir_remote* remote)
+{
+	struct ir_bit_kernel* k = &remote->bit_kernel;
+
+	memset(k, 0, sizeof(*k));
+	k->flags = remote->flags;
+	k->eps = remote->eps;
+	k->aeps = remote->aeps;
+	k->resolution = curr_driver->resolution;
+	memcpy(k->timing, &remote->pthree, sizeof(k->timing));
+
+	if (is_rcmm(remote)) {
+		k->type = BIT_KERNEL_RCMM;
+		set_window(&k->sum[0], remote, remote->pzero + remote->szero);
+		set_window(&k->sum[1], remote, remote->pone + remote->sone);
+		set_window(&k->sum[2], remote, remote->ptwo + remote->stwo);
+		set_window(&k->sum[3], remote, remote->pthree + remote->sthree);
+		return;
+	}
+	/* The remaining encodings with special cases in get_data(). */
+	if (is_grundig(remote) || is_serial(remote) || is_bo(remote)
+	    || is_xmp(remote) || is_goldstar(remote) || is_biphase(remote)
+	    || is_space_first(remote))
+		return;
+	/* Else expectone() leaves the space pending. */
+	if (remote->ptrail == 0)
+		return;
+	if (remote->pone <= 0 || remote->sone <= 0
+	    || remote->pzero <= 0 || remote->szero <= 0)
+		return;
+	k->type = BIT_KERNEL_PULSE_SPACE;
+	set_window(&k->pone, remote, remote->pone);
+	set_window(&k->sone, remote, remote->sone);
+	set_window(&k->pzero, remote, remote->pzero);
+	set_window(&k->szero, remote, remote->szero);
+}
+
+
+int bit_kernel_is_current(const struct ir_remote* remote)
+{
+	const struct ir_bit_kernel* k = &remote->bit_kernel;
+
+	return k->flags == remote->flags
+	       && k->eps == remote->eps
+	       && k->aeps == remote->aeps
+	       && k->resolution == curr_driver->resolution
+	       && memcmp(k->timing, &remote->pthree, sizeof(k->timing)) == 0;
+}
+
+
+/**
+ * Peek at the sync space and header of the received signal.
+ * @return Number of valid items in data (2 or 3), or 0 if the
+ *     decode hints cannot be used for this signal.
+ */
+static int peek_header(const struct ir_remote* remotes, lirc_t* data)
+{
+	const struct ir_remote* remote;
+	lirc_t maxusec = 0;
+	int n;
+
+	if (curr_driver->rec_mode != LIRC_MODE_MODE2
+	    && curr_driver->rec_mode != LIRC_MODE_PULSE
+	    && curr_driver->rec_mode != LIRC_MODE_RAW)
+		return 0;
+	for (remote = remotes; remote != NULL; remote = remote->next) {
+		if (remote->decode_hint == 0)
+			continue;
+		if (remote->phead > maxusec)
+			maxusec = remote->phead;
+		if (remote->shead > maxusec)
+			maxusec = remote->shead;
+	}
+	if (maxusec == 0)
+		return 0;
+	n = rec_buffer_peek(data, 3, maxusec);
+	if (n < 2 || !is_space(data[0]) || !is_pulse(data[1]))
+		return 0;
+	/* else sync_rec_buffer() skips data, and the header moves. */
+	if (last_remote != NULL
+	    && !expect_at_least(last_remote, data[0], last_remote->min_remaining_gap))
+		return 0;
+	if (n == 3 && !is_space(data[2]))
+		n = 2;
+	return n;
+}
+
+
+/**
+ * Check the header in data against remote's decode hints.
+ * @return 0 if remote is a candidate, else the number of items
+ *     receive_decode() consumes before failing on this header.
+ */
+static int match_decode_hint(const struct ir_remote* remote, const lirc_t* data, int n)
+{
+	lirc_t pulse = data[1] & PULSE_MASK;
+
+	if (has_repeat(remote) && last_remote == remote)
+		return 0;
+	if (remote->decode_hint & DECODE_HINT_HEAD_PULSE) {
+		if (pulse < lower_limit(remote, remote->phead)
+		    || pulse > upper_limit(remote, remote->phead))
+			return 1;
+	}
+	if (n > 2 && remote->decode_hint & DECODE_HINT_HEAD_SPACE) {
+		if (data[2] < lower_limit(remote, remote->shead))
+			return remote->plead > 0 ? 3 : 2;
+	}
+	return 0;
+}
+
+
+/** Update remote state like a failed receive_decode() would do. */
+static void skip_remote(struct ir_remote* remote, lirc_t sync, int consumed)
+{
+	if (has_toggle_mask(remote) && last_remote != NULL
+	    && !expect_at_most(last_remote, sync, last_remote->max_remaining_gap))
+		remote->toggle_code = NULL;
+	remote->toggle_mask_state = 0;
+	rec_buffer_skip(consumed);
+}
+
+
+/** Hits between updates of the adaptive order. */
+#define REORDER_INTERVAL 16
+
+/** Adaptive order of the remotes in decode_all(). */
+static struct {
+	int			enabled;
+	const struct ir_remote*	remotes;        /**< List the order is built for. */
+	int			count;
+	struct ir_remote**	list;           /**< Remotes in config order. */
+	struct ir_remote**	order;          /**< Remotes in decode order. */
+	unsigned char*		overlap;        /**< count x count, see may_overlap(). */
+	int*			blocked;        /**< Work area for reorder_remotes(). */
+	unsigned int		hits;           /**< Hits since last reorder. */
+} adaptive;
+
+
+void set_adaptive_order(int enable)
+{
+	adaptive.enabled = enable;
+}
+
+
+void forget_decode_order(const struct ir_remote* remotes)
+{
+	if (adaptive.remotes == NULL || adaptive.remotes != remotes)
+		return;
+	free(adaptive.list);
+	free(adaptive.order);
+	free(adaptive.overlap);
+	free(adaptive.blocked);
+	adaptive.list = adaptive.order = NULL;
+	adaptive.overlap = NULL;
+	adaptive.blocked = NULL;
+	adaptive.remotes = NULL;
+	adaptive.count = 0;
+}
+
+
+static int pulses_overlap(const struct ir_remote* r1, lirc_t p1,
+			  const struct ir_remote* r2, lirc_t p2)
+{
+	return lower_limit(r1, p1) <= upper_limit(r2, p2)
+	       && lower_limit(r2, p2) <= upper_limit(r1, p1);
+}
+
+
+/** Can r2 decode a signal which is repeat_flag of r1? */
+static int repeat_overlaps(const struct ir_remote* r1, const struct ir_remote* r2)
+{
+	if (!has_repeat(r1) || r1->flags & REPEAT_HEADER)
+		return 0;
+	if (is_biphase(r1) || r1->plead > 0)
+		return 1;
+	return pulses_overlap(r1, r1->prepeat, r2, r2->phead);
+}
+
+
+/**
+ * Return false if r1 and r2 cannot decode the same signal, as the
+ * header pulses decode_all() checks (see set_decode_hint()) differ.
+ */
+static int may_overlap(const struct ir_remote* r1, const struct ir_remote* r2)
+{
+	if (!(r1->decode_hint & DECODE_HINT_HEAD_PULSE)
+	    || !(r2->decode_hint & DECODE_HINT_HEAD_PULSE))
+		return 1;
+	return pulses_overlap(r1, r1->phead, r2, r2->phead)
+	       || repeat_overlaps(r1, r2) || repeat_overlaps(r2, r1);
+}
+
+
+/** Set up the adaptive order for remotes in config order. */
+static int build_decode_order(struct ir_remote* remotes)
+{
+	struct ir_remote* remote;
+	int count, i, j;
+
+	forget_decode_order(adaptive.remotes);
+	for (count = 0, remote = remotes; remote != NULL; remote = remote->next)
+		count++;
+	adaptive.list = malloc(count * sizeof(*adaptive.list));
+	adaptive.order = malloc(count * sizeof(*adaptive.order));
+	adaptive.overlap = malloc(count * count);
+	adaptive.blocked = malloc(count * sizeof(*adaptive.blocked));
+	if (adaptive.list == NULL || adaptive.order == NULL
+	    || adaptive.overlap == NULL || adaptive.blocked == NULL) {
+		logprintf(LIRC_WARNING, "out of memory, using config order");
+		adaptive.remotes = remotes;
+		forget_decode_order(remotes);
+		return 0;
+	}
+	for (i = 0, remote = remotes; remote != NULL; remote = remote->next, i++) {
+		adaptive.list[i] = adaptive.order[i] = remote;
+		remote->decode_score = 0;
+		remote->decode_recent = 0;
+	}
+	for (i = 0; i < count; i++)
+		for (j = 0; j < count; j++)
+			adaptive.overlap[i * count + j] =
+				may_overlap(adaptive.list[i], adaptive.list[j]);
+	adaptive.remotes = remotes;
+	adaptive.count = count;
+	adaptive.hits = 0;
+	return 1;
+}
+
+
+/**
+ * Update the hit rates and sort the remotes on them. A remote is only
+ * placed once all remotes before it in config order which it may
+ * overlap with are placed, so these are still tried first.
+ */
+static void reorder_remotes(void)
+{
+	struct ir_remote* remote;
+	int count = adaptive.count;
+	int i, j, best;
+
+	for (i = 0; i < count; i++) {
+		remote = adaptive.list[i];
+		remote->decode_score = remote->decode_score / 2 + remote->decode_recent * 256;
+		remote->decode_recent = 0;
+		adaptive.blocked[i] = 0;
+		for (j = 0; j < i; j++)
+			adaptive.blocked[i] += adaptive.overlap[j * count + i];
+	}
+	for (i = 0; i < count; i++) {
+		best = -1;
+		for (j = 0; j < count; j++) {
+			if (adaptive.blocked[j] != 0)
+				continue;
+			if (best == -1
+			    || adaptive.list[j]->decode_score > adaptive.list[best]->decode_score)
+				best = j;
+		}
+		adaptive.order[i] = adaptive.list[best];
+		adaptive.blocked[best] = -1;
+		for (j = best + 1; j < count; j++)
+			if (adaptive.blocked[j] > 0)
+				adaptive.blocked[j] -= adaptive.overlap[best * count + j];
+	}
+	adaptive.hits = 0;
+}
+
+
+/** Return remotes in decode order, or NULL to use the list order. */
+static struct ir_remote** decode_order(struct ir_remote* remotes, int* count)
+{
+	if (!adaptive.enabled || remotes == NULL)
+		return NULL;
+	if (curr_driver->rec_mode != LIRC_MODE_MODE2
+	    && curr_driver->rec_mode != LIRC_MODE_PULSE
+	    && curr_driver->rec_mode != LIRC_MODE_RAW)
+		return NULL;
+	if (adaptive.remotes != remotes && !build_decode_order(remotes))
+		return NULL;
+	*count = adaptive.count;
+	return adaptive.order;
+}
+
+
+int get_decode_order(struct ir_remote* remotes, struct ir_remote** order, int size)
+{
+	struct ir_remote** current;
+	int count = 0;
+	int i;
+
+	current = decode_order(remotes, &count);
+	if (current == NULL) {
+		for (; remotes != NULL; remotes = remotes->next, count++)
+			if (count < size)
+				order[count] = remotes;
+		return count;
+	}
+	for (i = 0; i < count && i < size; i++)
+		order[i] = current[i];
+	return count;
+}
+
+
+/** Count a hit of remote in decode_all(). */
+static void count_hit(struct ir_remote* remote)
+{
+	remote->decode_hits++;
+	remote->decode_recent++;
+	if (adaptive.remotes != NULL && ++adaptive.hits >= REORDER_INTERVAL)
+		reorder_remotes();
+}
+
+
 char* decode_all(struct ir_remote* remotes)
 {
 	struct ir_remote* remote;
@@ -730,10 +1495,29 @@ char* decode_all(struct ir_remote* remotes)
 	struct ir_remote* scan;
 	struct ir_ncode* scan_ncode;
 	struct decode_ctx_t ctx;
+	lirc_t header[3];
+	int peeked;
+	int consumed;
+	struct ir_remote** order;
+	int count;
+	int i;
 
 	/* use remotes carefully, it may be changed on SIGHUP */
 	decoding = remote = remotes;
+	order = decode_order(remotes, &count);
+	if (order != NULL)
+		remote = order[0];
+	i = 0;
+	peeked = peek_header(remotes, header);
 	while (remote) {
+		consumed = peeked ? match_decode_hint(remote, header, peeked) : 0;
+		if (consumed > 0) {
+			LOGPRINTF(1, "skipping \"%s\" remote", remote->name);
+			skip_remote(remote, header[0], consumed);
+			remote->decode_misses++;
+			remote = order != NULL ? (++i < count ? order[i] : NULL) : remote->next;
+			continue;
+		}
 		LOGPRINTF(1, "trying \"%s\" remote", remote->name);
 		if (curr_driver->decode_func(remote, &ctx)) {
 			ncode = get_code(remote,
@@ -751,6 +1535,7 @@ char* decode_all(struct ir_remote* remotes)
 						PACKET_EOF, sizeof(message));
 					return message;
 				}
+				count_hit(remote);
 				ctx.code = set_code(remote,
 						    ncode,
 						    toggle_bit_mask_state,
@@ -804,7 +1589,8 @@ char* decode_all(struct ir_remote* remotes)
 			}
 		}
 		remote->toggle_mask_state = 0;
-		remote = remote->next;
+		remote->decode_misses++;
+		remote = order != NULL ? (++i < count ? order[i] : NULL) : remote->next;
 	}
 	decoding = NULL;
 	last_remote = NULL;
@@ -484,6 +484,71 @@ int write_message(char*		buffer,
 		  ir_code	code,
 		  int		reps);
 
+/**
+ * Build the hash table used by decode_all() to look up received codes
+ * in remote, replacing any existing one. Called when the remote is
+ * loaded. The table is not used once the remote's codes or data
+ * layout have been modified, the lookup then falls back to scanning
+ * all codes.
+ */
+void build_code_index(struct ir_remote* remote);
+
+/** Free the table created by build_code_index(), if any. */
+void free_code_index(struct ir_remote* remote);
+
+/**
+ * Node in the trie of a raw remote's codes. The children of a node
+ * hold the codes whose next duration is in overlapping tolerance
+ * windows; they are adjacent in the node array.
+ */
+struct ir_raw_node {
+	lirc_t			min, max;       /**< Durations all codes of the node accept. */
+	lirc_t			outer_min;      /**< Durations some code of the node accepts. */
+	lirc_t			outer_max;
+	lirc_t			timeout;        /**< Longest duration expected. */
+	int			child;          /**< Index of first child. */
+	int			n_children;
+	struct ir_ncode*	code;           /**< First code ending here or NULL. */
+	struct ir_ncode*	first;          /**< First code ending here or below. */
+};
+
+/**
+ * Return the trie of raw codes built by build_code_index(), root
+ * first, rebuilding it if the tolerances or driver resolution have
+ * changed. NULL if remote is not raw or the trie cannot be used.
+ */
+const struct ir_raw_node* get_raw_index(struct ir_remote* remote);
+
+/** decode_hint: header pulse must match phead. */
+#define DECODE_HINT_HEAD_PULSE  0x0001
+/** decode_hint: header space must be at least shead. */
+#define DECODE_HINT_HEAD_SPACE  0x0002
+
+/**
+ * Compute the decode_hint flags used by decode_all() to skip remotes
+ * which cannot match the header of the received signal. Called when
+ * the remote is loaded; a remote without any flags is always tried.
+ */
+void set_decode_hint(struct ir_remote* remote);
+
+/** bit_kernel: generic bit decoding in get_data(). */
+#define BIT_KERNEL_GENERIC      0
+/** bit_kernel: pulse + space per bit, pulse first, trailing pulse. */
+#define BIT_KERNEL_PULSE_SPACE  1
+/** bit_kernel: RC-MM, two bits per pulse + space. */
+#define BIT_KERNEL_RCMM         2
+
+/**
+ * Select the bit decoder used by receive_decode() for the remote's
+ * encoding and precompute its tolerance windows for the current
+ * driver. Called when the remote is loaded; receive_decode() calls it
+ * again if the remote or driver resolution has changed since.
+ */
+void set_bit_kernel(struct ir_remote* remote);
+
+/** Return true if remote->bit_kernel is up to date, see set_bit_kernel(). */
+int bit_kernel_is_current(const struct ir_remote* remote);
+
 /**
  * Tries to decode current signal trying all known remotes. This is
  * non-blocking, failures could be retried later when more data is
@@ -496,6 +561,24 @@ int write_message(char*		buffer,
  */
 char* decode_all(struct ir_remote* remotes);
 
+/**
+ * Enable or disable adaptive ordering in decode_all(). When enabled,
+ * remotes are tried in the order of their recent hit rate instead of
+ * the config order, but a remote is never tried before a remote
+ * listed earlier which may decode the same signals. Only remotes whose
+ * header pulses cannot match the same signal are reordered.
+ */
+void set_adaptive_order(int enable);
+
+/**
+ * Fill order with the remotes in the order decode_all() tries them.
+ * @return Number of remotes, at most size are stored.
+ */
+int get_decode_order(struct ir_remote* remotes, struct ir_remote** order, int size);
+
+/** Drop decode_all() state about remotes, called before freeing them. */
+void forget_decode_order(const struct ir_remote* remotes);
+
 /**
  * Transmits the actual code in the second  argument by calling the
  * current hardware driver.  The processing depends on global
@@ -0,0 +1,42 @@
+/****************************************************************************
+** ir_remote_private.h *****************************************************
+****************************************************************************
+*
+* ir_remote_private.h - ir_remote.c internals used by the unit tests
+*
+*/
+
+/**
+ * @file ir_remote_private.h
+ * @brief Internal ir_remote.c functions, not installed.
+ * @ingroup private_api
+ */
+
+#ifndef IR_REMOTE_PRIVATE_H
+#define IR_REMOTE_PRIVATE_H
+
+#include "ir_remote_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Return the code of remote matching decoded pre, code and post data,
+ * or NULL. Bits in toggle_bit_mask and ignore_mask are ignored, and so
+ * are the repeat_mask bits if *repeat_flag is set. Advances the state
+ * of codes with sequences. Uses the build_code_index() table when it
+ * is valid, otherwise scans the codes.
+ */
+struct ir_ncode* get_code(struct ir_remote*	remote,
+			  ir_code		pre,
+			  ir_code		code,
+			  ir_code		post,
+			  int*			repeat_flag,
+			  ir_code*		toggle_bit_mask_statep);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IR_REMOTE_PRIVATE_H */
@@ -95,6 +95,10 @@ struct ir_ncode {
 
 	/** Next code in recorded buttons list. */
 	struct ir_ncode*	next_ncode;
+
+	/** (private) Linux input code for name, set when the config is
+	 *  loaded. -1 if name is not in the input namespace. */
+	int			input_code;
 };
 
 /*
@@ -146,6 +150,9 @@ struct ir_ncode {
 #define IR_PARITY_EVEN 1
 #define IR_PARITY_ODD  2
 
+struct ir_code_index;
+struct ir_arena;
+
 /** State describing code, pre, post + gap and repeat state. */
 struct decode_ctx_t {
 	ir_code code;                   /**< Code part, matched to code defintion. */
@@ -157,6 +164,29 @@ struct decode_ctx_t {
 };
 
 
+/** Range of durations accepted for an expected value, see expect(). */
+struct ir_window {
+	lirc_t	min;
+	lirc_t	max;
+};
+
+/**
+ * Bit decoder chosen for a remote by set_bit_kernel(), with the
+ * tolerance windows precomputed. The values it was built from are
+ * kept so a remote modified later (e.g., by irrecord) is detected.
+ */
+struct ir_bit_kernel {
+	int			type;           /**< BIT_KERNEL_* */
+	int			flags;          /**< remote->flags when built. */
+	int			eps;            /**< remote->eps when built. */
+	unsigned int		aeps;           /**< remote->aeps when built. */
+	unsigned int		resolution;     /**< Driver resolution when built. */
+	lirc_t			timing[10];     /**< remote->pthree ... ptrail when built. */
+	struct ir_window	pone, sone;     /**< BIT_KERNEL_PULSE_SPACE: bit timings. */
+	struct ir_window	pzero, szero;
+	struct ir_window	sum[4];         /**< BIT_KERNEL_RCMM: pulse + space for 00, 01, 10, 11. */
+};
+
 /**
  * One remote as represented in the configuration file.
  */
@@ -247,6 +277,14 @@ struct ir_remote {
 	lirc_t			min_pulse_length, max_pulse_length;
 	lirc_t			min_space_length, max_space_length;
 	int			release_detected;       /**< set by release generator */
+	int			decode_hint;            /**< DECODE_HINT_* flags, see set_decode_hint() */
+	struct ir_bit_kernel	bit_kernel;             /**< see set_bit_kernel() */
+	unsigned int		decode_hits;            /**< Signals decoded by decode_all() */
+	unsigned int		decode_misses;          /**< Signals tried or skipped without match */
+	unsigned int		decode_score;           /**< Decaying hit rate, see set_adaptive_order() */
+	unsigned int		decode_recent;          /**< Hits since decode_score was updated */
+	struct ir_code_index*	code_index;             /**< code lookup table, see build_code_index() */
+	struct ir_arena*	arena;                  /**< Owner of config data, see read_config(). NULL: malloc()'d. */
 	int			manual_sort;            /**< If set in any remote, disables automatic sorting. */
 	struct ir_remote*	next;
 };
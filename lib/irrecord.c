@@ -169,6 +169,7 @@ int resethw(void)
 			logprintf(LIRC_ERROR, "Cannot reset root uid");
 	if (curr_driver->deinit_func)
 		curr_driver->deinit_func();
+	rec_buffer_init();
 	if (curr_driver->init_func) {
 		if (!curr_driver->init_func()) {
 			drop_sudo_root(seteuid);
@@ -257,6 +258,8 @@ static void set_toggle_bit_mask(struct ir_remote* remote, ir_code xor)
 			codes->code &= ~xor;
 			codes++;
 		}
+		/* the index can't tell that codes changed in place */
+		free_code_index(remote);
 	}
 	/* Sharp, Denon and some others use a toggle_mask */
 	else if (bits == 15 && xor == 0x3ff) {
@@ -321,6 +324,7 @@ void get_pre_data(struct ir_remote* remote)
 				n->code &= ~mask;
 			codes++;
 		}
+		free_code_index(remote);
 	}
 }
 
@@ -377,6 +381,7 @@ void get_post_data(struct ir_remote* remote)
 				n->code = n->code >> count;
 			codes++;
 		}
+		free_code_index(remote);
 	}
 }
 
@@ -395,6 +400,7 @@ void remove_pre_data(struct ir_remote* remote)
 		for (n = codes->next; n != NULL; n = n->next)
 			n->code |= remote->pre_data << remote->bits;
 	}
+	free_code_index(remote);
 	remote->bits += remote->pre_data_bits;
 	remote->pre_data = 0;
 	remote->pre_data_bits = 0;
@@ -416,6 +422,7 @@ void remove_post_data(struct ir_remote* remote)
 			n->code |= remote->post_data;
 		}
 	}
+	free_code_index(remote);
 	remote->bits += remote->post_data_bits;
 	remote->post_data = 0;
 	remote->post_data_bits = 0;
@@ -458,6 +465,7 @@ void invert_data(struct ir_remote* remote)
 		for (n = codes->next; n != NULL; n = n->next)
 			n->code ^= mask;
 	}
+	free_code_index(remote);
 }
 
 
@@ -20,10 +20,12 @@
 # include <config.h>
 #endif
 
+#include <ctype.h>
 #include <errno.h>
 #include <libgen.h>
 #include <limits.h>
 #include <netdb.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -34,6 +36,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
 
@@ -307,6 +310,217 @@ bad_packet:
 }
 
 
+void lirc_command_pipe(lirc_cmd_pipe* ctx, int fd)
+{
+	memset(ctx, 0, sizeof(lirc_cmd_pipe));
+	ctx->fd = fd;
+	ctx->state = P_BEGIN;
+	ctx->match = -1;
+}
+
+
+int lirc_command_submit(lirc_cmd_pipe* ctx, lirc_cmd_ctx* cmd)
+{
+	if (ctx->count == LIRC_PIPE_SIZE)
+		return EAGAIN;
+	cmd->reply[0] = '\0';
+	ctx->cmds[ctx->count++] = cmd;
+	return 0;
+}
+
+
+int lirc_command_flush(lirc_cmd_pipe* ctx)
+{
+	struct iovec iov[LIRC_PIPE_SIZE];
+	unsigned int i;
+	int iovcnt = 0;
+	size_t len;
+	ssize_t n;
+
+	for (i = ctx->sent; i < ctx->count; i++) {
+		iov[iovcnt].iov_base = ctx->cmds[i]->packet;
+		iov[iovcnt].iov_len = strlen(ctx->cmds[i]->packet);
+		iovcnt++;
+	}
+	if (iovcnt == 0)
+		return 0;
+	iov[0].iov_base = (char*)iov[0].iov_base + ctx->written;
+	iov[0].iov_len -= ctx->written;
+	n = writev(ctx->fd, iov, iovcnt);
+	if (n == -1)
+		return errno == EAGAIN || errno == EINTR ? 0 : errno;
+	n += ctx->written;
+	while (ctx->sent < ctx->count) {
+		len = strlen(ctx->cmds[ctx->sent]->packet);
+		if ((size_t)n < len)
+			break;
+		n -= len;
+		ctx->sent++;
+	}
+	ctx->written = n;
+	return 0;
+}
+
+
+int lirc_command_events(const lirc_cmd_pipe* ctx)
+{
+	int events = 0;
+
+	if (ctx->sent < ctx->count)
+		events |= POLLOUT;
+	if (ctx->sent > 0)
+		events |= POLLIN;
+	return events;
+}
+
+
+/* The sent command echoed in a reply, or -1. */
+static int pipe_match(lirc_cmd_pipe* ctx, const char* echo)
+{
+	size_t len = strlen(echo);
+	unsigned int i;
+
+	for (i = 0; i < ctx->sent; i++)
+		if (strlen(ctx->cmds[i]->packet) == len + 1
+		    && strncasecmp(ctx->cmds[i]->packet, echo, len) == 0)
+			return i;
+	return -1;
+}
+
+
+/* Store a reply data line in the matched command, if any. */
+static void pipe_data(lirc_cmd_pipe* ctx, const char* line)
+{
+	char* reply;
+	size_t len;
+
+	if (ctx->match == -1)
+		return;
+	reply = ctx->cmds[ctx->match]->reply;
+	len = strlen(reply);
+	if (len > 0 && len < PACKET_SIZE)
+		reply[len++] = '\n';
+	snprintf(reply + len, PACKET_SIZE + 1 - len, "%s", line);
+}
+
+
+/*
+ * Feed one reply line to the parser, as in lirc_command_run(). Return
+ * 1 when a reply is complete, -1 on protocol errors, else 0.
+ */
+static int pipe_line(lirc_cmd_pipe* ctx, const char* line)
+{
+	char* endptr;
+
+	switch (ctx->state) {
+	case P_BEGIN:
+		if (strcasecmp(line, "BEGIN") == 0)
+			ctx->state = P_MESSAGE;
+		return 0;
+	case P_MESSAGE:
+		/* Broadcasts like SIGHUP also end up here, unmatched */
+		ctx->match = pipe_match(ctx, line);
+		ctx->status = 0;
+		ctx->state = P_STATUS;
+		return 0;
+	case P_STATUS:
+		if (strcasecmp(line, "END") == 0)
+			break;
+		if (strcasecmp(line, "SUCCESS") == 0)
+			ctx->status = 0;
+		else if (strcasecmp(line, "ERROR") == 0)
+			ctx->status = EIO;
+		else
+			return -1;
+		ctx->state = P_DATA;
+		return 0;
+	case P_DATA:
+		if (strcasecmp(line, "END") == 0)
+			break;
+		if (strcasecmp(line, "DATA") != 0)
+			return -1;
+		ctx->state = P_N;
+		return 0;
+	case P_N:
+		ctx->data_n = strtoul(line, &endptr, 0);
+		if (*line == '\0' || *endptr != '\0')
+			return -1;
+		ctx->n = 0;
+		ctx->state = ctx->data_n == 0 ? P_END : P_DATA_N;
+		return 0;
+	case P_DATA_N:
+		pipe_data(ctx, line);
+		if (++ctx->n == ctx->data_n)
+			ctx->state = P_END;
+		return 0;
+	case P_END:
+		if (strcasecmp(line, "END") != 0)
+			return -1;
+		break;
+	}
+	ctx->state = P_BEGIN;
+	return ctx->match != -1;
+}
+
+
+int lirc_command_reply(lirc_cmd_pipe* ctx, lirc_cmd_ctx** cmd, int* status)
+{
+	char* line;
+	char* end;
+	unsigned int i;
+	ssize_t n;
+	int have_read = 0;
+	int r;
+
+	while (1) {
+		line = ctx->buffer + ctx->head;
+		end = (char*)memchr(line, '\n', ctx->tail - ctx->head);
+		if (end != NULL) {
+			*end = '\0';
+			ctx->head = end + 1 - ctx->buffer;
+			r = pipe_line(ctx, line);
+			if (r == -1) {
+				logprintf(LIRC_WARNING,
+					  "%s: bad return packet: %s\n",
+					  prog, line);
+				errno = EPROTO;
+				return -1;
+			}
+			if (r == 0)
+				continue;
+			*cmd = ctx->cmds[ctx->match];
+			*status = ctx->status;
+			for (i = ctx->match; i + 1 < ctx->count; i++)
+				ctx->cmds[i] = ctx->cmds[i + 1];
+			ctx->count--;
+			ctx->sent--;
+			ctx->match = -1;
+			return 1;
+		}
+		if (have_read)
+			return 0;
+		if (ctx->head == 0 && ctx->tail == sizeof(ctx->buffer)) {
+			errno = EPROTO;
+			return -1;
+		}
+		memmove(ctx->buffer, ctx->buffer + ctx->head, ctx->tail - ctx->head);
+		ctx->tail -= ctx->head;
+		ctx->head = 0;
+		n = read(ctx->fd, ctx->buffer + ctx->tail,
+			 sizeof(ctx->buffer) - ctx->tail);
+		if (n <= 0) {
+			if (n == -1 && (errno == EAGAIN || errno == EINTR))
+				return 0;
+			if (n == 0)
+				errno = ECONNRESET;
+			return -1;
+		}
+		ctx->tail += n;
+		have_read = 1;
+	}
+}
+
+
 static void lirc_printf(const char* format_str, ...)
 {
 	va_list ap;
@@ -1024,6 +1238,265 @@ static void lirc_freeconfigentries(struct lirc_config_entry* first)
 }
 
 
+/*
+ * The match index used by lirc_code2char(). A scan of all entries calls
+ * lirc_iscode() on each of them, but for most entries this does nothing.
+ * It only matters for an entry if
+ *  - it has no code, or its next code matches the event, or
+ *  - its state must be reset on other events: it is in the middle of
+ *    a sequence, or it has toggle_reset and is not at its first config.
+ * Entries in their initial state are found through a hash table keyed
+ * by their first code, the others ("dirty" entries) are kept in a list.
+ * The candidates are then run in config order, just as the scan does.
+ */
+
+/** Entries whose first code has remote and button, NULL meaning any. */
+struct lirc_bucket {
+	const char*		remote;
+	const char*		button;
+	unsigned int		hash;
+	int			count;
+	int*			items;  /**< Entry positions, ascending. */
+	struct lirc_bucket*	next;
+};
+
+struct lirc_index {
+	int				count;          /**< Number of entries. */
+	struct lirc_config_entry**	entries;        /**< Entries in config order. */
+	int				resume;         /**< Position of config->next. */
+	struct lirc_bucket**		table;
+	unsigned int			mask;
+	struct lirc_bucket		always;         /**< Entries matching any code. */
+	int*				dirty;
+	int				n_dirty;
+	int*				candidates;
+	unsigned int*			seen;
+	unsigned int			epoch;
+};
+
+
+static unsigned int lirc_hash(const char* remote, const char* button)
+{
+	unsigned int h = 2166136261u;
+	const char* c;
+
+	for (c = remote != NULL ? remote : ""; *c != '\0'; c++)
+		h = (h ^ tolower((unsigned char)*c)) * 16777619u;
+	h = (h ^ 0xff) * 16777619u;
+	for (c = button != NULL ? button : ""; *c != '\0'; c++)
+		h = (h ^ tolower((unsigned char)*c)) * 16777619u;
+	return h;
+}
+
+
+static int lirc_key_equal(const char* a, const char* b)
+{
+	if (a == NULL || b == NULL)
+		return a == b;
+	return strcasecmp(a, b) == 0;
+}
+
+
+static struct lirc_bucket* lirc_index_bucket(struct lirc_index*	index,
+					     const char*	remote,
+					     const char*	button,
+					     int		create)
+{
+	unsigned int hash = lirc_hash(remote, button);
+	struct lirc_bucket* bucket;
+
+	for (bucket = index->table[hash & index->mask];
+	     bucket != NULL;
+	     bucket = bucket->next) {
+		if (bucket->hash == hash
+		    && lirc_key_equal(bucket->remote, remote)
+		    && lirc_key_equal(bucket->button, button))
+			return bucket;
+	}
+	if (!create)
+		return NULL;
+	bucket = calloc(1, sizeof(*bucket));
+	if (bucket == NULL)
+		return NULL;
+	bucket->remote = remote;
+	bucket->button = button;
+	bucket->hash = hash;
+	bucket->next = index->table[hash & index->mask];
+	index->table[hash & index->mask] = bucket;
+	return bucket;
+}
+
+
+static int lirc_bucket_add(struct lirc_bucket* bucket, int item)
+{
+	if ((bucket->count & (bucket->count - 1)) == 0) {
+		int* items;
+
+		items = realloc(bucket->items,
+				(bucket->count ? bucket->count * 2 : 1) * sizeof(int));
+		if (items == NULL)
+			return 0;
+		bucket->items = items;
+	}
+	bucket->items[bucket->count++] = item;
+	return 1;
+}
+
+
+/** Return true if lirc_iscode() may change the entry on any event. */
+static int lirc_is_dirty(const struct lirc_config_entry* scan)
+{
+	if (scan->code == NULL)
+		return 0;
+	return scan->next_code != scan->code
+	       || ((scan->flags & toggle_reset)
+		   && scan->next_config != scan->config);
+}
+
+
+static void lirc_index_free(struct lirc_index* index)
+{
+	struct lirc_bucket* bucket;
+	unsigned int i;
+
+	if (index == NULL)
+		return;
+	for (i = 0; index->table != NULL && i <= index->mask; i++) {
+		while (index->table[i] != NULL) {
+			bucket = index->table[i];
+			index->table[i] = bucket->next;
+			free(bucket->items);
+			free(bucket);
+		}
+	}
+	free(index->always.items);
+	free(index->table);
+	free(index->entries);
+	free(index->dirty);
+	free(index->candidates);
+	free(index->seen);
+	free(index);
+}
+
+
+/** Build the index for a list of entries, NULL on errors. */
+static struct lirc_index* lirc_index_build(struct lirc_config_entry* first)
+{
+	struct lirc_index* index;
+	struct lirc_config_entry* scan;
+	unsigned int size;
+	int i;
+
+	index = calloc(1, sizeof(*index));
+	if (index == NULL)
+		return NULL;
+	for (scan = first; scan != NULL; scan = scan->next)
+		index->count++;
+	for (size = 16; size < 2 * (unsigned int)index->count; size *= 2)
+		;
+	index->mask = size - 1;
+	index->table = calloc(size, sizeof(*index->table));
+	index->entries = calloc(index->count + 1, sizeof(*index->entries));
+	index->dirty = calloc(index->count + 1, sizeof(int));
+	index->candidates = calloc(index->count + 1, sizeof(int));
+	index->seen = calloc(index->count + 1, sizeof(unsigned int));
+	if (index->table == NULL || index->entries == NULL
+	    || index->dirty == NULL || index->candidates == NULL
+	    || index->seen == NULL)
+		goto error;
+	for (scan = first, i = 0; scan != NULL; scan = scan->next, i++) {
+		struct lirc_bucket* bucket = &index->always;
+
+		index->entries[i] = scan;
+		if (scan->code != NULL) {
+			const char* remote = scan->code->remote;
+			const char* button = scan->code->button;
+
+			remote = remote == LIRC_ALL ? NULL : remote;
+			button = button == LIRC_ALL ? NULL : button;
+			if (remote != NULL || button != NULL)
+				bucket = lirc_index_bucket(index, remote, button, 1);
+		}
+		if (bucket == NULL || !lirc_bucket_add(bucket, i))
+			goto error;
+		if (lirc_is_dirty(scan))
+			index->dirty[index->n_dirty++] = i;
+	}
+	return index;
+
+error:
+	lirc_index_free(index);
+	return NULL;
+}
+
+
+static void lirc_index_add(struct lirc_index*		index,
+			   const struct lirc_bucket*	bucket,
+			   const int*			items,
+			   int				count,
+			   int*				n)
+{
+	int i;
+
+	if (bucket != NULL) {
+		items = bucket->items;
+		count = bucket->count;
+	}
+	for (i = 0; i < count; i++) {
+		if (index->seen[items[i]] != index->epoch) {
+			index->seen[items[i]] = index->epoch;
+			index->candidates[(*n)++] = items[i];
+		}
+	}
+}
+
+
+static int lirc_cmp_int(const void* a, const void* b)
+{
+	return *(const int*)a - *(const int*)b;
+}
+
+
+/**
+ * Store the positions of all entries lirc_iscode() may act on for an
+ * event in index->candidates, in config order. Returns their number.
+ */
+static int lirc_index_lookup(struct lirc_index*	index,
+			     const char*	remote,
+			     const char*	button)
+{
+	int n = 0;
+
+	index->epoch++;
+	if (index->epoch == 0) {
+		memset(index->seen, 0, index->count * sizeof(unsigned int));
+		index->epoch = 1;
+	}
+	lirc_index_add(index, &index->always, NULL, 0, &n);
+	lirc_index_add(index, NULL, index->dirty, index->n_dirty, &n);
+	lirc_index_add(index, lirc_index_bucket(index, remote, button, 0),
+		       NULL, 0, &n);
+	lirc_index_add(index, lirc_index_bucket(index, remote, NULL, 0),
+		       NULL, 0, &n);
+	lirc_index_add(index, lirc_index_bucket(index, NULL, button, 0),
+		       NULL, 0, &n);
+	qsort(index->candidates, n, sizeof(int), lirc_cmp_int);
+	return n;
+}
+
+
+/** Recompute the dirty list after the candidates have been run. */
+static void lirc_index_update(struct lirc_index* index, int n)
+{
+	int i;
+
+	index->n_dirty = 0;
+	for (i = 0; i < n; i++)
+		if (lirc_is_dirty(index->entries[index->candidates[i]]))
+			index->dirty[index->n_dirty++] = index->candidates[i];
+}
+
+
 static void
 parse_shebang(char* line, int depth, const char* path, char* buff, size_t size)
 {
@@ -1383,6 +1856,7 @@ static int lirc_readconfig_only_internal(const char*		file,
 		}
 		(*config)->first = first;
 		(*config)->next = first;
+		(*config)->index = lirc_index_build(first);
 		startupmode = lirc_startupmode((*config)->first);
 		(*config)->current_mode =
 			startupmode ? strdup(startupmode) : NULL;
@@ -1520,6 +1994,7 @@ void lirc_freeconfig(struct lirc_config* config)
 		if (config->lircrc_class != NULL)
 			free(config->lircrc_class);
 		lirc_freeconfigentries(config->first);
+		lirc_index_free(config->index);
 		free(config->current_mode);
 		free(config);
 	}
@@ -1718,6 +2193,78 @@ char* lirc_ir2char(struct lirc_config* config, char* code)
 }
 
 
+/*
+ * Match one entry against an event and run it if it is enabled in the
+ * current mode. Returns 1 if no further entries should be tried.
+ */
+static int lirc_run_entry(struct lirc_config*		config,
+			  struct lirc_config_entry*	scan,
+			  char*				remote,
+			  char*				button,
+			  int				rep,
+			  char**			s,
+			  char**			prog,
+			  int*				quit_happened)
+{
+	int exec_level;
+
+	exec_level = lirc_iscode(scan, remote, button, rep);
+	if (exec_level > 0 &&
+	    (scan->mode == NULL ||
+	     (scan->mode != NULL &&
+	      config->current_mode != NULL &&
+	      strcasecmp(scan->mode, config->current_mode) == 0)) &&
+	    *quit_happened == 0) {
+		if (exec_level > 1) {
+			*s = lirc_execute(config, scan);
+			if (*s != NULL && prog != NULL)
+				*prog = scan->prog;
+		} else {
+			*s = NULL;
+		}
+		if (scan->flags & quit) {
+			*quit_happened = 1;
+			config->next = NULL;
+		} else if (*s != NULL) {
+			config->next = scan->next;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+/* Run the candidates from the index, see lirc_index_lookup(). */
+static void lirc_run_index(struct lirc_config*	config,
+			   char*		remote,
+			   char*		button,
+			   int			rep,
+			   char**		s,
+			   char**		prog)
+{
+	struct lirc_index* index = config->index;
+	int quit_happened = 0;
+	int n;
+	int i;
+
+	n = lirc_index_lookup(index, remote, button);
+	for (i = 0; i < n; i++) {
+		int pos = index->candidates[i];
+
+		if (pos < index->resume)
+			continue;
+		if (lirc_run_entry(config, index->entries[pos], remote, button,
+				   rep, s, prog, &quit_happened)) {
+			index->resume = pos + 1;
+			break;
+		}
+	}
+	if (config->next == NULL)
+		index->resume = index->count;
+	lirc_index_update(index, n);
+}
+
+
 static int lirc_code2char_internal(struct lirc_config*	config,
 				   char*		code,
 				   char**		string,
@@ -1729,9 +2276,16 @@ static int lirc_code2char_internal(struct lirc_config*	config,
 	char* button;
 	char* s = NULL;
 	struct lirc_config_entry* scan;
-	int exec_level;
+	struct lirc_index* index = config->index;
 	int quit_happened;
 
+	/* The index is only valid if nobody else has moved config->next */
+	if (index != NULL
+	    && config->next != (index->resume < index->count ?
+				index->entries[index->resume] : NULL)) {
+		lirc_index_free(index);
+		config->index = index = NULL;
+	}
 	*string = NULL;
 	if (sscanf(code, "%*x %x %*s %*s\n", &rep) == 1) {
 		backup = strdup(code);
@@ -1748,35 +2302,17 @@ static int lirc_code2char_internal(struct lirc_config*	config,
 			return 0;
 		}
 
-		scan = config->next;
-		quit_happened = 0;
-		while (scan != NULL) {
-			exec_level = lirc_iscode(scan, remote, button, rep);
-			if (exec_level > 0 &&
-			    (scan->mode == NULL ||
-			     (scan->mode != NULL &&
-			      config->current_mode != NULL &&
-			      strcasecmp(scan->mode,
-					 config->current_mode) == 0)) &&
-			    quit_happened == 0) {
-				if (exec_level > 1) {
-					s = lirc_execute(config, scan);
-					if (s != NULL && prog != NULL)
-						*prog = scan->prog;
-				} else {
-					s = NULL;
-				}
-				if (scan->flags & quit) {
-					quit_happened = 1;
-					config->next = NULL;
-					scan = scan->next;
-					continue;
-				} else if (s != NULL) {
-					config->next = scan->next;
+		if (index != NULL) {
+			lirc_run_index(config, remote, button, rep, &s, prog);
+		} else {
+			scan = config->next;
+			quit_happened = 0;
+			while (scan != NULL) {
+				if (lirc_run_entry(config, scan, remote, button,
+						   rep, &s, prog, &quit_happened))
 					break;
-				}
+				scan = scan->next;
 			}
-			scan = scan->next;
 		}
 		free(backup);
 		if (s != NULL) {
@@ -1785,6 +2321,8 @@ static int lirc_code2char_internal(struct lirc_config*	config,
 		}
 	}
 	config->next = config->first;
+	if (index != NULL)
+		index->resume = 0;
 	return 0;
 }
 
@@ -1999,6 +2537,246 @@ int lirc_simulate(int		fd,
 }
 
 
+int lirc_event_start(lirc_event_ctx* ctx, int fd)
+{
+	lirc_cmd_ctx cmd;
+	int r;
+
+	memset(ctx, 0, sizeof(lirc_event_ctx));
+	ctx->fd = fd;
+	r = lirc_command_init(&cmd, "SET_EVENT_FORMAT BINARY %d\n",
+			      LIRC_EVENT_PROTOCOL);
+	if (r != 0)
+		return r;
+	do
+		r = lirc_command_run(&cmd, fd);
+	while (r == EAGAIN);
+	if (r != 0)
+		return r == EIO ? EPROTO : r;
+	/* Keep frames read along with the reply. */
+	if (cmd.next != NULL && cmd.next < cmd.buffer + cmd.head) {
+		ctx->tail = cmd.buffer + cmd.head - cmd.next;
+		memcpy(ctx->buffer, cmd.next, ctx->tail);
+	}
+	return 0;
+}
+
+
+/** Store the name defined by a LIRC_FRAME_NAME payload, return 0 or -1. */
+static int add_name(lirc_event_ctx* ctx, const char* payload, unsigned int len)
+{
+	uint32_t id;
+	uint32_t size;
+	char** names;
+	const char* name = payload + sizeof(id);
+
+	if (len <= sizeof(id) || payload[len - 1] != '\0') {
+		errno = EPROTO;
+		return -1;
+	}
+	memcpy(&id, payload, sizeof(id));
+	if (id >= ctx->names_size) {
+		size = ctx->names_size > 0 ? ctx->names_size : 64;
+		while (size <= id)
+			size *= 2;
+		names = (char**)realloc(ctx->names, size * sizeof(char*));
+		if (names == NULL)
+			return -1;
+		memset(names + ctx->names_size, 0,
+		       (size - ctx->names_size) * sizeof(char*));
+		ctx->names = names;
+		ctx->names_size = size;
+	}
+	free(ctx->names[id]);
+	ctx->names[id] = strdup(name);
+	return ctx->names[id] != NULL ? 0 : -1;
+}
+
+
+int lirc_event_read(lirc_event_ctx* ctx, struct lirc_event* event)
+{
+	struct lirc_frame_hdr hdr;
+	struct lirc_frame_event ev;
+	const char* payload;
+	ssize_t n;
+	int have_read = 0;
+
+	while (1) {
+		if (ctx->tail - ctx->head >= sizeof(hdr)) {
+			memcpy(&hdr, ctx->buffer + ctx->head, sizeof(hdr));
+			if (sizeof(hdr) + hdr.len > sizeof(ctx->buffer)) {
+				errno = EPROTO;
+				return -1;
+			}
+		}
+		if (ctx->tail - ctx->head >= sizeof(hdr)
+		    && ctx->tail - ctx->head >= sizeof(hdr) + hdr.len) {
+			payload = ctx->buffer + ctx->head + sizeof(hdr);
+			ctx->head += sizeof(hdr) + hdr.len;
+			if (hdr.type == LIRC_FRAME_NAME) {
+				if (add_name(ctx, payload, hdr.len) == -1)
+					return -1;
+				continue;
+			}
+			if (hdr.type != LIRC_FRAME_EVENT)
+				continue;       /* text or unknown */
+			if (hdr.len < sizeof(ev)) {
+				errno = EPROTO;
+				return -1;
+			}
+			memcpy(&ev, payload, sizeof(ev));
+			if (ev.remote_id >= ctx->names_size
+			    || ev.button_id >= ctx->names_size
+			    || ctx->names[ev.remote_id] == NULL
+			    || ctx->names[ev.button_id] == NULL) {
+				errno = EPROTO;
+				return -1;
+			}
+			event->remote = ctx->names[ev.remote_id];
+			event->button = ctx->names[ev.button_id];
+			event->code = ev.code;
+			event->timestamp = ev.timestamp;
+			event->reps = ev.reps;
+			event->release = ev.flags & LIRC_EVENT_RELEASE ? 1 : 0;
+			return 1;
+		}
+		if (have_read)
+			return 0;
+		memmove(ctx->buffer, ctx->buffer + ctx->head, ctx->tail - ctx->head);
+		ctx->tail -= ctx->head;
+		ctx->head = 0;
+		n = read(ctx->fd, ctx->buffer + ctx->tail,
+			 sizeof(ctx->buffer) - ctx->tail);
+		if (n <= 0) {
+			if (n == -1 && (errno == EAGAIN || errno == EINTR))
+				return 0;
+			if (n == 0)
+				errno = ECONNRESET;
+			return -1;
+		}
+		ctx->tail += n;
+		have_read = 1;
+	}
+}
+
+
+void lirc_code_start(lirc_code_ctx* ctx, int fd)
+{
+	memset(ctx, 0, sizeof(lirc_code_ctx));
+	ctx->fd = fd;
+}
+
+
+/*
+ * Split a copy of ctx->line into code, reps, button and remote, the
+ * way lirc_code2char() does. Return 1 if it is a button event.
+ */
+static int split_code(lirc_code_ctx* ctx, struct lirc_code_event* event)
+{
+	char* field[3];
+	char* s;
+	char* end;
+	unsigned long reps;
+	int i;
+
+	strcpy(ctx->fields, ctx->line);
+	s = ctx->fields;
+	for (i = 0; i < 3; i++) {
+		field[i] = s;
+		s = strchr(s, ' ');
+		if (s == NULL)
+			return 0;
+		*s++ = '\0';
+	}
+	end = strchr(s, '\n');
+	if (end != NULL)
+		*end = '\0';
+	reps = strtoul(field[1], &end, 16);
+	if (*field[1] == '\0' || *end != '\0' || *field[2] == '\0' || *s == '\0')
+		return 0;
+	event->line = ctx->line;
+	event->code = field[0];
+	event->reps = reps;
+	event->button = field[2];
+	event->remote = s;
+	return 1;
+}
+
+
+int lirc_code_read(lirc_code_ctx* ctx, struct lirc_code_event* event)
+{
+	char* start;
+	char* end;
+	unsigned int len;
+	ssize_t n;
+	int have_read = 0;
+
+	while (1) {
+		start = ctx->buffer + ctx->head;
+		end = (char*)memchr(start, '\n', ctx->tail - ctx->head);
+		if (end != NULL) {
+			len = end + 1 - start;
+			ctx->head += len;
+			if (len >= sizeof(ctx->line))
+				continue;       /* not from lircd */
+			memcpy(ctx->line, start, len);
+			ctx->line[len] = '\0';
+			if (strcmp(ctx->line, "BEGIN\n") == 0) {
+				ctx->in_reply = 1;
+				continue;
+			}
+			if (ctx->in_reply) {
+				if (strcmp(ctx->line, "END\n") == 0)
+					ctx->in_reply = 0;
+				continue;
+			}
+			if (split_code(ctx, event)) {
+				ctx->pending = 1;
+				return 1;
+			}
+			continue;
+		}
+		if (have_read)
+			return 0;
+		if (ctx->pending) {
+			/* Drained, the caller may not know if it's readable */
+			ctx->pending = 0;
+			return 0;
+		}
+		if (ctx->head == 0 && ctx->tail == sizeof(ctx->buffer)) {
+			errno = EPROTO;
+			return -1;
+		}
+		memmove(ctx->buffer, ctx->buffer + ctx->head, ctx->tail - ctx->head);
+		ctx->tail -= ctx->head;
+		ctx->head = 0;
+		n = read(ctx->fd, ctx->buffer + ctx->tail,
+			 sizeof(ctx->buffer) - ctx->tail);
+		if (n <= 0) {
+			if (n == -1 && (errno == EAGAIN || errno == EINTR))
+				return 0;
+			if (n == 0)
+				errno = ECONNRESET;
+			return -1;
+		}
+		ctx->tail += n;
+		have_read = 1;
+	}
+}
+
+
+void lirc_event_free(lirc_event_ctx* ctx)
+{
+	uint32_t i;
+
+	for (i = 0; i < ctx->names_size; i++)
+		free(ctx->names[i]);
+	free(ctx->names);
+	ctx->names = NULL;
+	ctx->names_size = 0;
+}
+
+
 /** Create and connect() socket to addr, print errors unless quiet. */
 static int
 do_connect(int domain, struct sockaddr* addr, size_t size, int quiet)
@@ -156,6 +156,8 @@ struct lirc_code {
 	struct lirc_code*	next;
 };
 
+struct lirc_index;
+
 struct lirc_config {
 	char*				lircrc_class; /**< The lircrc instance used, if any. */
 	char*				current_mode;
@@ -163,6 +165,7 @@ struct lirc_config {
 	struct lirc_config_entry*	first;
 
 	int				sockfd;
+	struct lirc_index*		index;  /**< (private) Entry lookup, NULL if none. */
 };
 
 struct lirc_config_entry {
@@ -197,6 +200,106 @@ typedef struct {
 	char*	next;                           /**< Next newline-separated word in buffer.*/
 } lirc_cmd_ctx;
 
+/** Max number of commands queued in a lirc_cmd_pipe. */
+#define LIRC_PIPE_SIZE          16
+
+/**
+ * Commands pipelined on one lircd connection, driven by the caller's
+ * event loop. See lirc_command_submit().
+ */
+typedef struct {
+	int		fd;                     /**< Connected lircd socket. */
+	lirc_cmd_ctx*	cmds[LIRC_PIPE_SIZE];   /**< Queued commands, oldest first. */
+	unsigned int	count;                  /**< Number of queued commands. */
+	unsigned int	sent;                   /**< Commands completely written. */
+	unsigned int	written;                /**< Bytes written of cmds[sent]. */
+	char		buffer[4 * PACKET_SIZE];/**< Reply input buffer. */
+	unsigned int	head;                   /**< First unparsed byte. */
+	unsigned int	tail;                   /**< End of data. */
+	int		state;                  /**< Reply parser state. */
+	int		match;                  /**< Index of replied command, or -1. */
+	int		status;                 /**< Status of current reply. */
+	unsigned int	data_n;                 /**< Data lines in current reply. */
+	unsigned int	n;                      /**< Data lines seen. */
+} lirc_cmd_pipe;
+
+/** Binary event protocol version implemented, see lirc_event_start(). */
+#define LIRC_EVENT_PROTOCOL     1
+
+/**
+ * Frame types in the binary event protocol. Each frame is a
+ * lirc_frame_hdr followed by hdr.len bytes payload. All numbers are
+ * in native byte order, the protocol is meant for local clients.
+ */
+enum lirc_frame_type {
+	LIRC_FRAME_TEXT		= 1,    /**< Text as in the text protocol, e. g. replies. */
+	LIRC_FRAME_NAME		= 2,    /**< Defines a name: uint32_t id, name, '\0'. */
+	LIRC_FRAME_EVENT	= 3     /**< A button event: lirc_frame_event. */
+};
+
+/** Binary protocol frame header. */
+struct lirc_frame_hdr {
+	uint16_t	type;   /**< A lirc_frame_type. */
+	uint16_t	len;    /**< Payload size. */
+};
+
+/** lirc_frame_event flag: A release event, see lircd --release. */
+#define LIRC_EVENT_RELEASE      0x01
+
+/**
+ * Payload of a LIRC_FRAME_EVENT. The names are sent once in a
+ * LIRC_FRAME_NAME before the first event using them.
+ */
+struct lirc_frame_event {
+	uint64_t	code;           /**< Decoded scancode. */
+	uint64_t	timestamp;      /**< CLOCK_MONOTONIC time of event (us). */
+	uint32_t	remote_id;      /**< ID of remote name. */
+	uint32_t	button_id;      /**< ID of button name. */
+	uint32_t	reps;           /**< Repeat count, 0 for first press. */
+	uint32_t	flags;          /**< LIRC_EVENT_RELEASE or 0. */
+};
+
+/** A button event as returned by lirc_event_read(). */
+struct lirc_event {
+	const char*	remote;         /**< Remote name, owned by the ctx. */
+	const char*	button;         /**< Button name, owned by the ctx. */
+	uint64_t	code;           /**< Decoded scancode. */
+	uint64_t	timestamp;      /**< CLOCK_MONOTONIC time of event (us). */
+	unsigned int	reps;           /**< Repeat count. */
+	int		release;        /**< True for release events. */
+};
+
+/** A text protocol event as returned by lirc_code_read(). */
+struct lirc_code_event {
+	char*		line;   /**< Complete line incl. newline, for lirc_code2char(). */
+	const char*	code;   /**< Scancode as hex string. */
+	const char*	button; /**< Button name. */
+	const char*	remote; /**< Remote name. */
+	unsigned int	reps;   /**< Repeat count, 0 for first press. */
+};
+
+/** Input state of a text protocol connection read by lirc_code_read(). */
+typedef struct {
+	int		fd;                     /**< Connected lircd socket. */
+	char		buffer[4 * PACKET_SIZE];/**< Input buffer. */
+	unsigned int	head;                   /**< First unused byte. */
+	unsigned int	tail;                   /**< End of data. */
+	int		in_reply;               /**< Inside a BEGIN..END reply. */
+	int		pending;                /**< Events returned since last read. */
+	char		line[PACKET_SIZE + 2];  /**< Line of the last event. */
+	char		fields[PACKET_SIZE + 2];/**< The same line, split. */
+} lirc_code_ctx;
+
+/** Input state of a connection using the binary event protocol. */
+typedef struct {
+	int		fd;                     /**< Connected lircd socket. */
+	char		buffer[4 * PACKET_SIZE];/**< Input buffer. */
+	unsigned int	head;                   /**< First unused byte. */
+	unsigned int	tail;                   /**< End of data. */
+	char**		names;                  /**< Known names by ID. */
+	uint32_t	names_size;             /**< Size of names. */
+} lirc_event_ctx;
+
 /**
  * Initial setup: connect to lircd socket.
  *
@@ -344,6 +447,136 @@ int lirc_command_init(lirc_cmd_ctx* ctx, const char* fmt, ...);
  */
 int lirc_command_run(lirc_cmd_ctx* ctx, int fd);
 
+/**
+ * Set up pipelining commands on a lircd connection. The commands are
+ * run by lircd in order, but a caller may have several of them
+ * outstanding and never blocks waiting for a reply:
+ *
+ * - lirc_command_submit() queues commands set up by lirc_command_init().
+ * - lirc_command_flush() writes queued commands when the socket is
+ *   writable, lirc_command_reply() reads and parses replies when it is
+ *   readable. lirc_command_events() tells which of these to wait for.
+ * - Each reply is matched to its command by the command echo in the
+ *   reply, and the command is handed back by lirc_command_reply().
+ *
+ * @param ctx Undefined on enter, initiated on exit.
+ * @param fd Open, non-blocking file connected to a lircd socket as
+ *     returned by lirc_get_local_socket() or lirc_get_remote_socket().
+ * @since 0.9.3
+ */
+void lirc_command_pipe(lirc_cmd_pipe* ctx, int fd);
+
+/**
+ * Queue a command initiated by lirc_command_init(). Nothing is written
+ * until lirc_command_flush(). The command must stay valid until it is
+ * returned by lirc_command_reply(). The reply_to_stdout flag is ignored,
+ * a reply payload is always stored in cmd->reply, several data lines
+ * separated by '\n'.
+ *
+ * @return 0 on OK, EAGAIN if LIRC_PIPE_SIZE commands are queued.
+ * @since 0.9.3
+ */
+int lirc_command_submit(lirc_cmd_pipe* ctx, lirc_cmd_ctx* cmd);
+
+/**
+ * Write as much as possible of the queued commands without blocking,
+ * using a single system call.
+ *
+ * @return 0 on OK, also if the socket is full, else a kernel error code.
+ * @since 0.9.3
+ */
+int lirc_command_flush(lirc_cmd_pipe* ctx);
+
+/**
+ * Get the next completed command. Buffered replies are parsed before
+ * the socket is read, and it is read at most once per call. Button
+ * events and broadcasts such as SIGHUP on the connection are skipped.
+ *
+ * @param ctx Connection with commands submitted.
+ * @param cmd Undefined on enter, the completed command if 1 is
+ *     returned. It is no longer queued.
+ * @param status Undefined on enter, if 1 is returned 0 if lircd
+ *     reported success, else a kernel error code (EIO if the command
+ *     failed).
+ * @return 1 if a command completed, 0 if none is completed yet, -1 on
+ *     errors (errno set; EPROTO for a bad reply, ECONNRESET when lircd
+ *     closed the connection).
+ * @since 0.9.3
+ */
+int lirc_command_reply(lirc_cmd_pipe* ctx, lirc_cmd_ctx** cmd, int* status);
+
+/**
+ * Events to wait for in poll(2) and friends: POLLOUT while there are
+ * commands to write, POLLIN while there are replies to read.
+ * @since 0.9.3
+ */
+int lirc_command_events(const lirc_cmd_pipe* ctx);
+
+/**
+ * Switch a lircd connection to the binary event protocol, waiting for
+ * lircd's reply. Button events are then delivered as fixed size frames
+ * with interned names, avoiding to format and parse text per event.
+ *
+ * @param ctx Undefined on enter, initiated on successful exit.
+ * @param fd Open file connected to a lircd output socket, e. g. as
+ *     returned by lirc_init() or lirc_get_local_socket().
+ * @return 0 on OK, else a kernel error code (EPROTO if lircd does not
+ *     support the protocol).
+ * @since 0.9.3
+ */
+int lirc_event_start(lirc_event_ctx* ctx, int fd);
+
+/**
+ * Get next button event from a connection set up by lirc_event_start().
+ * Reads from the socket once if there is no complete event buffered,
+ * blocking if the socket is blocking. Text frames, such as command
+ * replies, are skipped.
+ *
+ * @param ctx Initiated connection state.
+ * @param event Undefined on enter, the event if 1 is returned. The
+ *     names are valid until lirc_event_free().
+ * @return 1 if an event is returned, 0 if none is available yet,
+ *     -1 on errors (errno set; ECONNRESET when lircd closed the
+ *     connection).
+ * @since 0.9.3
+ */
+int lirc_event_read(lirc_event_ctx* ctx, struct lirc_event* event);
+
+/**
+ * Release memory used by a lirc_event_ctx. Does not close ctx->fd.
+ * @since 0.9.3
+ */
+void lirc_event_free(lirc_event_ctx* ctx);
+
+/**
+ * Set up reading events from a lircd connection in the text protocol.
+ * Unlike lirc_nextcode(), lirc_code_read() uses no dynamic memory.
+ *
+ * @param ctx Undefined on enter, initiated on exit.
+ * @param fd Open file connected to a lircd output socket, e. g. as
+ *     returned by lirc_init() or lirc_get_local_socket().
+ * @since 0.9.3
+ */
+void lirc_code_start(lirc_code_ctx* ctx, int fd);
+
+/**
+ * Get next button event from a connection set up by lirc_code_start().
+ * All buffered events are returned before the socket is read again.
+ * When they are used up, 0 is returned once without reading, so
+ * looping while 1 is returned after poll() never blocks. Otherwise the
+ * socket is read at most once per call, blocking if the socket is
+ * blocking. Command replies and broadcasts such as SIGHUP are skipped.
+ *
+ * @param ctx Initiated connection state.
+ * @param event Undefined on enter, the event if 1 is returned. It
+ *     points into ctx and is valid until the next call.
+ * @return 1 if an event is returned, 0 if none is available yet,
+ *     -1 on errors (errno set; ECONNRESET when lircd closed the
+ *     connection).
+ * @since 0.9.3
+ */
+int lirc_code_read(lirc_code_ctx* ctx, struct lirc_code_event* event);
+
 /**
  * Set command_ctx write_to_stdout flag. When set, the reply payload is
  * written to stdout instead of the default behavior to store it in
@@ -48,6 +48,39 @@ static int nodaemon = 0;
 
 static const int PRIO_LEN = 16; /**< Longest priority label, some margin. */
 
+/** Number of records in the async log ring, a power of two. */
+#define LOG_RING_SIZE 256
+
+/** Max length of a message in async mode, longer ones are truncated. */
+#define LOG_RECORD_LEN 256
+
+/**
+ * A queued message. seq is the ring position the record is free for;
+ * a producer sets it to position + 1 when the record is filled, and
+ * the consumer to position + LOG_RING_SIZE when it has been written.
+ */
+struct log_record {
+	unsigned	seq;
+	loglevel_t	prio;
+	time_t		when;
+	char		text[LOG_RECORD_LEN];
+};
+
+/** The async log ring, NULL in synchronous mode. */
+static struct log_record* log_ring = NULL;
+
+/** Next position to fill, advanced by producers. */
+static unsigned log_head = 0;
+
+/** Next position to write, only used by lirc_log_drain(). */
+static unsigned log_tail = 0;
+
+/** Messages lost since last drain because the ring was full. */
+static unsigned log_dropped = 0;
+
+/** The process which drains the ring, forked children log directly. */
+static pid_t log_owner = 0;
+
 
 static const char* prio2text(int prio)
 {
@@ -118,6 +151,7 @@ int lirc_log_open(const char* _progname, int _nodaemon, loglevel_t level)
 
 int lirc_log_close(void)
 {
+	lirc_log_set_async(0);
 	if (use_syslog) {
 		closelog();
 		return 0;
@@ -138,6 +172,7 @@ int lirc_log_reopen(void)
 		return 0;
 
 	logprintf(LIRC_INFO, "closing logfile");
+	lirc_log_drain();
 	if (-1 == fstat(fileno(lf), &s)) {
 		perror("Invalid logfile!");
 		return -1;
@@ -233,8 +268,131 @@ loglevel_t string2loglevel(const char* s)
 }
 
 
+/** Write a message to syslog or the logfile, without flushing. */
+static void log_emit(loglevel_t prio, time_t when, const char* format_str, va_list ap)
+{
+	char buff[PRIO_LEN + strlen(format_str)];
+
+	if (use_syslog) {
+		snprintf(buff, sizeof(buff),
+			 "%s: %s", prio2text(prio), format_str);
+		vsyslog(prio, buff, ap);
+	} else if (lf && prio <= loglevel) {
+		char* currents;
+
+		currents = ctime(&when);
+
+		fprintf(lf, "%15.15s %s %s: ",
+			currents + 4, hostname, progname);
+		fprintf(lf, "%s: ", prio2text(prio));
+		vfprintf(lf, format_str, ap);
+		fputc('\n', lf);
+	}
+}
+
+
+static void log_emit_text(loglevel_t prio, time_t when, const char* format_str, ...)
+{
+	va_list ap;
+
+	va_start(ap, format_str);
+	log_emit(prio, when, format_str, ap);
+	va_end(ap);
+}
+
+
+/**
+ * Format a message into a free record of the ring. Several producers
+ * (threads, signal handlers) may race for records, each claims its own
+ * position with a CAS on log_head.
+ *
+ * @return 0 if the ring was full, else 1.
+ */
+static int log_queue(loglevel_t prio, const char* format_str, va_list ap)
+{
+	struct log_record* record;
+	unsigned pos = __atomic_load_n(&log_head, __ATOMIC_RELAXED);
+
+	while (1) {
+		int diff;
+
+		record = &log_ring[pos & (LOG_RING_SIZE - 1)];
+		diff = (int)(__atomic_load_n(&record->seq, __ATOMIC_ACQUIRE) - pos);
+		if (diff < 0) {
+			__atomic_fetch_add(&log_dropped, 1, __ATOMIC_RELAXED);
+			return 0;
+		}
+		if (diff == 0
+		    && __atomic_compare_exchange_n(&log_head, &pos, pos + 1, 1,
+						   __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			break;
+		if (diff > 0)
+			pos = __atomic_load_n(&log_head, __ATOMIC_RELAXED);
+	}
+	record->prio = prio;
+	record->when = time(NULL);
+	vsnprintf(record->text, sizeof(record->text), format_str, ap);
+	__atomic_store_n(&record->seq, pos + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+
+void lirc_log_drain(void)
+{
+	struct log_record* record;
+	unsigned dropped;
+	int count = 0;
+
+	if (log_ring == NULL || getpid() != log_owner)
+		return;
+	while (1) {
+		record = &log_ring[log_tail & (LOG_RING_SIZE - 1)];
+		if (__atomic_load_n(&record->seq, __ATOMIC_ACQUIRE) != log_tail + 1)
+			break;
+		log_emit_text(record->prio, record->when, "%s", record->text);
+		__atomic_store_n(&record->seq, log_tail + LOG_RING_SIZE,
+				 __ATOMIC_RELEASE);
+		log_tail++;
+		count++;
+	}
+	dropped = __atomic_exchange_n(&log_dropped, 0, __ATOMIC_RELAXED);
+	if (dropped > 0) {
+		log_emit_text(LIRC_WARNING, time(NULL),
+			      "%u log messages dropped", dropped);
+		count++;
+	}
+	if (count > 0 && !use_syslog && lf)
+		fflush(lf);
+}
+
+
+int lirc_log_set_async(int enable)
+{
+	unsigned i;
+
+	if (!enable) {
+		lirc_log_drain();
+		free(log_ring);
+		log_ring = NULL;
+		return 1;
+	}
+	if (log_ring != NULL)
+		return 1;
+	log_ring = malloc(LOG_RING_SIZE * sizeof(struct log_record));
+	if (log_ring == NULL)
+		return 0;
+	for (i = 0; i < LOG_RING_SIZE; i++)
+		log_ring[i].seq = i;
+	log_head = log_tail = 0;
+	log_dropped = 0;
+	log_owner = getpid();
+	return 1;
+}
+
+
 /**
- * Prints the log request to the log, if the priority fits.
+ * Prints the log request to the log, if the priority fits. In async
+ * mode the message is queued, and written by lirc_log_drain().
  * @param prio Priority of log request
  * @param format_str Format string in the usual C sense.
  * @param ... Additional vararg parameters.
@@ -243,7 +401,6 @@ void logprintf(loglevel_t prio, const char* format_str, ...)
 {
 	int save_errno = errno;
 	va_list ap;
-	char buff[PRIO_LEN + strlen(format_str)];
 
 #ifdef SYSTEMD_LOGPERROR_FIX
 	if (nodaemon && prio <= loglevel) {
@@ -255,28 +412,19 @@ void logprintf(loglevel_t prio, const char* format_str, ...)
 		fflush(stderr);
 	}
 #endif
-	if (use_syslog) {
-		snprintf(buff, sizeof(buff),
-			 "%s: %s", prio2text(prio), format_str);
-		va_start(ap, format_str);
-		vsyslog(prio, buff, ap);
-		va_end(ap);
-	} else if (lf && prio <= loglevel) {
-		time_t current;
-		char* currents;
-
-		current = time(&current);
-		currents = ctime(&current);
-
-		fprintf(lf, "%15.15s %s %s: ",
-			currents + 4, hostname, progname);
-		fprintf(lf, "%s: ", prio2text(prio));
-		va_start(ap, format_str);
-		vfprintf(lf, format_str, ap);
-		va_end(ap);
-		fputc('\n', lf);
-		fflush(lf);
+	if (!use_syslog && (lf == NULL || prio > loglevel)) {
+		errno = save_errno;
+		return;
+	}
+	va_start(ap, format_str);
+	if (log_ring != NULL && getpid() == log_owner) {
+		log_queue(prio, format_str, ap);
+	} else {
+		log_emit(prio, time(NULL), format_str, ap);
+		if (!use_syslog)
+			fflush(lf);
 	}
+	va_end(ap);
 	errno = save_errno;
 }
 
@@ -293,7 +441,7 @@ void logperror(loglevel_t prio, const char* fmt, ...)
 	va_start(ap, fmt);
 	vsnprintf(s, sizeof(s), fmt, ap);
 	va_end(ap);
-	if (use_syslog) {
+	if (use_syslog && log_ring == NULL) {
 		if ((s) != NULL)
 			syslog(prio, "%s: %m\n", s);
 		else
@@ -130,6 +130,25 @@ int lirc_log_open(const char* progname, int _nodaemon, loglevel_t level);
 /** Close the log previosly opened with lirc_log_open(). */
 int lirc_log_close(void);
 
+/**
+ * Enable or disable asynchronous logging. When enabled, logprintf()
+ * only formats the message into a preallocated ring, and the messages
+ * are written to syslog or the logfile by lirc_log_drain(). If the ring
+ * is full, messages are dropped and counted. Only the calling process
+ * queues messages, children forked later log synchronously. Disabling
+ * writes all queued messages.
+ *
+ * @param enable If true, enable else disable async mode.
+ * @return 1 if OK, 0 if out of memory.
+ */
+int lirc_log_set_async(int enable);
+
+/**
+ * Write all messages queued in async mode, and a warning if some were
+ * dropped. Call this when idle. No-op in synchronous mode.
+ */
+void lirc_log_drain(void);
+
 /**
  * Set logfile. Either a regular path or the string 'syslog'; the latter
  * does indeed use syslog(1) instead. Must be called before lirc_log_open().
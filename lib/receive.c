@@ -20,6 +20,8 @@
 
 #include <limits.h>
 #include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
 
 #include "include/media/lirc.h"
 #include "lirc/driver.h"
@@ -27,15 +29,23 @@
 #include "lirc/receive.h"
 #include "lirc/ir_remote.h"
 
+/** Default capacity of the receive buffer, a power of two. */
 #define RBUF_SIZE 512
 
 #define REC_SYNC 8
 
+/** Max number of items read at once using the driver's readdata_batch(). */
+#define RBUF_BATCH 64
+
 /**
- * Structure for the receiving buffer.
+ * Structure for the receiving buffer. The data is a ring of size
+ * items where the current signal starts at index start; rptr and wptr
+ * are relative to start. Use RBUF() to access an item.
  */
 struct rbuf {
-	lirc_t		data[RBUF_SIZE];
+	lirc_t*		data;
+	unsigned int	size;   /**< Capacity, a power of two */
+	unsigned int	start;  /**< Ring index of first item */
 	ir_code		decoded;
 	int		rptr;
 	int		wptr;
@@ -53,9 +63,49 @@ struct rbuf {
 /**
  * Global receiver buffer.
  */
-static struct rbuf rec_buffer;
+static lirc_t rbuf_default[RBUF_SIZE];
+static struct rbuf rec_buffer = { rbuf_default, RBUF_SIZE };
 static int update_mode = 0;
 
+/** Items got from readdata_batch() but not yet used, see readdata(). */
+static struct {
+	lirc_t	data[RBUF_BATCH];
+	int	n;
+	int	next;
+} batch;
+
+/**
+ * Remotes with the same decoder parameters, see same_decoder(), decode a
+ * signal to the same pre/code/post; only get_code() tells them apart.
+ * decode_all() tries all remotes on the same signal, so receive_decode()
+ * keeps the outcome of the last attempt and lets the next remote of the
+ * same kind reuse it instead of reading the signal again.
+ */
+static struct {
+	int			valid;
+	struct ir_remote	params;         /**< Copy of decoded remote. */
+	unsigned int		generation;     /**< signal_generation when decoded. */
+	int			wptr;           /**< rec_buffer.wptr afterwards. */
+	const struct ir_remote* last_remote;    /**< Only compared, never used. */
+	int			result;
+	struct decode_ctx_t	ctx;
+	lirc_t			sync;           /**< Gap before signal, 0 if none. */
+	int			rptr;
+	int			too_long;
+	lirc_t			pendingp;
+	lirc_t			pendings;
+	lirc_t			sum;
+} last_decode;
+
+/** Bumped whenever the contents of rec_buffer change other than appending. */
+static unsigned int signal_generation;
+
+/** Gap before signal as seen by the last sync_rec_buffer(). */
+static lirc_t decode_sync;
+
+/** Item i of the current signal, i relative to rec_buffer.start. */
+#define RBUF(i) (rec_buffer.data[(rec_buffer.start + (i)) & (rec_buffer.size - 1)])
+
 
 void rec_set_update_mode(int mode)
 {
@@ -67,7 +117,15 @@ static lirc_t readdata(lirc_t timeout)
 {
 	lirc_t data;
 
-	data = curr_driver->readdata(timeout);
+	if (batch.next < batch.n) {
+		data = batch.data[batch.next++];
+	} else if (curr_driver->api_version >= 3 && curr_driver->readdata_batch != NULL) {
+		batch.n = curr_driver->readdata_batch(batch.data, RBUF_BATCH, timeout);
+		batch.next = 0;
+		data = batch.n > 0 ? batch.data[batch.next++] : 0;
+	} else {
+		data = curr_driver->readdata(timeout);
+	}
 	rec_buffer.at_eof = data & LIRC_EOF ? 1 : 0;
 	if (rec_buffer.at_eof)
 		logprintf(LIRC_DEBUG, "receive: Got EOF");
@@ -104,12 +162,12 @@ static void log_input(lirc_t data)
 static lirc_t get_next_rec_buffer_internal(lirc_t maxusec)
 {
 	if (rec_buffer.rptr < rec_buffer.wptr) {
-		LOGPRINTF(3, "<%c%lu", rec_buffer.data[rec_buffer.rptr] & PULSE_BIT ? 'p' : 's', (__u32)
-			  rec_buffer.data[rec_buffer.rptr] & (PULSE_MASK));
-		rec_buffer.sum += rec_buffer.data[rec_buffer.rptr] & (PULSE_MASK);
-		return rec_buffer.data[rec_buffer.rptr++];
+		LOGPRINTF(3, "<%c%lu", RBUF(rec_buffer.rptr) & PULSE_BIT ? 'p' : 's', (__u32)
+			  RBUF(rec_buffer.rptr) & (PULSE_MASK));
+		rec_buffer.sum += RBUF(rec_buffer.rptr) & (PULSE_MASK);
+		return RBUF(rec_buffer.rptr++);
 	}
-	if (rec_buffer.wptr < RBUF_SIZE) {
+	if (rec_buffer.wptr < (int)rec_buffer.size) {
 		lirc_t data = 0;
 		unsigned long elapsed = 0;
 
@@ -136,19 +194,16 @@ static lirc_t get_next_rec_buffer_internal(lirc_t maxusec)
 			return 0;
 		}
 
-		rec_buffer.data[rec_buffer.wptr] = data;
+		RBUF(rec_buffer.wptr) = data;
 		if (rec_buffer.input_log != NULL)
 			log_input(data);
-		if (rec_buffer.data[rec_buffer.wptr] == 0)
+		if (data == 0)
 			return 0;
-		rec_buffer.sum += rec_buffer.data[rec_buffer.rptr]
-				  & (PULSE_MASK);
+		rec_buffer.sum += data & (PULSE_MASK);
 		rec_buffer.wptr++;
 		rec_buffer.rptr++;
-		LOGPRINTF(3, "+%c%lu", rec_buffer.data[rec_buffer.rptr - 1] & PULSE_BIT ? 'p' : 's', (__u32)
-			  rec_buffer.data[rec_buffer.rptr - 1]
-			  & (PULSE_MASK));
-		return rec_buffer.data[rec_buffer.rptr - 1];
+		LOGPRINTF(3, "+%c%lu", data & PULSE_BIT ? 'p' : 's', (__u32)data & (PULSE_MASK));
+		return data;
 	}
 	rec_buffer.too_long = 1;
 	return 0;
@@ -156,34 +211,26 @@ static lirc_t get_next_rec_buffer_internal(lirc_t maxusec)
 
 int waitfordata(__u32 maxusec)
 {
-	fd_set fds;
+	struct pollfd pfd;
 	int ret;
-	struct timeval tv;
 
+	if (batch.next < batch.n)
+		return 1;
+	/* poll() works for any fd, FD_SET() is limited to FD_SETSIZE */
+	pfd.fd = curr_driver->fd;
+	pfd.events = POLLIN;
 	while (1) {
-		FD_ZERO(&fds);
-		FD_SET(curr_driver->fd, &fds);
-		do {
-			do {
-				if (maxusec > 0) {
-					tv.tv_sec = maxusec / 1000000;
-					tv.tv_usec = maxusec % 1000000;
-					ret = select(curr_driver->fd + 1, &fds, NULL, NULL, &tv);
-					if (ret == 0)
-						return 0;
-				} else {
-					ret = select(curr_driver->fd + 1, &fds, NULL, NULL, NULL);
-				}
-			} while (ret == -1 && errno == EINTR);
-			if (ret == -1) {
-				logperror(LIRC_ERROR, "select() failed");
-				continue;
-			}
-		} while (ret == -1);
-
-		if (FD_ISSET(curr_driver->fd, &fds))
-			/* we will read later */
-			return 1;
+		pfd.revents = 0;
+		ret = poll(&pfd, 1, maxusec > 0 ? (int)((maxusec + 999) / 1000) : -1);
+		if (ret == 0)
+			return 0;
+		if (ret == -1) {
+			if (errno != EINTR)
+				logperror(LIRC_ERROR, "poll() failed");
+			continue;
+		}
+		/* readable, hangup or error: we will read later */
+		return 1;
 	}
 }
 
@@ -203,7 +250,47 @@ static lirc_t get_next_rec_buffer(lirc_t maxusec)
 
 void rec_buffer_init(void)
 {
+	lirc_t* data = rec_buffer.data;
+	unsigned int size = rec_buffer.size;
+
 	memset(&rec_buffer, 0, sizeof(rec_buffer));
+	rec_buffer.data = data;
+	rec_buffer.size = size;
+	signal_generation++;
+	batch.n = 0;
+	batch.next = 0;
+}
+
+int rec_buffer_pending(void)
+{
+	return batch.next < batch.n;
+}
+
+int rec_buffer_set_size(unsigned int size)
+{
+	lirc_t* data;
+	unsigned int n;
+
+	for (n = RBUF_SIZE; n < size; n *= 2)
+		if (n > INT_MAX / 2 / sizeof(lirc_t))
+			return 0;
+	if (n == rec_buffer.size)
+		return 1;
+	if (n == RBUF_SIZE) {
+		data = rbuf_default;
+	} else {
+		data = (lirc_t*)malloc(n * sizeof(lirc_t));
+		if (data == NULL) {
+			logprintf(LIRC_ERROR, "Out of memory for receive buffer");
+			return 0;
+		}
+	}
+	if (rec_buffer.data != rbuf_default)
+		free(rec_buffer.data);
+	rec_buffer.data = data;
+	rec_buffer.size = n;
+	rec_buffer_init();
+	return 1;
 }
 
 void rec_buffer_rewind(void)
@@ -219,6 +306,35 @@ void rec_buffer_rewind(void)
 void rec_buffer_reset_wptr(void)
 {
 	rec_buffer.wptr = 0;
+	signal_generation++;
+}
+
+int rec_buffer_peek(lirc_t* data, int count, lirc_t maxusec)
+{
+	int rptr = rec_buffer.rptr;
+	int too_long = rec_buffer.too_long;
+	lirc_t sum = rec_buffer.sum;
+	int n;
+
+	if (rec_buffer.at_eof)
+		return 0;
+	rec_buffer.rptr = 0;
+	for (n = 0; n < count; n++) {
+		data[n] = get_next_rec_buffer(maxusec);
+		if (data[n] == 0 || data[n] & LIRC_EOF)
+			break;
+	}
+	rec_buffer.rptr = rptr;
+	rec_buffer.too_long = too_long;
+	rec_buffer.sum = sum;
+	rec_buffer.at_eof = 0;
+	return n;
+}
+
+void rec_buffer_skip(int count)
+{
+	rec_buffer_rewind();
+	rec_buffer.rptr = count < rec_buffer.wptr ? count : rec_buffer.wptr;
 }
 
 int rec_buffer_clear(void)
@@ -245,22 +361,24 @@ int rec_buffer_clear(void)
 
 		move = rec_buffer.wptr - rec_buffer.rptr;
 		if (move > 0 && rec_buffer.rptr > 0) {
-			memmove(&rec_buffer.data[0], &rec_buffer.data[rec_buffer.rptr],
-				sizeof(rec_buffer.data[0]) * move);
-			rec_buffer.wptr -= rec_buffer.rptr;
+			/* keep the unread items, no need to move them */
+			rec_buffer.start += rec_buffer.rptr;
+			rec_buffer.wptr = move;
 		} else {
+			rec_buffer.start = 0;
 			rec_buffer.wptr = 0;
 			data = readdata(0);
 
 			LOGPRINTF(3, "c%lu", (__u32)data & (PULSE_MASK));
 
-			rec_buffer.data[rec_buffer.wptr] = data;
+			RBUF(rec_buffer.wptr) = data;
 			rec_buffer.wptr++;
 		}
 	}
 
 	rec_buffer_rewind();
 	rec_buffer.is_biphase = 0;
+	signal_generation++;
 
 	return 1;
 }
@@ -270,10 +388,9 @@ static void unget_rec_buffer(int count)
 	LOGPRINTF(5, "unget: %d", count);
 	if (count == 1 || count == 2) {
 		rec_buffer.rptr -= count;
-		rec_buffer.sum -= rec_buffer.data[rec_buffer.rptr] & (PULSE_MASK);
+		rec_buffer.sum -= RBUF(rec_buffer.rptr) & (PULSE_MASK);
 		if (count == 2)
-			rec_buffer.sum -= rec_buffer.data[rec_buffer.rptr + 1]
-					  & (PULSE_MASK);
+			rec_buffer.sum -= RBUF(rec_buffer.rptr + 1) & (PULSE_MASK);
 	}
 }
 
@@ -281,7 +398,8 @@ static void unget_rec_buffer_delta(lirc_t delta)
 {
 	rec_buffer.rptr--;
 	rec_buffer.sum -= delta & (PULSE_MASK);
-	rec_buffer.data[rec_buffer.rptr] = delta;
+	RBUF(rec_buffer.rptr) = delta;
+	signal_generation++;
 }
 
 static lirc_t get_next_pulse(lirc_t maxusec)
@@ -515,6 +633,7 @@ static lirc_t sync_rec_buffer(struct ir_remote* remote)
 		}
 	}
 	rec_buffer.sum = 0;
+	decode_sync = deltas;
 	return deltas;
 }
 
@@ -650,14 +769,62 @@ static int get_repeat(struct ir_remote* remote)
 	return 1;
 }
 
+static inline int in_window(const struct ir_window* w, lirc_t delta)
+{
+	return delta >= w->min && delta <= w->max;
+}
+
+/**
+ * Decode one bit for BIT_KERNEL_PULSE_SPACE, like expectone() followed
+ * by expectzero() but reading each duration just once. On errors the
+ * receive buffer is left as these would leave it, rec_buffer_clear()
+ * depends on it.
+ * @return 1 or 0 for the bit decoded, -1 on errors.
+ */
+static int get_pulse_space_bit(struct ir_remote* remote, const struct ir_bit_kernel* k)
+{
+	lirc_t deltap, deltas;
+
+	deltap = get_next_pulse(remote->pone);
+	if (deltap == 0) {
+		/* Consumed or not, the failed read is ungot. */
+		unget_rec_buffer(1);
+		return -1;
+	}
+	if (in_window(&k->pone, deltap)) {
+		deltas = get_next_space(remote->sone);
+	} else {
+		if (!in_window(&k->pzero, deltap)) {
+			unget_rec_buffer(1);
+			return -1;
+		}
+		deltas = get_next_space(remote->szero);
+	}
+	if (deltas == 0) {
+		unget_rec_buffer(2);
+		return -1;
+	}
+	if (in_window(&k->pone, deltap) && in_window(&k->sone, deltas))
+		return 1;
+	if (in_window(&k->pzero, deltap) && in_window(&k->szero, deltas))
+		return 0;
+	unget_rec_buffer(2);
+	return -1;
+}
+
 static ir_code get_data(struct ir_remote* remote, int bits, int done)
 {
+	const struct ir_bit_kernel* k;
 	ir_code code;
 	int i;
 
 	code = 0;
 
-	if (is_rcmm(remote)) {
+	if (!bit_kernel_is_current(remote))
+		set_bit_kernel(remote);
+	k = &remote->bit_kernel;
+
+	if (k->type == BIT_KERNEL_RCMM) {
 		lirc_t deltap, deltas, sum;
 
 		if (bits % 2 || done % 2) {
@@ -676,16 +843,16 @@ static ir_code get_data(struct ir_remote* remote, int bits, int done)
 			}
 			sum = deltap + deltas;
 			LOGPRINTF(3, "rcmm: sum %ld", (__u32)sum);
-			if (expect(remote, sum, remote->pzero + remote->szero)) {
+			if (in_window(&k->sum[0], sum)) {
 				code |= 0;
 				LOGPRINTF(2, "00");
-			} else if (expect(remote, sum, remote->pone + remote->sone)) {
+			} else if (in_window(&k->sum[1], sum)) {
 				code |= 1;
 				LOGPRINTF(2, "01");
-			} else if (expect(remote, sum, remote->ptwo + remote->stwo)) {
+			} else if (in_window(&k->sum[2], sum)) {
 				code |= 2;
 				LOGPRINTF(2, "10");
-			} else if (expect(remote, sum, remote->pthree + remote->sthree)) {
+			} else if (in_window(&k->sum[3], sum)) {
 				code |= 3;
 				LOGPRINTF(2, "11");
 			} else {
@@ -955,6 +1122,26 @@ static ir_code get_data(struct ir_remote* remote, int bits, int done)
 		return code;
 	}
 
+	if (k->type == BIT_KERNEL_PULSE_SPACE) {
+		for (i = 0; i < bits; i++) {
+			int bit;
+
+			code = code << 1;
+			if (rec_buffer.pendingp > 0 || rec_buffer.pendings > 0)
+				/* Header or pre_s left pending. */
+				bit = expectone(remote, done + i) ? 1 :
+				      expectzero(remote, done + i) ? 0 : -1;
+			else
+				bit = get_pulse_space_bit(remote, k);
+			if (bit < 0) {
+				LOGPRINTF(1, "failed on bit %d", done + i + 1);
+				return (ir_code) -1;
+			}
+			LOGPRINTF(2, "%d", bit);
+			code |= bit;
+		}
+		return code;
+	}
 	for (i = 0; i < bits; i++) {
 		code = code << 1;
 		if (is_goldstar(remote)) {
@@ -1038,7 +1225,236 @@ static ir_code get_post(struct ir_remote* remote)
 	return post;
 }
 
-int receive_decode(struct ir_remote* remote, struct decode_ctx_t* ctx)
+/** Compute ctx->repeat_flag from the gap before the signal. */
+static void set_repeat_flag(struct ir_remote* remote, lirc_t sync, struct decode_ctx_t* ctx)
+{
+	if ((!has_repeat(remote) || remote->reps < remote->min_code_repeat)
+	    && expect_at_most(remote, sync, remote->max_remaining_gap))
+		ctx->repeat_flag = 1;
+	else
+		ctx->repeat_flag = 0;
+}
+
+/**
+ * Can the outcome of decoding remote be shared with other remotes?
+ * Not if decoding depends on more than the remote's parameters and the
+ * signal, or might change either of them.
+ */
+static int is_shareable(const struct ir_remote* remote)
+{
+	if (curr_driver->rec_mode != LIRC_MODE_MODE2
+	    && curr_driver->rec_mode != LIRC_MODE_PULSE
+	    && curr_driver->rec_mode != LIRC_MODE_RAW)
+		return 0;
+	if (update_mode || is_raw(remote) || is_rcmm(remote) || is_goldstar(remote)
+	    || is_biphase(remote) || is_serial(remote))
+		return 0;
+	return !(has_repeat(remote) && last_remote == remote);
+}
+
+/** Do r1 and r2 decode a given signal in the same way? */
+static int same_decoder(const struct ir_remote* r1, const struct ir_remote* r2)
+{
+	return r1->flags == r2->flags
+	       && r1->bits == r2->bits
+	       && r1->eps == r2->eps
+	       && r1->aeps == r2->aeps
+	       && memcmp(&r1->phead, &r2->phead,
+			 (char*)&r1->srepeat - (char*)&r1->phead + sizeof(lirc_t)) == 0
+	       && r1->pre_data_bits == r2->pre_data_bits
+	       && r1->post_data_bits == r2->post_data_bits
+	       && r1->pre_p == r2->pre_p && r1->pre_s == r2->pre_s
+	       && r1->post_p == r2->post_p && r1->post_s == r2->post_s
+	       && r1->gap == r2->gap && r1->gap2 == r2->gap2
+	       && r1->repeat_gap == r2->repeat_gap
+	       && r1->rc6_mask == r2->rc6_mask
+	       && has_toggle_mask(r1) == has_toggle_mask(r2);
+}
+
+/** Reuse the last outcome for remote if possible, else return -1. */
+static int reuse_decode(struct ir_remote* remote, struct decode_ctx_t* ctx)
+{
+	if (!last_decode.valid
+	    || last_decode.generation != signal_generation
+	    || last_decode.wptr != rec_buffer.wptr
+	    || last_decode.last_remote != last_remote
+	    || !is_shareable(remote)
+	    || !same_decoder(&last_decode.params, remote))
+		return -1;
+	LOGPRINTF(1, "reusing decoder result of \"%s\"", last_decode.params.name);
+	rec_buffer.rptr = last_decode.rptr;
+	rec_buffer.too_long = last_decode.too_long;
+	rec_buffer.pendingp = last_decode.pendingp;
+	rec_buffer.pendings = last_decode.pendings;
+	rec_buffer.sum = last_decode.sum;
+	rec_buffer.at_eof = 0;
+	rec_buffer.is_biphase = 0;
+	/* as in sync_rec_buffer() */
+	if (last_decode.sync != 0 && last_remote != NULL && has_toggle_mask(remote)
+	    && !expect_at_most(last_remote, last_decode.sync, last_remote->max_remaining_gap)) {
+		remote->toggle_mask_state = 0;
+		remote->toggle_code = NULL;
+	}
+	if (!last_decode.result)
+		return 0;
+	*ctx = last_decode.ctx;
+	set_repeat_flag(remote, last_decode.sync, ctx);
+	return 1;
+}
+
+static void save_decode(struct ir_remote* remote, const struct decode_ctx_t* ctx, int result)
+{
+	last_decode.valid = is_shareable(remote);
+	if (!last_decode.valid)
+		return;
+	memcpy(&last_decode.params, remote, sizeof(*remote));
+	last_decode.generation = signal_generation;
+	last_decode.wptr = rec_buffer.wptr;
+	last_decode.last_remote = last_remote;
+	last_decode.result = result;
+	last_decode.ctx = *ctx;
+	last_decode.sync = decode_sync;
+	last_decode.rptr = rec_buffer.rptr;
+	last_decode.too_long = rec_buffer.too_long;
+	last_decode.pendingp = rec_buffer.pendingp;
+	last_decode.pendings = rec_buffer.pendings;
+	last_decode.sum = rec_buffer.sum;
+}
+
+/** Try the raw codes of remote in turn, return the first matching. */
+static struct ir_ncode* find_raw_code(struct ir_remote* remote)
+{
+	struct ir_ncode* codes;
+	struct ir_ncode* found;
+	int i;
+
+	codes = remote->codes;
+	found = NULL;
+	while (codes->name != NULL && found == NULL) {
+		found = codes;
+		for (i = 0; i < codes->length; ) {
+			if (!expectpulse(remote, codes->signals[i++])) {
+				found = NULL;
+				rec_buffer_rewind();
+				sync_rec_buffer(remote);
+				break;
+			}
+			if (i < codes->length && !expectspace(remote, codes->signals[i++])) {
+				found = NULL;
+				rec_buffer_rewind();
+				sync_rec_buffer(remote);
+				break;
+			}
+		}
+		codes++;
+		if (found != NULL) {
+			if (!get_gap
+				    (remote, is_const(remote) ?
+				    min_gap(remote) - rec_buffer.sum :
+				    min_gap(remote)))
+				found = NULL;
+		}
+	}
+	return found;
+}
+
+
+#define RAW_ACTIVE_MAX 16
+
+/**
+ * Match the signal against all raw codes of remote at once, walking
+ * the trie from get_raw_index() one duration at a time. Leaves the
+ * receive buffer as find_raw_code() would.
+ * @return 0 if the trie cannot decide and find_raw_code() must be
+ *     used, else 1 with the code found (or NULL) in *found.
+ */
+static int find_raw_index(struct ir_remote* remote, struct ir_ncode** found)
+{
+	const struct ir_raw_node* nodes;
+	const struct ir_raw_node* active[2][RAW_ACTIVE_MAX];
+	int n_active, n_next, depth, i, j;
+	int rptr = 0;
+	lirc_t sum = 0;
+	lirc_t timeout, delta;
+
+	*found = NULL;
+	if (has_header(remote) || rec_buffer.pendingp > 0 || rec_buffer.pendings > 0)
+		return 0;
+	nodes = get_raw_index(remote);
+	if (nodes == NULL)
+		return 0;
+
+	active[0][0] = nodes;
+	n_active = 1;
+	for (depth = 0; ; depth++) {
+		const struct ir_raw_node** now = active[depth % 2];
+		const struct ir_raw_node** next = active[(depth + 1) % 2];
+
+		/* The first code matching in config file order wins. */
+		for (i = 0; i < n_active; i++) {
+			if (now[i]->code != NULL
+			    && (*found == NULL || now[i]->code < *found)) {
+				*found = now[i]->code;
+				rptr = rec_buffer.rptr;
+				sum = rec_buffer.sum;
+			}
+		}
+		timeout = 0;
+		for (i = j = 0; i < n_active; i++) {
+			if (now[i]->first == NULL || (*found != NULL && now[i]->first >= *found))
+				continue;
+			now[j++] = now[i];
+			/* The children are sorted, the last expects most. */
+			delta = nodes[now[i]->child + now[i]->n_children - 1].timeout;
+			if (delta > timeout)
+				timeout = delta;
+		}
+		n_active = j;
+		if (n_active == 0)
+			break;
+
+		delta = depth % 2 ? get_next_space(timeout) : get_next_pulse(timeout);
+		if (delta == 0)
+			break;
+		for (i = 0, n_next = 0; i < n_active; i++) {
+			const struct ir_raw_node* child = nodes + now[i]->child;
+
+			for (j = 0; j < now[i]->n_children; j++, child++) {
+				if (delta >= child->min && delta <= child->max) {
+					if (n_next == RAW_ACTIVE_MAX)
+						goto fallback;
+					next[n_next++] = child;
+				} else if (delta >= child->outer_min && delta <= child->outer_max) {
+					/* Only some codes of the child match. */
+					goto fallback;
+				}
+			}
+		}
+		n_active = n_next;
+	}
+
+	if (*found == NULL) {
+		rec_buffer_rewind();
+		sync_rec_buffer(remote);
+		return 1;
+	}
+	/* Codes before *found have failed, rewinding the buffer. */
+	if (*found != remote->codes)
+		rec_buffer_rewind();
+	rec_buffer.rptr = rptr;
+	rec_buffer.sum = sum;
+	if (get_gap(remote, is_const(remote) ? min_gap(remote) - rec_buffer.sum : min_gap(remote)))
+		return 1;
+fallback:
+	LOGPRINTF(1, "raw code index not usable");
+	*found = NULL;
+	rec_buffer_rewind();
+	sync_rec_buffer(remote);
+	return 0;
+}
+
+
+static int decode_signal(struct ir_remote* remote, struct decode_ctx_t* ctx)
 {
 	lirc_t sync;
 	int header;
@@ -1062,6 +1478,7 @@ int receive_decode(struct ir_remote* remote, struct decode_ctx_t* ctx)
 		rec_buffer.is_biphase = is_biphase(remote) ? 1 : 0;
 
 		/* we should get a long space first */
+		decode_sync = 0;
 		sync = sync_rec_buffer(remote);
 		if (!sync) {
 			LOGPRINTF(1, "failed on sync");
@@ -1119,40 +1536,13 @@ int receive_decode(struct ir_remote* remote, struct decode_ctx_t* ctx)
 	}
 
 	if (is_raw(remote)) {
-		struct ir_ncode* codes;
 		struct ir_ncode* found;
-		int i;
 
 		if (curr_driver->rec_mode == LIRC_MODE_LIRCCODE)
 			return 0;
 
-		codes = remote->codes;
-		found = NULL;
-		while (codes->name != NULL && found == NULL) {
-			found = codes;
-			for (i = 0; i < codes->length; ) {
-				if (!expectpulse(remote, codes->signals[i++])) {
-					found = NULL;
-					rec_buffer_rewind();
-					sync_rec_buffer(remote);
-					break;
-				}
-				if (i < codes->length && !expectspace(remote, codes->signals[i++])) {
-					found = NULL;
-					rec_buffer_rewind();
-					sync_rec_buffer(remote);
-					break;
-				}
-			}
-			codes++;
-			if (found != NULL) {
-				if (!get_gap
-					    (remote, is_const(remote) ?
-					    min_gap(remote) - rec_buffer.sum :
-					    min_gap(remote)))
-					found = NULL;
-			}
-		}
+		if (!find_raw_index(remote, &found))
+			found = find_raw_code(remote);
 		if (found == NULL)
 			return 0;
 		ctx->code = found->code;
@@ -1236,11 +1626,7 @@ int receive_decode(struct ir_remote* remote, struct decode_ctx_t* ctx)
 			}
 		}               /* end of mode specific code */
 	}
-	if ((!has_repeat(remote) || remote->reps < remote->min_code_repeat)
-	    && expect_at_most(remote, sync, remote->max_remaining_gap))
-		ctx->repeat_flag = 1;
-	else
-		ctx->repeat_flag = 0;
+	set_repeat_flag(remote, sync, ctx);
 	if (curr_driver->rec_mode == LIRC_MODE_LIRCCODE) {
 		/* Most TV cards don't pass each signal to the
 		 * driver. This heuristic should fix repeat in such
@@ -1257,3 +1643,20 @@ int receive_decode(struct ir_remote* remote, struct decode_ctx_t* ctx)
 	}
 	return 1;
 }
+
+
+int receive_decode(struct ir_remote* remote, struct decode_ctx_t* ctx)
+{
+	int result;
+
+	if (rec_buffer.at_eof && rec_buffer.wptr - rec_buffer.rptr <= 1) {
+		last_decode.valid = 0;
+		return decode_signal(remote, ctx);
+	}
+	result = reuse_decode(remote, ctx);
+	if (result != -1)
+		return result;
+	result = decode_signal(remote, ctx);
+	save_decode(remote, ctx, result);
+	return result;
+}
@@ -54,7 +54,7 @@ static inline lirc_t receive_timeout(lirc_t usec)
 /**
  * Wait until data is available in drv.fd, timeout or a signal is raised.
  *
- * @param maxusec timeout in micro seconds, given to select(2). If <= 0, the
+ * @param maxusec timeout in micro seconds, given to poll(2). If <= 0, the
  *       function will block indefinitely until data is available or a
  *       signal is processed. If positive, a timeout value in microseconds.
  * @return True (1) if there is data available in drv.fd, else 0 indicating
@@ -62,9 +62,30 @@ static inline lirc_t receive_timeout(lirc_t usec)
  */
 int waitfordata(__u32 maxusec);
 
-/** Clear internal buffer to pristine state. */
+/**
+ * Clear internal buffer to pristine state, also dropping data read
+ * ahead using readdata_batch(). To be called when the driver is
+ * (re)initialized and after its deinit_func().
+ */
 void rec_buffer_init(void);
 
+/**
+ * Set the capacity of the internal buffer, which limits the length of
+ * a single signal. Signals longer than this are lost. Clears the buffer.
+ *
+ * @param size Number of pulse/space items, rounded up to a power of two.
+ *     The default and minimum is 512.
+ * @return 1 on success, else 0 leaving the buffer unchanged.
+ */
+int rec_buffer_set_size(unsigned int size);
+
+/**
+ * Check for data already read from the driver using readdata_batch()
+ * but not yet decoded. If so, the next decoding attempt should be
+ * made without waiting for the driver's fd.
+ */
+int rec_buffer_pending(void);
+
 /**
  * Flush the internal fifo and store a single code read
  * from the driver in it.
@@ -88,6 +109,25 @@ void rec_buffer_rewind(void);
 /** Reset internal fifo's write pointer.  */
 void rec_buffer_reset_wptr(void);
 
+/**
+ * Read the first items in the internal fifo without consuming them,
+ * reading more data from the driver when required. The next
+ * receive_decode() sees the same data as if this was never called.
+ *
+ * @param data Array of at least count items, filled with the raw
+ *     pulse/space values starting with the sync space.
+ * @param count Max number of items to read.
+ * @param maxusec Timeout for each item not yet in the fifo.
+ * @return Number of items stored in data, 0 if at EOF.
+ */
+int rec_buffer_peek(lirc_t* data, int count, lirc_t maxusec);
+
+/**
+ * Rewind the internal fifo and mark the first count items as read,
+ * leaving it as a receive_decode() failing after count items would.
+ */
+void rec_buffer_skip(int count);
+
 
 /** @} */
 #ifdef __cplusplus
@@ -76,18 +76,27 @@ void register_button_press(struct ir_remote* remote, struct ir_ncode* ncode, ir_
 	register_input();
 }
 
-void get_release_data(const char** remote_name, const char** button_name, int* reps)
+void get_release_ncode(const char** remote_name, const struct ir_ncode** ncode, int* reps)
 {
 	if (release_remote != NULL) {
 		*remote_name = release_remote->name;
-		*button_name = release_ncode->name;
+		*ncode = release_ncode;
 		*reps = release_reps;
 	} else {
-		*remote_name = *button_name = "(NULL)";
+		*remote_name = "(NULL)";
+		*ncode = NULL;
 		*reps = 0;
 	}
 }
 
+void get_release_data(const char** remote_name, const char** button_name, int* reps)
+{
+	const struct ir_ncode* ncode;
+
+	get_release_ncode(remote_name, &ncode, reps);
+	*button_name = ncode != NULL ? ncode->name : "(NULL)";
+}
+
 void set_release_suffix(const char* s)
 {
 	release_suffix = s;
@@ -98,13 +107,13 @@ void get_release_time(struct timeval* tv)
 	*tv = release_time;
 }
 
-const char* check_release_event(const char** remote_name, const char** button_name)
+const char* check_release_ncode(const char** remote_name, const struct ir_ncode** ncode)
 {
 	int len = 0;
 
 	if (release_remote2 != NULL) {
 		*remote_name = release_remote2->name;
-		*button_name = release_ncode2->name;
+		*ncode = release_ncode2;
 		len = write_message(message,
 				    PACKET_SIZE + 1,
 				    release_remote2->name,
@@ -127,14 +136,25 @@ const char* check_release_event(const char** remote_name, const char** button_na
 	return NULL;
 }
 
-const char* trigger_release_event(const char** remote_name, const char** button_name)
+const char* check_release_event(const char** remote_name, const char** button_name)
+{
+	const struct ir_ncode* ncode = NULL;
+	const char* msg;
+
+	msg = check_release_ncode(remote_name, &ncode);
+	if (ncode != NULL)
+		*button_name = ncode->name;
+	return msg;
+}
+
+const char* trigger_release_ncode(const char** remote_name, const struct ir_ncode** ncode)
 {
 	int len = 0;
 
 	if (release_remote != NULL) {
 		release_remote->release_detected = 1;
 		*remote_name = release_remote->name;
-		*button_name = release_ncode->name;
+		*ncode = release_ncode;
 		len = write_message(message,
 				    PACKET_SIZE + 1,
 				    release_remote->name,
@@ -157,8 +177,19 @@ const char* trigger_release_event(const char** remote_name, const char** button_
 	return NULL;
 }
 
-const char* release_map_remotes(struct ir_remote* old, struct ir_remote* new, const char** remote_name,
-				const char** button_name)
+const char* trigger_release_event(const char** remote_name, const char** button_name)
+{
+	const struct ir_ncode* ncode = NULL;
+	const char* msg;
+
+	msg = trigger_release_ncode(remote_name, &ncode);
+	if (ncode != NULL)
+		*button_name = ncode->name;
+	return msg;
+}
+
+const char* release_map_remotes_ncode(struct ir_remote* old, struct ir_remote* new, const char** remote_name,
+				      const struct ir_ncode** button)
 {
 	struct ir_remote* remote;
 	struct ir_ncode* ncode = NULL;
@@ -176,8 +207,20 @@ const char* release_map_remotes(struct ir_remote* old, struct ir_remote* new, co
 			release_remote = remote;
 			release_ncode = ncode;
 		} else {
-			return trigger_release_event(remote_name, button_name);
+			return trigger_release_ncode(remote_name, button);
 		}
 	}
 	return NULL;
 }
+
+const char* release_map_remotes(struct ir_remote* old, struct ir_remote* new, const char** remote_name,
+				const char** button_name)
+{
+	const struct ir_ncode* ncode = NULL;
+	const char* msg;
+
+	msg = release_map_remotes_ncode(old, new, remote_name, &ncode);
+	if (ncode != NULL)
+		*button_name = ncode->name;
+	return msg;
+}
@@ -30,6 +30,11 @@ void get_release_data(const char** remote_name,
 		      const char** button_name,
 		      int* reps);
 
+/** As get_release_data(), but returns the button's ir_ncode (or NULL). */
+void get_release_ncode(const char** remote_name,
+		       const struct ir_ncode** ncode,
+		       int* reps);
+
 void set_release_suffix(const char* s);
 
 void get_release_time(struct timeval* tv);
@@ -45,6 +50,22 @@ const char* release_map_remotes(struct ir_remote*	old,
 				const char**		remote_name,
 				const char**		button_name);
 
+/*
+ * Variants of the above returning the button's ir_ncode instead of its
+ * name, so the caller can use the data cached in it.
+ */
+
+const char* check_release_ncode(const char**		remote_name,
+				const struct ir_ncode**	ncode);
+
+const char* trigger_release_ncode(const char**		remote_name,
+				  const struct ir_ncode**	ncode);
+
+const char* release_map_remotes_ncode(struct ir_remote*		old,
+				      struct ir_remote*		new_remote,
+				      const char**		remote_name,
+				      const struct ir_ncode**	button);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,266 @@
+/****************************************************************************
+** rx_ring.c ***************************************************************
+****************************************************************************
+*
+* Shared-memory ring passing received data from a driver's reader to lircd.
+*
+*/
+
+/**
+ * @file rx_ring.c
+ * @brief Implements rx_ring.h
+ *
+ * Each side only advances its own index, so no locks are needed. The
+ * producer signals the descriptor only when the consumer has set idle,
+ * and the consumer only clears the descriptor when the ring is empty,
+ * and then checks the ring again after setting idle. Hence the
+ * descriptor is readable whenever the ring holds data.
+ *
+ * After rx_ring_fork() the descriptor is a pipe and only the child holds
+ * the writable end, so the read end reports EOF when the child exits,
+ * however it dies.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#include "lirc/lirc_log.h"
+#include "lirc/receive.h"
+#include "lirc/rx_ring.h"
+
+struct rx_ring {
+	/** Next slot to write, only advanced by the producer */
+	unsigned	head;
+	/** Next slot to read, only advanced by the consumer */
+	unsigned	tail;
+	/** Non-zero if the consumer needs a wakeup on the descriptor */
+	int		idle;
+	/** Number of items lost because the ring was full */
+	unsigned	dropped;
+	/** Non-zero when the producer is gone, set by the consumer */
+	int		closed;
+	/** Non-zero after rx_ring_fork(): fd_write belongs to the child */
+	int		forked;
+	/** Capacity - 1, capacity is a power of two */
+	unsigned	mask;
+	/** Readable end of the wakeup descriptor */
+	int		fd_read;
+	/** Writable end, same as fd_read for an eventfd */
+	int		fd_write;
+	/** Size of the mapping */
+	size_t		length;
+	/** The items, indexed modulo capacity */
+	lirc_t		data[];
+};
+
+
+static int open_wakeup(struct rx_ring* ring)
+{
+#ifdef __linux__
+	ring->fd_read = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	ring->fd_write = ring->fd_read;
+	return ring->fd_read >= 0;
+#else
+	int fds[2];
+
+	if (pipe(fds) == -1)
+		return 0;
+	fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+	fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+	ring->fd_read = fds[0];
+	ring->fd_write = fds[1];
+	return 1;
+#endif
+}
+
+
+struct rx_ring* rx_ring_new(size_t size)
+{
+	struct rx_ring* ring;
+	size_t capacity = 1;
+	size_t length;
+
+	while (capacity < size)
+		capacity *= 2;
+	length = sizeof(struct rx_ring) + capacity * sizeof(lirc_t);
+	ring = mmap(NULL, length, PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (ring == MAP_FAILED) {
+		logperror(LIRC_ERROR, "rx_ring_new(): mmap");
+		return NULL;
+	}
+	ring->head = ring->tail = 0;
+	ring->idle = 1;
+	ring->dropped = 0;
+	ring->closed = 0;
+	ring->forked = 0;
+	ring->mask = capacity - 1;
+	ring->length = length;
+	if (!open_wakeup(ring)) {
+		logperror(LIRC_ERROR, "rx_ring_new()");
+		munmap(ring, length);
+		return NULL;
+	}
+	return ring;
+}
+
+
+void rx_ring_free(struct rx_ring* ring)
+{
+	if (ring == NULL)
+		return;
+	if (ring->fd_write != ring->fd_read && !ring->forked)
+		close(ring->fd_write);
+	close(ring->fd_read);
+	munmap(ring, ring->length);
+}
+
+
+int rx_ring_fd(const struct rx_ring* ring)
+{
+	return ring->fd_read;
+}
+
+
+pid_t rx_ring_fork(struct rx_ring* ring)
+{
+	int fds[2];
+	pid_t pid;
+
+	if (ring->fd_write == ring->fd_read) {
+		/* An eventfd can't tell that the child died, use a pipe.
+		 * Keep the descriptor number, it may already be drv.fd. */
+		if (pipe(fds) == -1)
+			return -1;
+		if (dup2(fds[0], ring->fd_read) == -1) {
+			close(fds[0]);
+			close(fds[1]);
+			return -1;
+		}
+		close(fds[0]);
+		ring->fd_write = fds[1];
+		fcntl(ring->fd_read, F_SETFL, fcntl(ring->fd_read, F_GETFL) | O_NONBLOCK);
+		fcntl(ring->fd_write, F_SETFL, fcntl(ring->fd_write, F_GETFL) | O_NONBLOCK);
+		fcntl(ring->fd_read, F_SETFD, FD_CLOEXEC);
+		fcntl(ring->fd_write, F_SETFD, FD_CLOEXEC);
+	}
+	pid = fork();
+	if (pid > 0) {
+		ring->forked = 1;
+		close(ring->fd_write);
+	}
+	return pid;
+}
+
+
+int rx_ring_put(struct rx_ring* ring, lirc_t data)
+{
+	unsigned head = ring->head;
+
+	if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) > ring->mask) {
+		__atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+	ring->data[head & ring->mask] = data;
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+
+/* Number of queued items, safe on both sides. */
+static unsigned ring_count(struct rx_ring* ring)
+{
+	return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)
+	       - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+
+/* Make the descriptor readable if the consumer asked for it. */
+static void wakeup(struct rx_ring* ring)
+{
+	static const uint64_t one = 1;
+
+	/* Order the producer's head update before reading idle */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	/* An eventfd wants 8 bytes, a pipe takes them as well */
+	if (__atomic_exchange_n(&ring->idle, 0, __ATOMIC_SEQ_CST))
+		chk_write(ring->fd_write, &one, sizeof(one));
+}
+
+
+void rx_ring_flush(struct rx_ring* ring)
+{
+	if (ring_count(ring) > 0)
+		wakeup(ring);
+}
+
+
+/*
+ * Consumer: if the ring is empty, clear the descriptor and ask the
+ * producer for a wakeup. Returns 1 if the ring is (still) empty.
+ */
+static int ring_idle(struct rx_ring* ring)
+{
+	char buf[64];
+	ssize_t n;
+
+	if (ring_count(ring) > 0)
+		return 0;
+	while ((n = read(ring->fd_read, buf, sizeof(buf))) > 0)
+		;
+	if (n == 0 && !ring->closed) {
+		/* Only after rx_ring_fork(): the child has exited */
+		logprintf(LIRC_ERROR, "rx_ring: producer has exited");
+		ring->closed = 1;
+	}
+	__atomic_store_n(&ring->idle, 1, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (ring_count(ring) == 0)
+		return 1;
+	/* Raced with the producer, keep the descriptor readable */
+	wakeup(ring);
+	return 0;
+}
+
+
+int rx_ring_wait(struct rx_ring* ring, lirc_t timeout)
+{
+	while (ring_idle(ring)) {
+		if (ring->closed)
+			return -1;
+		if (!waitfordata((long)timeout))
+			return 0;
+	}
+	return 1;
+}
+
+
+size_t rx_ring_get(struct rx_ring* ring, lirc_t* buf, size_t n)
+{
+	unsigned dropped;
+	size_t count = ring_count(ring);
+	size_t i;
+
+	if (n > count)
+		n = count;
+	for (i = 0; i < n; i++)
+		buf[i] = ring->data[(ring->tail + i) & ring->mask];
+	__atomic_store_n(&ring->tail, ring->tail + n, __ATOMIC_RELEASE);
+
+	dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+	if (dropped > 0)
+		logprintf(LIRC_WARNING, "rx_ring: %u items dropped", dropped);
+	ring_idle(ring);
+	return n;
+}
@@ -0,0 +1,125 @@
+/****************************************************************************
+** rx_ring.h ***************************************************************
+****************************************************************************
+*
+* Shared-memory ring passing received data from a driver's reader to lircd.
+*
+*/
+
+/**
+ * @file rx_ring.h
+ * @brief Shared-memory ring for drivers reading in a separate context.
+ * @ingroup driver_api
+ *
+ * Several drivers read the hardware in a forked child, a thread or a
+ * signal handler, and traditionally write every pulse and space into a
+ * pipe which lircd reads back one item at a time. That costs two
+ * copies through the kernel and a system call per item on each side.
+ *
+ * An rx_ring replaces the pipe. The items are stored in a
+ * single-producer, single-consumer ring in anonymous shared memory,
+ * which survives fork(). rx_ring_fd() is a file descriptor which is
+ * readable while the ring holds data (an eventfd on Linux, a pipe
+ * elsewhere); it is used as drv.fd so lircd's main loop keeps working
+ * unchanged. The producer only touches the descriptor when the
+ * consumer has run out of data, i. e. once per burst.
+ *
+ * Converting a fork-and-pipe driver:
+ *
+ * - In init(), call rx_ring_new() instead of pipe(), set drv.fd to
+ *   rx_ring_fd() and start the child with rx_ring_fork() instead of
+ *   fork(). The parent then notices when the child exits.
+ * - In the child, call rx_ring_put() for each item instead of write(),
+ *   and rx_ring_flush() once each batch read from the device is done.
+ * - readdata() and readdata_batch() use rx_ring_wait() followed by
+ *   rx_ring_get(), and deinit() when rx_ring_wait() reports that the
+ *   child is gone.
+ * - In deinit(), stop the child first, then call rx_ring_free(). Do
+ *   not close drv.fd, the ring owns it.
+ *
+ * Moving the reader from a child process into a worker thread is then
+ * a local change: create the ring before pthread_create(), run the
+ * same producer loop in the thread, and join it before rx_ring_free().
+ * The ring needs no locking in either case. Only one context may put
+ * and only one may get.
+ */
+
+/** @addtogroup driver_api
+ *  @{
+ */
+
+#ifndef _RX_RING_H
+#define _RX_RING_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "ir_remote_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct rx_ring;
+
+/**
+ * Create an empty ring in shared memory.
+ *
+ * @param size Capacity in items, rounded up to a power of two.
+ * @return New ring, or NULL on errors.
+ */
+struct rx_ring* rx_ring_new(size_t size);
+
+/** Release the ring and its file descriptor. */
+void rx_ring_free(struct rx_ring* ring);
+
+/** File descriptor which is readable while the ring holds data. */
+int rx_ring_fd(const struct rx_ring* ring);
+
+/**
+ * fork() with the ring's descriptor turned into a pipe whose writable
+ * end only the child holds. When the child exits, however it dies,
+ * the descriptor becomes readable and rx_ring_wait() returns -1 once
+ * the ring is drained. The descriptor number is not changed.
+ *
+ * @return As fork().
+ */
+pid_t rx_ring_fork(struct rx_ring* ring);
+
+/**
+ * Producer: append one item. When the ring is full the item is
+ * dropped, and reported by the consumer later.
+ *
+ * @return 1 if the item was stored, else 0.
+ */
+int rx_ring_put(struct rx_ring* ring, lirc_t data);
+
+/**
+ * Producer: make the file descriptor readable if the consumer waits
+ * for it. Call this after each batch of rx_ring_put().
+ */
+void rx_ring_flush(struct rx_ring* ring);
+
+/**
+ * Consumer: wait for data, using waitfordata() on drv.fd.
+ *
+ * @param timeout Max time to wait in us, 0 means forever.
+ * @return 1 if the ring holds data, 0 on timeout, -1 if the ring is
+ *     empty and the child started by rx_ring_fork() has exited.
+ */
+int rx_ring_wait(struct rx_ring* ring, lirc_t timeout);
+
+/**
+ * Consumer: move up to n queued items to buf without blocking.
+ *
+ * @return Number of items stored in buf.
+ */
+size_t rx_ring_get(struct rx_ring* ring, lirc_t* buf, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+
+#endif
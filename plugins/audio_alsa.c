@@ -22,19 +22,19 @@
 # include <config.h>
 #endif
 
+#include <errno.h>
 #include <stdlib.h>
 #include <fcntl.h>
 #include <unistd.h>
-#include <limits.h>
-#include <signal.h>
 #include <sys/types.h>
-#include <sys/stat.h>
 
 #define ALSA_PCM_NEW_HW_PARAMS_API
 #define ALSA_PCM_NEW_SW_PARAMS_API
 #include <alsa/asoundlib.h>
 
 #include "lirc_driver.h"
+#include "lirc/rx_ring.h"
+#include "audio_common.h"
 
 /* SHORT DRIVER DESCRIPTION:
  *
@@ -43,14 +43,13 @@
  * desired the level of input signal to be relatively strong (without
  * clipping although it does not hurt).
  *
- * This driver works as following: it creates a named pipe (called usually
- * /dev/lirc) and opens it. The handle is handed then to the receive.c module
- * which reads or writes data from it. The client HAS to use non-blocking
- * I/O otherwise we don't get a chance to run ever (this could be fixed
- * by creating a secondary thread and doing all audio stuff there).
- * If one day this driver will support sending commands, we'll have to use
- * asyncronous I/O (O_ASYNC and a signal handler) so that we get control
- * right after client writes to the pipe.
+ * This driver works as following: the ALSA callback (run from the SIGIO
+ * handler) stores the decoded pulse and space lengths in an rx_ring,
+ * which is drained by the readdata functions called from the receive.c
+ * module. The handle given to LIRC is the ring's descriptor, which is
+ * readable while the ring holds data. The client HAS to use non-blocking
+ * I/O otherwise we don't get a chance to run ever (this could be fixed by
+ * creating a secondary thread and doing all audio stuff there).
  *
  * For usage documentation see audio-alsa.html.
  */
@@ -65,14 +64,14 @@ static struct {
 	snd_pcm_format_t	format;
 	/* The audio buffer size in microseconds */
 	unsigned		buffer_time;
-	/* The FIFO handle for reading and writing */
-	int			fd;
 	/* The asynchronous I/O signal handler object */
 	snd_async_handler_t*	sighandler;
 	/* Value indicating number of channels for capture */
 	unsigned char		num_channels;
 	/* Value indicating which channel to look for signal 0=right 1=left */
 	unsigned char		channel;
+	/* Number of channels decoded, from channel onwards */
+	unsigned char		receivers;
 } alsa_hw = {
 	NULL,
 	/* Desired sampling frequency */
@@ -84,11 +83,28 @@ static struct {
 	 * and record.c thinks there is a time gap between data (and drops
 	 * the repeat count).
 	 */
-	100000,	-1, NULL, 1, 0 /*Use left channel by default */
+	100000,	NULL, 1, 0 /*Use left channel by default */, 1
 };
 
-/* Return the absolute difference between two unsigned 8-bit samples */
-#define U8_ABSDIFF(s1, s2) (((s1) >= (s2)) ? ((s1) - (s2)) : ((s2) - (s1)))
+/* Largest number of channels decoded as independent receivers */
+#define MAX_RECEIVERS 2
+
+/*
+ * Demodulator state for each decoded channel. When several channels are
+ * decoded, the first one to report an edge owns the output until it has
+ * been silent for RECEIVER_RELEASE microseconds; the other channels are
+ * ignored meanwhile, so a signal seen by both receivers is queued once.
+ */
+static struct audio_demod receiver[MAX_RECEIVERS];
+static int receiver_owner = -1;
+
+#define RECEIVER_RELEASE 200000
+
+
+/* Pulses and spaces from alsa_sig_io() to the readdata functions */
+#define RING_SIZE 16384
+
+static struct rx_ring* ring = NULL;
 
 /* Forward declarations */
 static int audio_alsa_deinit(void);
@@ -158,46 +174,17 @@ static int alsa_set_hwparams(void)
 
 int audio_alsa_init(void)
 {
-	int fd, err;
+	int i, err;
 	char* pcm_rate;
-	char tmp_name[20];
+	char tmp_name[20] = "";
 
 	rec_buffer_init();
 
-	/* Create a temporary filename for our FIFO,
-	 * Use mkstemp() instead of mktemp() although we need a FIFO not a
-	 * regular file. We do this since glibc barfs at mktemp() and this
-	 * scares the users :-)
-	 */
-	strcpy(tmp_name, "/tmp/lircXXXXXX");
-	fd = mkstemp(tmp_name);
-	close(fd);
-
-	/* Start the race! */
-	unlink(tmp_name);
-	if (mknod(tmp_name, S_IFIFO | S_IRUSR | S_IWUSR, 0)) {
-		logprintf(LIRC_ERROR, "could not create FIFO %s", tmp_name);
-		logperror(LIRC_ERROR, "audio_alsa_init ()");
-		return 0;
-	}
-	/* Phew, we won the race ... */
-
-	/* Open the pipe and hand it to LIRC ... */
-	drv.fd = open(tmp_name, O_RDWR);
-	if (drv.fd < 0) {
-		logprintf(LIRC_ERROR, "could not open pipe %s", tmp_name);
-		logperror(LIRC_ERROR, "audio_alsa_init ()");
-error:          unlink(tmp_name);
-		audio_alsa_deinit();
+	/* Hand LIRC a handle which is readable while the ring holds data */
+	ring = rx_ring_new(RING_SIZE);
+	if (ring == NULL)
 		return 0;
-	}
-
-	/* Open the other end of the pipe and hand it to ALSA code.
-	 * We're opening it in non-blocking mode to avoid lockups.
-	 */
-	alsa_hw.fd = open(tmp_name, O_RDWR | O_NONBLOCK);
-	/* Ok, we don't need the FIFO visible in the filesystem anymore ... */
-	unlink(tmp_name);
+	drv.fd = rx_ring_fd(ring);
 
 	/* Examine the device name, if it contains a sample rate */
 	strncpy(tmp_name, drv.device, sizeof(tmp_name) - 1);
@@ -219,11 +206,15 @@ error:          unlink(tmp_name);
 			 * more common signed 16bit samples */
 			alsa_hw.format = SND_PCM_FORMAT_S16_LE;
 
-			if (stereo_channel[1] == 'l')
+			if (stereo_channel[1] == 'l') {
 				alsa_hw.channel = 0;
-			else if (stereo_channel[1] == 'r')
+			} else if (stereo_channel[1] == 'r') {
 				alsa_hw.channel = 1;
-			else
+			} else if (stereo_channel[1] == 'b') {
+				/* Both channels, as independent receivers */
+				alsa_hw.channel = 0;
+				alsa_hw.receivers = 2;
+			} else
 				logperror(LIRC_WARNING,
 					  "dont understand which channel to use - defaulting to left\n");
 		}
@@ -255,6 +246,9 @@ error:          unlink(tmp_name);
 	/* Set sampling parameters */
 	if (alsa_set_hwparams())
 		goto error;
+	for (i = 0; i < alsa_hw.receivers; i++)
+		audio_demod_init(&receiver[i], alsa_hw.rate);
+	receiver_owner = -1;
 
 	LOGPRINTF(1, "hw_audio_alsa: Using device '%s', sampling rate %dHz\n", tmp_name, alsa_hw.rate);
 
@@ -263,6 +257,10 @@ error:          unlink(tmp_name);
 		goto error;
 
 	return 1;
+
+error:
+	audio_alsa_deinit();
+	return 0;
 }
 
 int audio_alsa_deinit(void)
@@ -275,73 +273,35 @@ int audio_alsa_deinit(void)
 		snd_pcm_close(alsa_hw.handle);
 		alsa_hw.handle = NULL;
 	}
-	if (alsa_hw.fd != -1) {
-		close(alsa_hw.fd);
-		alsa_hw.fd = -1;
-	}
-	if (drv.fd != -1) {
-		close(drv.fd);
-		drv.fd = -1;
-	}
+	rx_ring_free(ring);
+	ring = NULL;
+	drv.fd = -1;
 	return 1;
 }
 
 /*
  * ALSA calls this callback when some data is available for reading.
- * The detection algorithm is somewhat sophisticated but it should give
- * good practical results. The algorithm works as follows:
- *
- * Sampled data is converted to unsigned form (e.g. 0x80 is zero).
- *
- * The current "middle" value is constantly tracked (e.g. signal
- * could deviate from the 0x80 by a certain amount due to soundcard
- * entry capacitance). Then we subtract that middle from every sample
- * to get a signed value (to know whether it is less or more than current
- * tracked "zero" value). This is called 'current sample'.
- *
- * The absolute value of current sample is integrated over time to get
- * automatic level correction (e.g. to smooth the difference between
- * different hardware which can have different output levels). This is
- * called 'signal level'.
- *
- * Then the algorithm waits for a substantial change in the level of
- * input signals (since IR module outputs a square wave). When this
- * substantial change crosses our "virtual zero", it is considered
- * a real level change, and the type of signal is toggled
- * (space <-> pulse).
+ * The samples of each decoded channel are converted to unsigned 8-bit
+ * form and run through the demodulator in audio_common.c, which turns
+ * them into pulse and space lengths.
  */
 
 #define READ_BUFFER_SIZE (2 * 4096)
 
 static void alsa_sig_io(snd_async_handler_t* h)
 {
-	/* Previous sample */
-	static unsigned char ps = 0x80;
-	/* Count samples with similar level (to detect pule/space
-	 * length), 24.8 fp */
-	static unsigned sample_count = 0;
-	/* Current signal level (dynamically changes) */
-	static unsigned signal_level = 0;
-	/* Current state (pulse or space) */
-	static unsigned signal_state = 0;
-	/* Signal maximum and minimum (used for "zero" detection) */
-	static unsigned char signal_max = 0x80, signal_min = 0x80;
-	/* Non-zero if we're in zero crossing waiting state */
-	static char waiting_zerox = 0;
 	/* Store sample size, as our sample buffer will represent
 	 * shorts or chars */
 	unsigned char bytes_per_sample = (alsa_hw.format == SND_PCM_FORMAT_S16_LE ? 2 : 1);
+	enum audio_demod_format format;
 
 	int i, err;
 	char buff[READ_BUFFER_SIZE];
 	snd_pcm_sframes_t count;
-
-	/* The value to multiply with number of samples to get microseconds
-	 * (fixed-point 24.8 bits).
-	 */
-	unsigned mulconst = 256000000 / alsa_hw.rate;
-	/* Maximal number of samples that can be multiplied by mulconst */
-	unsigned maxcount = (((PULSE_MASK << 8) | 0xff) / mulconst) << 8;
+	/* One channel of samples, and the edges found in each channel */
+	static unsigned char samples[READ_BUFFER_SIZE];
+	static lirc_t edges[MAX_RECEIVERS][READ_BUFFER_SIZE];
+	size_t found[MAX_RECEIVERS];
 
 	/* First of all, check for underrun. This happens, for example, when
 	 * the X11 server starts. If we won't, recording will stop forever.
@@ -360,161 +320,72 @@ static void alsa_sig_io(snd_async_handler_t* h)
 		alsa_error("prepare", snd_pcm_prepare(alsa_hw.handle));
 		alsa_error("start", snd_pcm_start(alsa_hw.handle));
 var_reset:                      /* Reset variables */
-		sample_count = 0;
-		waiting_zerox = 0;
-		signal_level = 0;
-		signal_state = 0;
-		signal_max = signal_min = 0x80;
+		for (i = 0; i < alsa_hw.receivers; i++)
+			audio_demod_reset(&receiver[i]);
+		receiver_owner = -1;
 		break;
 	default:
 		/* Stream is okay */
 		break;
 	}
 
+	if (alsa_hw.format == SND_PCM_FORMAT_S16_LE)
+		format = AUDIO_DEMOD_S16_LE;
+	else if (alsa_hw.format == SND_PCM_FORMAT_S8)
+		format = AUDIO_DEMOD_S8;
+	else
+		format = AUDIO_DEMOD_U8;
+
 	/* Read all available data */
 	count = snd_pcm_avail_update(alsa_hw.handle);
 	if (count > 0) {
 		if (count > (READ_BUFFER_SIZE / (bytes_per_sample * alsa_hw.num_channels)))
 			count = READ_BUFFER_SIZE / (bytes_per_sample * alsa_hw.num_channels);
 		count = snd_pcm_readi(alsa_hw.handle, buff, count);
-
-		/*Loop around samples, if stereo we are
-		 * only interested in one channel*/
-		for (i = 0; i < count; i++) {
-			/* cs == current sample */
-			unsigned char cs, as, sl, sz, xz;
-			short stmp;
-
-			if (bytes_per_sample == 2) {
-				stmp = buff[i * bytes_per_sample * alsa_hw.num_channels +
-					    bytes_per_sample * alsa_hw.channel];
-				cs = stmp >> 8;
-				cs ^= 0x80;
-			} else {
-				cs = buff[i];
-
-				/* Convert signed samples to unsigned */
-				if (alsa_hw.format == SND_PCM_FORMAT_S8)
-					cs ^= 0x80;
-			}
-
-			/* Track signal middle value (it could differ from 0x80) */
-			sz = (signal_min + signal_max) / 2;
-			if (cs <= sz)
-				signal_min = (signal_min * 7 + cs) / 8;
-			if (cs >= sz)
-				signal_max = (signal_max * 7 + cs) / 8;
-
-			/* Compute the absolute signal deviation from middle */
-			as = U8_ABSDIFF(cs, sz);
-
-			/* Integrate incoming signal (auto level adjustment) */
-			signal_level = (signal_level * 7 + as) / 8;
-
-			/* Don't let too low signal levels as it makes us sensible to noise */
-			sl = signal_level;
-			if (sl < 16)
-				sl = 16;
-
-			/* Detect crossing current "zero" level */
-			xz = ((cs - sz) ^ (ps - sz)) & 0x80;
-
-			/* Don't wait for zero crossing for too long */
-			if (waiting_zerox && !xz)
-				waiting_zerox--;
-
-			/* Detect significant signal level changes */
-			if ((abs(cs - ps) > sl / 2) && xz)
-				waiting_zerox = 2;
-
-			/* If we have crossed zero with a substantial level change, go */
-			if (waiting_zerox && xz) {
-				lirc_t x;
-
-				waiting_zerox = 0;
-
-				if (sample_count >= maxcount) {
-					x = PULSE_MASK;
-					sample_count = 0;
-				} else {
-					/**
-					 * Try to interpolate the samples and determine where exactly
-					 * the zero crossing point was. This is required as the
-					 * remote signal frequency is relatively close to our sampling
-					 * frequency thus a sampling error of 1 sample can lead to
-					 * substantial time differences.
-					 *
-					 *     slope = (x2 - x1) / (y2 - y1)
-					 *     x = x1 + (y - y1) * slope
-					 *
-					 * where x1=-1, x2=0, y1=ps, y2=cs, y=sz, thus:
-					 *
-					 *     x = -1 + (y - y1) / (y2 - y1), or
-					 * ==> x = (y - y2) / (y2 - y1)
-					 *
-					 * y2 (cs) cannot be equal to y1 (ps), otherwise we wouldn't
-					 * get here.
-					 */
-					int delta = (((int)sz - (int)cs) << 8) / ((int)cs - (int)ps);
-					/* This expression can easily overflow the 'long' value since it
-					 * multiplies two 24.8 values (and we get a 24.16 instead).
-					 * To avoid this we cast the intermediate value to "long long".
-					 */
-					x = (((long long)sample_count + delta) * mulconst) >> 16;
-					/* The rest of the quantum is on behalf of next pulse. Note that
-					 * sample_count can easily be assigned here a negative value (in
-					 * the case zero crossing occurs during the next quantum).
-					 */
-					sample_count = -delta;
-				}
-
-				/* Consider impossible pulses with length greater than
-				 * 0.02 seconds, thus it is a space (desynchronization).
-				 */
-				if ((x > 20000) && signal_state) {
-					signal_state = 0;
-					LOGPRINTF(1, "Pulse/space desynchronization fixed - len %u", x);
-				}
-
-				x |= signal_state;
-
-				/* Write the LIRC code to the FIFO */
-				chk_write(alsa_hw.fd, &x, sizeof(x));
-
-				signal_state ^= PULSE_BIT;
-			}
-
-			/* Remember previous sample */
-			ps = cs;
-
-			/* Count number of samples with the same level.
-			 * sample_count can be less than zero at the start of pulse
-			 * (due to interpolation) so we have to consider them.
-			 */
-			if ((sample_count < UINT_MAX - 0x400)
-			    || (sample_count > UINT_MAX - 0x200))
-				sample_count += 0x100;
+	}
+	if (count > 0) {
+		/* Demodulate each channel we are interested in */
+		for (i = 0; i < alsa_hw.receivers; i++) {
+			audio_demod_extract(samples, buff, count, format,
+					    alsa_hw.num_channels,
+					    alsa_hw.channel + i);
+			found[i] = audio_demod_run(&receiver[i], samples,
+						   count, edges[i]);
 		}
+
+		/* Let a silent receiver hand over the output */
+		if (receiver_owner >= 0 && found[receiver_owner] == 0
+		    && audio_demod_idle(&receiver[receiver_owner]) > RECEIVER_RELEASE)
+			receiver_owner = -1;
+		for (i = 0; receiver_owner < 0 && i < alsa_hw.receivers; i++)
+			if (found[i] > 0)
+				receiver_owner = i;
+
+		/* Queue the LIRC codes for the decoder */
+		if (receiver_owner >= 0)
+			for (i = 0; i < (int)found[receiver_owner]; i++)
+				rx_ring_put(ring, edges[receiver_owner][i]);
 	}
+	/* One wakeup for everything queued by this call */
+	rx_ring_flush(ring);
 }
 
 lirc_t audio_alsa_readdata(lirc_t timeout)
 {
 	lirc_t data;
-	int ret;
 
-	if (!waitfordata((long)timeout))
+	if (!rx_ring_wait(ring, timeout))
 		return 0;
+	rx_ring_get(ring, &data, 1);
+	return data;
+}
 
-	ret = read(drv.fd, &data, sizeof(data));
-
-	if (ret != sizeof(data)) {
-		LOGPRINTF(1, "error reading from lirc device");
-		LOGPERROR(1, NULL);
-		raise(SIGTERM);
+/* Like audio_alsa_readdata(), but fetch all queued items at once. */
+int audio_alsa_readdata_batch(lirc_t* buf, size_t n, lirc_t timeout)
+{
+	if (!rx_ring_wait(ring, timeout))
 		return 0;
-	}
-	return data;
+	return rx_ring_get(ring, buf, n);
 }
 
 char* audio_alsa_rec(struct ir_remote* remotes)
@@ -543,9 +414,10 @@ const struct driver hw_audio_alsa = {
 	.decode_func	= audio_alsa_decode,
 	.drvctl_func	= NULL,
 	.readdata	= audio_alsa_readdata,
-	.api_version	= 2,
+	.api_version	= 3,
 	.driver_version = "0.9.2",
-	.info		= "No info available."
+	.info		= "No info available.",
+	.readdata_batch = audio_alsa_readdata_batch
 };
 
 const struct driver* hardwares[] = { &hw_audio_alsa, (const struct driver*)NULL };
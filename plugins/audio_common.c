@@ -0,0 +1,335 @@
+/****************************************************************************
+ ** audio_common.c **********************************************************
+ ****************************************************************************
+ *
+ * Sample-to-edge demodulator used by the audio_alsa driver.
+ *
+ * The detection algorithm is somewhat sophisticated but it should give
+ * good practical results. The algorithm works as follows:
+ *
+ * Sampled data is converted to unsigned form (e.g. 0x80 is zero).
+ *
+ * The current "middle" value is constantly tracked (e.g. signal
+ * could deviate from the 0x80 by a certain amount due to soundcard
+ * entry capacitance). Then we subtract that middle from every sample
+ * to get a signed value (to know whether it is less or more than current
+ * tracked "zero" value). This is called 'current sample'.
+ *
+ * The absolute value of current sample is integrated over time to get
+ * automatic level correction (e.g. to smooth the difference between
+ * different hardware which can have different output levels). This is
+ * called 'signal level'.
+ *
+ * Then the algorithm waits for a substantial change in the level of
+ * input signals (since IR module outputs a square wave). When this
+ * substantial change crosses our "virtual zero", it is considered
+ * a real level change, and the type of signal is toggled
+ * (space <-> pulse).
+ *
+ * Each sample depends on the state left by the previous one, so the
+ * filter itself cannot be computed in parallel. However, between IR
+ * edges the input is mostly flat, and once the filter has settled on
+ * a flat input, further identical samples only advance the sample
+ * counter. Such runs are located with vector compares (SSE2, AVX2 or
+ * NEON when the compiler targets them) and skipped in bulk, which is
+ * where the time goes at high sampling rates.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "audio_common.h"
+
+/* Return the absolute difference between two unsigned 8-bit samples */
+#define U8_ABSDIFF(s1, s2) (((s1) >= (s2)) ? ((s1) - (s2)) : ((s2) - (s1)))
+
+/* sample_count stops counting in this range, see add_samples() */
+#define COUNT_HOLD_LOW  (UINT_MAX - 0x400)
+#define COUNT_HOLD_HIGH (UINT_MAX - 0x200)
+
+
+void audio_demod_reset(struct audio_demod* d)
+{
+	d->sample_count = 0;
+	d->waiting_zerox = 0;
+	d->signal_level = 0;
+	d->signal_state = 0;
+	d->signal_max = d->signal_min = 0x80;
+}
+
+
+void audio_demod_init(struct audio_demod* d, unsigned rate)
+{
+	/* The value to multiply with number of samples to get microseconds
+	 * (fixed-point 24.8 bits).
+	 */
+	d->mulconst = 256000000 / rate;
+	/* Maximal number of samples that can be multiplied by mulconst */
+	d->maxcount = (((PULSE_MASK << 8) | 0xff) / d->mulconst) << 8;
+	d->ps = 0x80;
+	audio_demod_reset(d);
+}
+
+
+void audio_demod_extract(unsigned char* out, const void* in, size_t frames,
+			 enum audio_demod_format format,
+			 unsigned channels, unsigned channel)
+{
+	const unsigned char* src = (const unsigned char*)in;
+	size_t i;
+
+	switch (format) {
+	case AUDIO_DEMOD_U8:
+		if (channels == 1) {
+			memcpy(out, src, frames);
+			return;
+		}
+		for (i = 0; i < frames; i++)
+			out[i] = src[i * channels + channel];
+		break;
+	case AUDIO_DEMOD_S8:
+		/* Convert signed samples to unsigned */
+		for (i = 0; i < frames; i++)
+			out[i] = src[i * channels + channel] ^ 0x80;
+		break;
+	case AUDIO_DEMOD_S16_LE:
+		/* Keep the most significant (second) byte */
+		for (i = 0; i < frames; i++)
+			out[i] = src[(i * channels + channel) * 2 + 1] ^ 0x80;
+		break;
+	}
+}
+
+
+/* Advance sample_count by k samples, as k single steps would. */
+static void add_samples(struct audio_demod* d, size_t k)
+{
+	size_t steps;
+
+	/* sample_count can be less than zero at the start of pulse
+	 * (due to interpolation) so we have to consider them.
+	 */
+	while (k > 0 && d->sample_count > COUNT_HOLD_HIGH) {
+		d->sample_count += 0x100;
+		k--;
+	}
+	if (k == 0 || d->sample_count >= COUNT_HOLD_LOW)
+		return;
+	steps = (COUNT_HOLD_LOW - d->sample_count + 0xff) / 0x100;
+	if (steps > k)
+		steps = k;
+	d->sample_count += steps * 0x100;
+}
+
+
+/* Number of leading samples in p[0..n - 1] equal to v. */
+static size_t run_length(const unsigned char* p, size_t n, unsigned char v)
+{
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	const __m256i vv = _mm256_set1_epi8((char)v);
+
+	for (; i + 32 <= n; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(p + i));
+		unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, vv));
+
+		if (mask != 0xffffffffu)
+			return i + __builtin_ctz(~mask);
+	}
+#elif defined(__SSE2__)
+	const __m128i vv = _mm_set1_epi8((char)v);
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(p + i));
+		unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(x, vv));
+
+		if (mask != 0xffff)
+			return i + __builtin_ctz(~mask);
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	const uint8x16_t vv = vdupq_n_u8(v);
+
+	for (; i + 16 <= n; i += 16) {
+		uint8x16_t eq = vceqq_u8(vld1q_u8(p + i), vv);
+
+		if (vminvq_u8(eq) != 0xff)
+			break;
+	}
+#endif
+	while (i < n && p[i] == v)
+		i++;
+	return i;
+}
+
+
+/* Feed one sample to d, return 1 and store *edge if it ends a pulse or space. */
+static inline int demod_step(struct audio_demod* d, unsigned char cs,
+			     lirc_t* edge)
+{
+	unsigned char ps = d->ps;
+	unsigned char as, sl, sz, xz;
+	int found = 0;
+
+	/* Track signal middle value (it could differ from 0x80) */
+	sz = (d->signal_min + d->signal_max) / 2;
+	if (cs <= sz)
+		d->signal_min = (d->signal_min * 7 + cs) / 8;
+	if (cs >= sz)
+		d->signal_max = (d->signal_max * 7 + cs) / 8;
+
+	/* Compute the absolute signal deviation from middle */
+	as = U8_ABSDIFF(cs, sz);
+
+	/* Integrate incoming signal (auto level adjustment) */
+	d->signal_level = (d->signal_level * 7 + as) / 8;
+
+	/* Don't let too low signal levels as it makes us sensible to noise */
+	sl = d->signal_level;
+	if (sl < 16)
+		sl = 16;
+
+	/* Detect crossing current "zero" level */
+	xz = ((cs - sz) ^ (ps - sz)) & 0x80;
+
+	/* Don't wait for zero crossing for too long */
+	if (d->waiting_zerox && !xz)
+		d->waiting_zerox--;
+
+	/* Detect significant signal level changes */
+	if ((abs(cs - ps) > sl / 2) && xz)
+		d->waiting_zerox = 2;
+
+	/* If we have crossed zero with a substantial level change, go */
+	if (d->waiting_zerox && xz) {
+		lirc_t x;
+
+		d->waiting_zerox = 0;
+
+		if (d->sample_count >= d->maxcount) {
+			x = PULSE_MASK;
+			d->sample_count = 0;
+		} else {
+			/**
+			 * Try to interpolate the samples and determine where exactly
+			 * the zero crossing point was. This is required as the
+			 * remote signal frequency is relatively close to our sampling
+			 * frequency thus a sampling error of 1 sample can lead to
+			 * substantial time differences.
+			 *
+			 *     slope = (x2 - x1) / (y2 - y1)
+			 *     x = x1 + (y - y1) * slope
+			 *
+			 * where x1=-1, x2=0, y1=ps, y2=cs, y=sz, thus:
+			 *
+			 *     x = -1 + (y - y1) / (y2 - y1), or
+			 * ==> x = (y - y2) / (y2 - y1)
+			 *
+			 * y2 (cs) cannot be equal to y1 (ps), otherwise we wouldn't
+			 * get here.
+			 */
+			int delta = (((int)sz - (int)cs) << 8) / ((int)cs - (int)ps);
+			/* This expression can easily overflow the 'long' value since it
+			 * multiplies two 24.8 values (and we get a 24.16 instead).
+			 * To avoid this we cast the intermediate value to "long long".
+			 */
+			x = (((long long)d->sample_count + delta) * d->mulconst) >> 16;
+			/* The rest of the quantum is on behalf of next pulse. Note that
+			 * sample_count can easily be assigned here a negative value (in
+			 * the case zero crossing occurs during the next quantum).
+			 */
+			d->sample_count = -delta;
+		}
+
+		/* Consider impossible pulses with length greater than
+		 * 0.02 seconds, thus it is a space (desynchronization).
+		 */
+		if ((x > 20000) && d->signal_state) {
+			d->signal_state = 0;
+			LOGPRINTF(1, "Pulse/space desynchronization fixed - len %u", x);
+		}
+
+		*edge = x | d->signal_state;
+		d->signal_state ^= PULSE_BIT;
+		found = 1;
+	}
+
+	/* Remember previous sample */
+	d->ps = cs;
+
+	/* Count number of samples with the same level. */
+	add_samples(d, 1);
+	return found;
+}
+
+
+size_t audio_demod_run(struct audio_demod* d, const unsigned char* samples,
+		       size_t n, lirc_t* edges)
+{
+	size_t found = 0;
+	size_t i = 0;
+
+	while (i < n) {
+		unsigned char cs = samples[i];
+		unsigned char min = d->signal_min;
+		unsigned char max = d->signal_max;
+		unsigned level = d->signal_level;
+		int flat = (cs == d->ps);
+
+		if (demod_step(d, cs, edges + found)) {
+			found++;
+			i++;
+			continue;
+		}
+		i++;
+		/* A flat input which left the filter unchanged will keep
+		 * doing so until the input changes: skip to that point.
+		 */
+		if (flat && d->waiting_zerox == 0
+		    && min == d->signal_min && max == d->signal_max
+		    && level == d->signal_level) {
+			size_t run = run_length(samples + i, n - i, cs);
+
+			add_samples(d, run);
+			i += run;
+		}
+	}
+	return found;
+}
+
+
+lirc_t audio_demod_idle(const struct audio_demod* d)
+{
+	long long usec;
+
+	if (d->sample_count > COUNT_HOLD_HIGH)
+		return 0;
+	usec = ((long long)d->sample_count * d->mulconst) >> 16;
+	return usec > PULSE_MASK ? PULSE_MASK : usec;
+}
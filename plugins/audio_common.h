@@ -0,0 +1,89 @@
+/****************************************************************************
+ ** audio_common.h **********************************************************
+ ****************************************************************************
+ *
+ * Sample-to-edge demodulator used by the audio_alsa driver.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef AUDIO_COMMON_H
+#define AUDIO_COMMON_H
+
+#include <stddef.h>
+
+#include "lirc_driver.h"
+
+/** Sample layouts understood by audio_demod_extract(). */
+enum audio_demod_format {
+	AUDIO_DEMOD_U8,
+	AUDIO_DEMOD_S8,
+	AUDIO_DEMOD_S16_LE
+};
+
+/**
+ * State of one receiver, i. e. one audio channel. All fields are
+ * private to audio_common.c except sample_count, which tells how long
+ * the current pulse or space has lasted (in samples, 24.8 fixed point).
+ */
+struct audio_demod {
+	/** Previous sample */
+	unsigned char	ps;
+	/** Signal maximum and minimum (used for "zero" detection) */
+	unsigned char	signal_max;
+	unsigned char	signal_min;
+	/** Non-zero if we're in zero crossing waiting state */
+	unsigned char	waiting_zerox;
+	/** Current signal level (dynamically changes) */
+	unsigned	signal_level;
+	/** Current state (pulse or space) */
+	lirc_t		signal_state;
+	/** Samples with similar level, 24.8 fixed point */
+	unsigned	sample_count;
+	/** Sample count to microseconds multiplier, 24.8 fixed point */
+	unsigned	mulconst;
+	/** Maximal sample count which can be multiplied by mulconst */
+	unsigned	maxcount;
+};
+
+/** Set up d for the given sampling rate and reset it. */
+void audio_demod_init(struct audio_demod* d, unsigned rate);
+
+/** Forget the signal history, e. g. after an overrun. */
+void audio_demod_reset(struct audio_demod* d);
+
+/**
+ * Convert frames of interleaved samples to the unsigned 8-bit samples
+ * of one channel, stored in out[0..frames - 1].
+ */
+void audio_demod_extract(unsigned char* out, const void* in, size_t frames,
+			 enum audio_demod_format format,
+			 unsigned channels, unsigned channel);
+
+/**
+ * Run the demodulator over n unsigned 8-bit samples. Each detected
+ * pulse or space is stored in edges, which must have room for n items.
+ * Returns the number of items stored. The result is identical to
+ * feeding the samples one by one; runs of samples which cannot change
+ * the state are skipped in bulk.
+ */
+size_t audio_demod_run(struct audio_demod* d, const unsigned char* samples,
+		       size_t n, lirc_t* edges);
+
+/** Microseconds since the last edge reported by d. */
+lirc_t audio_demod_idle(const struct audio_demod* d);
+
+#endif
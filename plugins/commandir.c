@@ -14,6 +14,7 @@
 
 #include "lirc_driver.h"
 #include "lirc/lirc_driver.h"
+#include "lirc/rx_ring.h"
 
 
 /****************************************************************************
@@ -410,15 +411,14 @@ struct detected_commandir {
 	struct detected_commandir*	next;
 };
 
-static int child_pipe_write = 0;
 static char haveInited = 0;
 
 // 'commandir' event signal values
 static unsigned int signal_base[2][2] = { { 100 | PULSE_BIT,  200 },
 					  { 1000 | PULSE_BIT, 200 } };
 
-// Pipes to and from the child/parent
-static int pipe_fd[2] = { -1, -1 };
+// Received data from the child, and a pipe to the child
+static struct rx_ring* rx_ring = NULL;
 
 static pid_t child_pid = -1;
 static int pipe_tochild[2] = { -1, -1 };
@@ -460,14 +460,15 @@ static int commandir_init(void)
 	send_buffer_init();     // LIRC's send
 
 	/* A separate process will be forked to read data from the USB
-	 * receiver and write it to a pipe. drv.fd is set to the readable
-	 * end of this pipe. */
-	if (pipe(pipe_fd) != 0) {
-		logprintf(LIRC_ERROR, "couldn't open pipe 1");
+	 * receiver and put it into a shared ring. drv.fd is set to the
+	 * ring's descriptor. */
+	rx_ring = rx_ring_new(RX_BUFFER_SIZE * 8);
+	if (rx_ring == NULL) {
+		logprintf(LIRC_ERROR, "couldn't create receive ring");
 		return 0;
 	}
 
-	drv.fd = pipe_fd[0];    // the READ end of the Pipe
+	drv.fd = rx_ring_fd(rx_ring);
 
 	if (pipe(pipe_tochild) != 0) {
 		logprintf(LIRC_ERROR, "couldn't open pipe 1");
@@ -484,12 +485,11 @@ static int commandir_init(void)
 	}
 
 	signal(SIGTERM, shutdown_usb);  // Set early so child can catch this
-	child_pid = fork();
+	child_pid = rx_ring_fork(rx_ring);
 	if (child_pid == -1) {
 		logprintf(LIRC_ERROR, "couldn't fork child process");
 		return 0;
 	} else if (child_pid == 0) {
-		child_pipe_write = pipe_fd[1];
 		commandir_child_init();
 		commandir_read_loop();
 		return 0;
@@ -501,6 +501,36 @@ static int commandir_init(void)
 	return 1;
 }
 
+/* Stop the child process and release the pipe and ring. */
+static void close_child(void)
+{
+	if (tochild_read >= 0) {
+		if (close(tochild_read) < 0) {
+			logprintf(LIRC_ERROR, "Error closing pipe2");
+		}
+		tochild_read = tochild_write = -1;
+	}
+
+	if (haveInited) {
+		// shutdown all USB
+		if (child_pid > 0) {
+			logprintf(LIRC_ERROR, "Closing child process");
+			kill(child_pid, SIGTERM);
+			waitpid(child_pid, NULL, 0);
+			child_pid = -1;
+			haveInited = 0;
+		}
+	}
+
+	if (rx_ring != NULL) {
+		rx_ring_free(rx_ring);
+		rx_ring = NULL;
+		drv.fd = -1;
+	}
+
+	logprintf(LIRC_ERROR, "commandir_deinit()");
+}
+
 static int commandir_deinit(void)
 {
 	/* Trying something a bit new with this driver. Keeping the driver
@@ -511,31 +541,7 @@ static int commandir_deinit(void)
 		chk_write(tochild_write, deinit_char, 3);
 		logprintf(LIRC_ERROR, "LIRC_deinit but keeping warm");
 	} else {
-		if (tochild_read >= 0) {
-			if (close(tochild_read) < 0) {
-				logprintf(LIRC_ERROR, "Error closing pipe2");
-			}
-			tochild_read = tochild_write = -1;
-		}
-
-		if (haveInited) {
-			// shutdown all USB
-			if (child_pid > 0) {
-				logprintf(LIRC_ERROR, "Closing child process");
-				kill(child_pid, SIGTERM);
-				waitpid(child_pid, NULL, 0);
-				child_pid = -1;
-				haveInited = 0;
-			}
-		}
-
-		if (drv.fd >= 0) {
-			if (close(drv.fd) < 0)
-				logprintf(LIRC_ERROR, "Error closing pipe");
-			drv.fd = -1;
-		}
-
-		logprintf(LIRC_ERROR, "commandir_deinit()");
+		close_child();
 	}
 	return 1;
 }
@@ -626,26 +632,28 @@ static int commandir_ioctl(unsigned int cmd, void* arg)
 static lirc_t commandir_readdata(lirc_t timeout)
 {
 	lirc_t code = 0;
+	int r;
 
-	if (!waitfordata(timeout / 2))
+	if (rx_ring == NULL)
+		return -1;
+	r = rx_ring_wait(rx_ring, timeout / 2);
+	if (r == 0)
 		return 0;
 
 	/* if we failed to get data return 0 */
 	/* Keep trying if we are mode2, but return immediately if we are the others */
-	if (strncmp(progname, "mode2", 5) == 0) {
-		while (code == 0) {
-			if (read(drv.fd, &code, sizeof(lirc_t)) <= 0) {
-				commandir_deinit();
-				return -1;
-			}
-		}
-	} else {
-		if (read(drv.fd, &code, sizeof(lirc_t)) <= 0) {
-			commandir_deinit();
-			return -1;
-		}
+	while (r == 1) {
+		rx_ring_get(rx_ring, &code, 1);
+		if (code != 0 || strncmp(progname, "mode2", 5) != 0)
+			return code;
+		r = rx_ring_wait(rx_ring, 0);
 	}
-	return code;
+	/* the child reading the device is gone, keeping warm is no option */
+	if (r == -1) {
+		close_child();
+		return -1;
+	}
+	return 0;
 }
 
 /***  End of parent fork / LIRC accessible functions  */
@@ -1317,6 +1325,8 @@ static void commandir_read_loop(void)
 		while ((commandir_read() > 63) && (repeats-- > 0)) {
 			// Don't remove this loop, need to call commandir_read()
 		}
+		// Wake up lircd once for everything read above
+		rx_ring_flush(rx_ring);
 		if (repeats > 0) {
 			// once in a while, but never while we're receiving a signal
 			if (++periodic_checks > 100) {
@@ -1611,13 +1621,23 @@ static int check_irsend_commandir(unsigned char* command)
 
 /*** CommandIR RX Functions ***/
 
-static void lirc_pipe_write(lirc_t* one_item)
+/* Queue items for lircd. Like write(2), return bytes stored or -1. */
+static int lirc_ring_write(const lirc_t* items, int count)
 {
-	int bytes_w;            // Pipe write
+	int i;
 
-	bytes_w = write(child_pipe_write, one_item, sizeof(lirc_t));
-	if (bytes_w < 0)
-		logprintf(LIRC_ERROR, "Can't write to LIRC pipe! %d", child_pipe_write);
+	for (i = 0; i < count; i++) {
+		if (!rx_ring_put(rx_ring, items[i])) {
+			logprintf(LIRC_ERROR, "LIRC receive ring full");
+			return -1;
+		}
+	}
+	return count * sizeof(lirc_t);
+}
+
+static void lirc_pipe_write(lirc_t* one_item)
+{
+	lirc_ring_write(one_item, 1);
 }
 
 static int commandir_read(void)
@@ -1714,10 +1734,8 @@ static int commandir_read(void)
 				if (zeroterminated > 1001) {
 					if (insert_fast_zeros > 0) {
 						//tmp4 = write(...)
-						chk_write(child_pipe_write,
-							  lirc_zero_buffer,
-							  sizeof(lirc_t)
-							  * insert_fast_zeros);
+						lirc_ring_write(lirc_zero_buffer,
+								insert_fast_zeros);
 					}
 					zeroterminated = 0;
 				} else {
@@ -2127,10 +2145,10 @@ static int cmdir_convert_RX(unsigned char* orig_rxbuffer)
 	}
 	last_mc_time = asint1;
 
-	bytes_w = write(child_pipe_write, lirc_data_buffer, sizeof(lirc_t) * num_data_values);
+	bytes_w = lirc_ring_write(lirc_data_buffer, num_data_values);
 
 	if (bytes_w < 0) {
-		logprintf(LIRC_ERROR, "Can't write to LIRC pipe! %d", child_pipe_write);
+		logprintf(LIRC_ERROR, "Can't write to LIRC receive ring!");
 		goto done;
 	}
 
@@ -2202,10 +2220,8 @@ static void commandir3_convert_RX(unsigned char* rxBuffer, int numNewValues)
 				break;
 			case USB_NO_DATA_BYTE:
 				//read_num = write(..)
-				chk_write(child_pipe_write,
-					  lirc_zero_buffer,
-					  sizeof(lirc_t)
-					  * insert_fast_zeros);
+				lirc_ring_write(lirc_zero_buffer,
+						insert_fast_zeros);
 				mySize = 0;
 				break;
 			default:
@@ -2333,10 +2349,10 @@ static int commandir2_convert_RX(unsigned short* bufferrx, unsigned char numvalu
 			break;
 	}
 
-	bytes_w = write(child_pipe_write, lirc_data_buffer, sizeof(lirc_t) * i);
+	bytes_w = lirc_ring_write(lirc_data_buffer, i);
 
 	if (bytes_w < 0) {
-		logprintf(LIRC_ERROR, "Can't write to LIRC pipe! %d", child_pipe_write);
+		logprintf(LIRC_ERROR, "Can't write to LIRC receive ring!");
 		return 0;
 	}
 	return bytes_w;
@@ -2444,8 +2460,8 @@ static void raise_event(unsigned int eventid)
 
 	event_data[16] = LIRCCODE_GAP * 4;
 
-	bytes_w = write(child_pipe_write, event_data, sizeof(lirc_t) * 17);
+	bytes_w = lirc_ring_write(event_data, 17);
 
 	if (bytes_w < 0)
-		logprintf(LIRC_ERROR, "Can't write to LIRC pipe! %d", child_pipe_write);
+		logprintf(LIRC_ERROR, "Can't write to LIRC receive ring!");
 }
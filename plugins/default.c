@@ -50,6 +50,7 @@ static int default_send(struct ir_remote* remote, struct ir_ncode* code);
 static char* default_rec(struct ir_remote* remotes);
 static int default_ioctl(unsigned int cmd, void* arg);
 static lirc_t default_readdata(lirc_t timeout);
+static int default_readdata_batch(lirc_t* buf, size_t n, lirc_t timeout);
 
 
 
@@ -69,9 +70,10 @@ static const const struct driver hw_default = {
 	.decode_func	= receive_decode,
 	.drvctl_func	= default_ioctl,
 	.readdata	= default_readdata,
-	.api_version	= 2,
+	.api_version	= 3,
 	.driver_version = "0.9.2",
-	.info		= "No info available"
+	.info		= "No info available",
+	.readdata_batch = default_readdata_batch
 };
 
 
@@ -91,6 +93,21 @@ static int write_send_buffer(int lirc);
 * decode stuff
 *
 **********************************************************************/
+/* Replace 0 (which means timeout to the caller) by 1. */
+static lirc_t valid_data(lirc_t data)
+{
+	if (data == 0) {
+		static int data_warning = 1;
+
+		if (data_warning) {
+			logprintf(LIRC_WARNING, "read invalid data from device %s", drv.device);
+			data_warning = 0;
+		}
+		data = 1;
+	}
+	return data;
+}
+
 int default_readdata(lirc_t timeout)
 {
 	int data, ret;
@@ -107,16 +124,29 @@ int default_readdata(lirc_t timeout)
 		return 0;
 	}
 
-	if (data == 0) {
-		static int data_warning = 1;
+	return valid_data(data);
+}
 
-		if (data_warning) {
-			logprintf(LIRC_WARNING, "read invalid data from device %s", drv.device);
-			data_warning = 0;
-		}
-		data = 1;
+/* Like default_readdata(), but read all items available at once. */
+static int default_readdata_batch(lirc_t* buf, size_t n, lirc_t timeout)
+{
+	int ret, i;
+
+	if (!waitfordata((long)timeout))
+		return 0;
+
+	ret = read(drv.fd, buf, n * sizeof(lirc_t));
+	if (ret <= 0 || ret % sizeof(lirc_t) != 0) {
+		logperror(LIRC_ERROR, "error reading from %s (ret %d)",
+			  drv.device, ret);
+		default_deinit();
+
+		return 0;
 	}
-	return data;
+	n = ret / sizeof(lirc_t);
+	for (i = 0; i < (int)n; i++)
+		buf[i] = valid_data(buf[i]);
+	return n;
 }
 
 /*
@@ -59,6 +59,7 @@ static int open_func(const char* path);
 static int close_func(void);
 static int decode_func(struct ir_remote* remote, struct decode_ctx_t* ctx);
 static lirc_t readdata(lirc_t timeout);
+static int readdata_batch(lirc_t* buf, size_t n, lirc_t timeout);
 static int drvctl_func(unsigned int cmd, void* arg);
 
 
@@ -78,10 +79,11 @@ const struct driver drv_test = {
 	.decode_func	= decode_func,
 	.drvctl_func	= drvctl_func,
 	.readdata	= readdata,
-	.api_version	= 2,
+	.api_version	= 3,
 	.driver_version = "0.9.2",
 	.info		= "test driver which logs received data to file, and"
-			  " optionally sends data from an input file."
+			  " optionally sends data from an input file.",
+	.readdata_batch = readdata_batch
 };
 
 
@@ -93,6 +95,7 @@ static FILE* infile = NULL;
 static int outfile_fd = -1;
 static int lineno = 1;
 static int at_eof = 0;
+static int zero_pending = 0;
 
 static int decode_func(struct ir_remote* remote, struct decode_ctx_t* ctx)
 {
@@ -141,6 +144,40 @@ static lirc_t readdata(lirc_t timeout)
 };
 
 
+/*
+ * Read lines up to the end of input, which is only reported first in a
+ * batch, as is a bad line (0) so the caller sees the same sequence as
+ * from readdata().
+ */
+static int readdata_batch(lirc_t* buf, size_t n, lirc_t timeout)
+{
+	size_t i;
+	int c;
+
+	if (zero_pending) {
+		zero_pending = 0;
+		return 0;
+	}
+	buf[0] = readdata(timeout);
+	if (buf[0] == 0)
+		return 0;
+	for (i = 1; i < n && !(buf[i - 1] & LIRC_EOF); i++) {
+		if (infile == NULL)
+			break;
+		c = getc(infile);
+		if (c == EOF)
+			break;
+		ungetc(c, infile);
+		buf[i] = readdata(timeout);
+		if (buf[i] == 0) {
+			zero_pending = 1;
+			break;
+		}
+	}
+	return i;
+}
+
+
 static int open_func(const char* device)
 {
 	if (device == NULL)
@@ -255,6 +292,7 @@ static int drvctl_func(unsigned int cmd, void* arg)
 				return DRV_ERR_BAD_OPTION;
 			drv.fd = fileno(infile);
 			lineno = 1;
+			zero_pending = 0;
 			snprintf(buff, sizeof(buff), open_msg, opt->value);
 			chk_write(outfile_fd, buff, strlen(buff));
 			return 0;
@@ -45,6 +45,7 @@
 #include <signal.h>
 
 #include "lirc_driver.h"
+#include "lirc/rx_ring.h"
 
 #include <ftdi.h>
 
@@ -53,6 +54,7 @@ static pid_t child_pid = -1;
 
 #define RXBUFSZ         2048
 #define TXBUFSZ         65536
+#define RINGSZ          8192
 
 static char* device_config = NULL;
 static int tx_baud_rate = 65536;
@@ -70,6 +72,9 @@ static __u32 rxctr = 0;
 static int pipe_main2tx[2] = { -1, -1 };
 static int pipe_tx2main[2] = { -1, -1 };
 
+/* Received pulses and spaces, from the child process to lircd */
+static struct rx_ring* ring = NULL;
+
 #if 0
 static lirc_t time_left(struct timeval* current, struct timeval* last, lirc_t gap)
 {
@@ -83,7 +88,7 @@ static lirc_t time_left(struct timeval* current, struct timeval* last, lirc_t ga
 }
 #endif
 
-static void parsesamples(unsigned char* buf, int n, int pipe_rxir_w)
+static void parsesamples(unsigned char* buf, int n)
 {
 	int i;
 	lirc_t usecs;
@@ -111,7 +116,7 @@ static void parsesamples(unsigned char* buf, int n, int pipe_rxir_w)
 			usecs |= PULSE_BIT;
 
 		/* Send the sample */
-		chk_write(pipe_rxir_w, &usecs, sizeof(usecs));
+		rx_ring_put(ring, usecs);
 
 		/* Remember last state */
 		laststate = curstate;
@@ -119,7 +124,7 @@ static void parsesamples(unsigned char* buf, int n, int pipe_rxir_w)
 	}
 }
 
-static void child_process(int fd_rx2main, int fd_main2tx, int fd_tx2main)
+static void child_process(int fd_main2tx, int fd_tx2main)
 {
 	int ret = 0;
 	struct ftdi_context ftdic;
@@ -192,8 +197,10 @@ static void child_process(int fd_rx2main, int fd_main2tx, int fd_tx2main)
 
 			/* receive IR */
 			ret = ftdi_read_data(&ftdic, buf, RXBUFSZ);
-			if (ret > 0)
-				parsesamples(buf, ret, fd_rx2main);
+			if (ret > 0) {
+				parsesamples(buf, ret);
+				rx_ring_flush(ring);
+			}
 		} while (ret > 0);
 
 retry:
@@ -205,7 +212,6 @@ retry:
 static int hwftdi_init(void)
 {
 	int flags;
-	int pipe_rx2main[2] = { -1, -1 };
 	unsigned char buf[1];
 
 	char* p;
@@ -264,9 +270,10 @@ next:
 
 	rec_buffer_init();
 
-	/* Allocate a pipe for lircd to read from */
-	if (pipe(pipe_rx2main) == -1) {
-		logprintf(LIRC_ERROR, "unable to create pipe_rx2main");
+	/* Allocate a ring for lircd to read from */
+	ring = rx_ring_new(RINGSZ);
+	if (ring == NULL) {
+		logprintf(LIRC_ERROR, "unable to create receive ring");
 		goto fail_start;
 	}
 	if (pipe(pipe_main2tx) == -1) {
@@ -278,15 +285,7 @@ next:
 		goto fail_tx2main;
 	}
 
-	drv.fd = pipe_rx2main[0];
-
-	flags = fcntl(drv.fd, F_GETFL);
-
-	/* make the read end of the pipe non-blocking: */
-	if (fcntl(drv.fd, F_SETFL, flags | O_NONBLOCK) == -1) {
-		logprintf(LIRC_ERROR, "unable to make pipe read end non-blocking");
-		goto fail;
-	}
+	drv.fd = rx_ring_fd(ring);
 
 	/* Make the read end of the send pipe non-blocking */
 	flags = fcntl(pipe_main2tx[0], F_GETFL);
@@ -296,20 +295,18 @@ next:
 	}
 
 	/* Spawn the child process */
-	child_pid = fork();
+	child_pid = rx_ring_fork(ring);
 	if (child_pid == -1) {
 		logprintf(LIRC_ERROR, "unable to fork child process");
 		goto fail;
 	} else if (child_pid == 0) {
 		/* we're the child: */
-		close(pipe_rx2main[0]);
 		close(pipe_main2tx[1]);
 		close(pipe_tx2main[0]);
-		child_process(pipe_rx2main[1], pipe_main2tx[0], pipe_tx2main[1]);
+		child_process(pipe_main2tx[0], pipe_tx2main[1]);
 	}
 
 	/* we're the parent: */
-	close(pipe_rx2main[1]);
 	close(pipe_main2tx[0]);
 	pipe_main2tx[0] = -1;
 	close(pipe_tx2main[1]);
@@ -335,8 +332,8 @@ fail_tx2main:
 	pipe_main2tx[1] = -1;
 
 fail_main2tx:
-	close(pipe_rx2main[0]);
-	close(pipe_rx2main[1]);
+	rx_ring_free(ring);
+	ring = NULL;
 
 fail_start:
 	if (device_config != NULL) {
@@ -358,7 +355,8 @@ static int hwftdi_deinit(void)
 		child_pid = -1;
 	}
 
-	close(drv.fd);
+	rx_ring_free(ring);
+	ring = NULL;
 	drv.fd = -1;
 
 	close(pipe_main2tx[1]);
@@ -381,17 +379,31 @@ static char* hwftdi_rec(struct ir_remote* remotes)
 
 static lirc_t hwftdi_readdata(lirc_t timeout)
 {
-	int n;
 	lirc_t res = 0;
+	int r;
 
-	if (!waitfordata((long)timeout))
+	if (ring == NULL)
 		return 0;
+	r = rx_ring_wait(ring, timeout);
+	if (r == -1)
+		hwftdi_deinit();
+	else if (r == 1)
+		rx_ring_get(ring, &res, 1);
+	return res;
+}
 
-	n = read(drv.fd, &res, sizeof(res));
-	if (n != sizeof(res))
-		res = 0;
+static int hwftdi_readdata_batch(lirc_t* buf, size_t n, lirc_t timeout)
+{
+	int r;
 
-	return res;
+	if (ring == NULL)
+		return 0;
+	r = rx_ring_wait(ring, timeout);
+	if (r == -1)
+		hwftdi_deinit();
+	if (r != 1)
+		return 0;
+	return rx_ring_get(ring, buf, n);
 }
 
 static int hwftdi_send(struct ir_remote* remote, struct ir_ncode* code)
@@ -501,9 +513,10 @@ const struct driver hw_ftdi = {
 	.decode_func	= receive_decode,
 	.drvctl_func	= hwftdi_ioctl,
 	.readdata	= hwftdi_readdata,
-	.api_version	= 2,
+	.api_version	= 3,
 	.driver_version = "0.9.2",
-	.info		= "No info available"
+	.info		= "No info available",
+	.readdata_batch = hwftdi_readdata_batch
 };
 
 const struct driver* hardwares[] = { &hw_ftdi, (const struct driver*)NULL };
@@ -28,6 +28,7 @@
 #include <arpa/inet.h>
 
 #include "lirc_driver.h"
+#include "lirc/rx_ring.h"
 
 #include "iguanaIR.h"
 static int sendConn = -1;
@@ -35,12 +36,15 @@ static pid_t child = 0;
 static int recvDone = 0;
 static int currentCarrier = -1;
 
+/* Received pulses and spaces, from the child process to lircd */
+static struct rx_ring* ring = NULL;
+
 static void quitHandler(int sig)
 {
 	recvDone = 1;
 }
 
-static void recv_loop(int fd, int notify)
+static void recv_loop(int notify)
 {
 	int conn;
 
@@ -117,9 +121,9 @@ static void recv_loop(int fd, int notify)
 
 					/* write the data and free it */
 					if (y > 0) {
-						chk_write(fd,
-							  buffer,
-							  sizeof(lirc_t) * y);
+						for (x = 0; x < y; x++)
+							rx_ring_put(ring, buffer[x]);
+						rx_ring_flush(ring);
 					}
 					free(code);
 				}
@@ -132,39 +136,38 @@ static void recv_loop(int fd, int notify)
 	}
 
 	iguanaClose(conn);
-	close(fd);
 }
 
 static int iguana_init(void)
 {
-	int recv_pipe[2], retval = 0;
+	int retval = 0;
 
 	rec_buffer_init();
 
-	if (pipe(recv_pipe) != 0) {
-		logprintf(LIRC_ERROR, "couldn't open pipe: %s", strerror(errno));
+	/* As much as the 64 kB pipe used before, to survive bursts */
+	ring = rx_ring_new(65536 / sizeof(lirc_t));
+	if (ring == NULL) {
+		logprintf(LIRC_ERROR, "couldn't create receive ring");
 	} else {
 		int notify[2];
 
 		if (pipe(notify) != 0) {
 			logprintf(LIRC_ERROR, "couldn't open pipe: %s", strerror(errno));
-			close(recv_pipe[0]);
-			close(recv_pipe[1]);
+			rx_ring_free(ring);
+			ring = NULL;
 		} else {
-			drv.fd = recv_pipe[0];
+			drv.fd = rx_ring_fd(ring);
 
-			child = fork();
+			child = rx_ring_fork(ring);
 			if (child == -1) {
 				logprintf(LIRC_ERROR, "couldn't fork child process: %s", strerror(errno));
 			} else if (child == 0) {
-				close(recv_pipe[0]);
 				close(notify[0]);
-				recv_loop(recv_pipe[1], notify[1]);
+				recv_loop(notify[1]);
 				_exit(0);
 			} else {
 				int dummy;
 
-				close(recv_pipe[1]);
 				close(notify[1]);
 				/* make sure child has set its signal handler to avoid race with iguana_deinit() */
 				chk_read(notify[0], &dummy, 1);
@@ -205,8 +208,9 @@ static int iguana_deinit(void)
 	if (child > 0 && (kill(child, SIGTERM) == -1 || dowaitpid(child, NULL, 0) != (pid_t)-1))
 		child = 0;
 
-	/* close drv.fd since otherwise we leak open files */
-	close(drv.fd);
+	/* release the ring since otherwise we leak open files */
+	rx_ring_free(ring);
+	ring = NULL;
 	drv.fd = -1;
 
 	return child == 0;
@@ -322,21 +326,33 @@ static int iguana_ioctl(unsigned int code, void* arg)
 static lirc_t readdata(lirc_t timeout)
 {
 	lirc_t code = 0;
-	struct timeval tv = { timeout / 1000000, timeout % 1000000 };
-	fd_set fds;
-
-	FD_ZERO(&fds);
-	FD_SET(drv.fd, &fds);
-
-	/* attempt a read with a timeout using select */
-	if (select(drv.fd + 1, &fds, NULL, &fds, &tv) > 0)
-		/* if we failed to get data return 0 */
-		if (read(drv.fd, &code, sizeof(lirc_t)) <= 0)
-			iguana_deinit();
-
+	int r;
+
+	if (ring == NULL)
+		return 0;
+	/* if we failed to get data return 0 */
+	r = rx_ring_wait(ring, timeout);
+	if (r == -1)
+		iguana_deinit();
+	else if (r == 1)
+		rx_ring_get(ring, &code, 1);
 	return code;
 }
 
+static int readdata_batch(lirc_t* buf, size_t n, lirc_t timeout)
+{
+	int r;
+
+	if (ring == NULL)
+		return 0;
+	r = rx_ring_wait(ring, timeout);
+	if (r == -1)
+		iguana_deinit();
+	if (r != 1)
+		return 0;
+	return rx_ring_get(ring, buf, n);
+}
+
 const struct driver hw_iguanaIR = {
 	.name		= "iguanaIR",
 	.device		= "0",
@@ -356,9 +372,10 @@ const struct driver hw_iguanaIR = {
 	.decode_func	= receive_decode,
 	.drvctl_func	= iguana_ioctl,
 	.readdata	= readdata,
-	.api_version	= 2,
+	.api_version	= 3,
 	.driver_version = "0.9.2",
-	.info		= "No info available"
+	.info		= "No info available",
+	.readdata_batch = readdata_batch
 };
 
 const struct driver* hardwares[] = { &hw_iguanaIR, (const struct driver*)NULL };
@@ -292,6 +292,28 @@ lirc_t udp_readdata(lirc_t timeout)
 	return data;
 }
 
+/**
+ * Read all data left from the last datagram, waiting for a new one
+ * if there is none.
+ * \param buf      Buffer for IR timing data in lirc mode2 format.
+ * \param n        Size of buf.
+ * \param timeout  Time to wait for data.
+ * \return         Number of items stored in buf.
+ */
+int udp_readdata_batch(lirc_t* buf, size_t n, lirc_t timeout)
+{
+	size_t i = 0;
+	lirc_t data;
+
+	do {
+		data = udp_readdata(timeout);
+		if (data == 0)
+			break;
+		buf[i++] = data;
+	} while (i < n && drv.fd == zerofd);
+	return i;
+}
+
 const struct driver hw_udp = {
 	.name		=	"udp",
 	.device		=	"8765",
@@ -309,10 +331,11 @@ const struct driver hw_udp = {
 	.drvctl_func	=	udp_drvctl_func,
 	.readdata	=	udp_readdata,
 	.resolution	=	61,
-	.api_version	=	2,
+	.api_version	=	3,
 	.driver_version =	"0.9.2",
 	.info		=	"UDP driver receives IR mark and space time measurements on a UDP port and"
-				"converts them to LIRC mode2 format."
+				"converts them to LIRC mode2 format.",
+	.readdata_batch =	udp_readdata_batch
 };
 
 const struct driver* hardwares[] = { &hw_udp, (const struct driver*)NULL };
@@ -3,6 +3,8 @@
 
 #include	<stdio.h>
 #include	<signal.h>
+#include	<fcntl.h>
+#include	<poll.h>
 #include 	<netinet/in.h>
 #include	<sys/socket.h>
 #include	<sys/types.h>
@@ -52,8 +54,11 @@ class ClientTest : public CppUnit::TestFixture
             ADD_TEST("testReadConfigOnly", testReadConfigOnly);
             ADD_TEST("testReadConfigNew", testReadConfigNew);
             ADD_TEST("testCode2Char", testCode2Char);
+            ADD_TEST("testCode2CharSequence", testCode2CharSequence);
             ADD_TEST("testSetMode", testSetMode);
             ADD_TEST("testGetMode", testSetMode);
+            ADD_TEST("testEventFrames", testEventFrames);
+            ADD_TEST("testCommandPipe", testCommandPipe);
             return testSuite;
         };
 
@@ -248,6 +253,38 @@ class ClientTest : public CppUnit::TestFixture
         }
 
 
+        string allChars(struct lirc_config* config, const char* code)
+        // All strings lirc_code2char() returns for code, comma-separated.
+        {
+            string result;
+            char* chars;
+
+            while (lirc_code2char(config, (char*) code, &chars) == 0
+                   && chars != NULL)
+                result += (result.empty() ? "" : ",") + string(chars);
+            return result;
+        }
+
+
+        void testCode2CharSequence()
+        {
+            struct lirc_config* config;
+
+            CPPUNIT_ASSERT(
+                lirc_readconfig_only("etc/sequence.lircrc", &config, NULL) == 0);
+            CPPUNIT_ASSERT(allChars(config, "0 00 C r2\n") == "anyc");
+            CPPUNIT_ASSERT(allChars(config, "0 00 B r1\n") == "");
+            CPPUNIT_ASSERT(allChars(config, "0 01 B r1\n") == "");
+            CPPUNIT_ASSERT(allChars(config, "0 00 C r1\n") == "bc,anyc");
+            CPPUNIT_ASSERT(allChars(config, "0 00 b R1\n") == "");
+            CPPUNIT_ASSERT(allChars(config, "0 00 X r1\n") == "");
+            CPPUNIT_ASSERT(allChars(config, "0 00 C r1\n") == "anyc");
+            CPPUNIT_ASSERT(allChars(config, "0 00 D r3\n") == "tomode,m1any");
+            CPPUNIT_ASSERT(allChars(config, "0 00 E r3\n") == "m1any");
+            lirc_freeconfig(config);
+        }
+
+
         void testSetMode()
         {
             struct lirc_config* config;
@@ -289,6 +326,123 @@ class ClientTest : public CppUnit::TestFixture
 
 
 
+        void putFrame(string* s, int type, const void* data, int len)
+        {
+            struct lirc_frame_hdr hdr;
+
+            hdr.type = type;
+            hdr.len = len;
+            s->append((const char*) &hdr, sizeof(hdr));
+            s->append((const char*) data, len);
+        }
+
+        void testEventFrames()
+        // Feed a canned SET_EVENT_FORMAT reply and frames to the client.
+        {
+            const char* reply =
+                "BEGIN\nSET_EVENT_FORMAT BINARY 1\nSUCCESS\nEND\n";
+            struct lirc_frame_event ev;
+            struct lirc_event event;
+            lirc_event_ctx ctx;
+            string s(reply);
+            char name[64];
+            uint32_t id;
+            int sv[2];
+
+            CPPUNIT_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+            id = 1;
+            memcpy(name, &id, sizeof(id));
+            strcpy(name + sizeof(id), "remote");
+            putFrame(&s, LIRC_FRAME_NAME, name, sizeof(id) + 7);
+            id = 0;
+            memcpy(name, &id, sizeof(id));
+            strcpy(name + sizeof(id), "KEY_OK");
+            putFrame(&s, LIRC_FRAME_NAME, name, sizeof(id) + 7);
+            putFrame(&s, LIRC_FRAME_TEXT, "BEGIN\nSIGHUP\nEND\n", 18);
+            memset(&ev, 0, sizeof(ev));
+            ev.code = 0x42;
+            ev.remote_id = 1;
+            ev.button_id = 0;
+            ev.reps = 3;
+            ev.flags = LIRC_EVENT_RELEASE;
+            putFrame(&s, LIRC_FRAME_EVENT, &ev, sizeof(ev));
+            CPPUNIT_ASSERT(write(sv[1], s.data(), s.size()) == s.size());
+
+            CPPUNIT_ASSERT(lirc_event_start(&ctx, sv[0]) == 0);
+            CPPUNIT_ASSERT(lirc_event_read(&ctx, &event) == 1);
+            CPPUNIT_ASSERT(string(event.remote) == "remote");
+            CPPUNIT_ASSERT(string(event.button) == "KEY_OK");
+            CPPUNIT_ASSERT(event.code == 0x42);
+            CPPUNIT_ASSERT(event.reps == 3 && event.release);
+            fcntl(sv[0], F_SETFL, O_NONBLOCK);
+            CPPUNIT_ASSERT(lirc_event_read(&ctx, &event) == 0);
+            lirc_event_free(&ctx);
+            close(sv[0]);
+            close(sv[1]);
+        }
+
+        void testCommandPipe()
+        // Keep the pipe full of LIST commands, some of them failing.
+        {
+            static const char* const keys[] =
+                { "KEY_POWER", "KEY_DVD", "KEY_RECORD", "KEY_NONE" };
+            const int total = 500;
+            lirc_cmd_ctx cmds[LIRC_PIPE_SIZE];
+            int key[LIRC_PIPE_SIZE];
+            int slots[LIRC_PIPE_SIZE];
+            lirc_cmd_pipe ctx;
+            lirc_cmd_ctx* cmd;
+            struct pollfd pfd;
+            int submitted = 0;
+            int done = 0;
+            int nslots;
+            int slot;
+            int status;
+            int sockfd;
+            int r;
+
+            sockfd = lirc_get_local_socket("var/lircd.socket", 0);
+            CPPUNIT_ASSERT(sockfd >= 0);
+            fcntl(sockfd, F_SETFL, O_NONBLOCK);
+            lirc_command_pipe(&ctx, sockfd);
+            for (nslots = 0; nslots < LIRC_PIPE_SIZE; nslots++)
+                slots[nslots] = nslots;
+            while (done < total) {
+                while (submitted < total && nslots > 0) {
+                    slot = slots[--nslots];
+                    key[slot] = submitted++ % 4;
+                    lirc_command_init(&cmds[slot],
+                                      "LIST Acer_Aspire_6530G_MCE %s\n",
+                                      keys[key[slot]]);
+                    CPPUNIT_ASSERT(
+                        lirc_command_submit(&ctx, &cmds[slot]) == 0);
+                }
+                pfd.fd = sockfd;
+                pfd.events = lirc_command_events(&ctx);
+                CPPUNIT_ASSERT(poll(&pfd, 1, 5000) == 1);
+                if (pfd.revents & POLLOUT)
+                    CPPUNIT_ASSERT(lirc_command_flush(&ctx) == 0);
+                if (!(pfd.revents & POLLIN))
+                    continue;
+                while ((r = lirc_command_reply(&ctx, &cmd, &status)) == 1) {
+                    slot = cmd - cmds;
+                    if (key[slot] == 3) {
+                        CPPUNIT_ASSERT(status == EIO);
+                    } else {
+                        CPPUNIT_ASSERT(status == 0);
+                        CPPUNIT_ASSERT(
+                            strstr(cmd->reply, keys[key[slot]]) != NULL);
+                    }
+                    slots[nslots++] = slot;
+                    done++;
+                }
+                CPPUNIT_ASSERT(r == 0);
+            }
+            CPPUNIT_ASSERT(ctx.count == 0);
+            CPPUNIT_ASSERT(lirc_command_events(&ctx) == 0);
+            close(sockfd);
+        }
+
         void testDefaults()
         {
         };
@@ -3,8 +3,15 @@
 
 #include    <iostream>
 #include    <unordered_map>
+#include    <fstream>
+#include    <vector>
 #include	<stdio.h>
+#include	<stdlib.h>
+#include	<dirent.h>
+#include	<sys/stat.h>
+#include	<sys/time.h>
 #include	"../lib/lirc_private.h"
+#include	"../lib/ir_remote_private.h"
 
 #include    <cppunit/TestFixture.h>
 #include    <cppunit/TestSuite.h>
@@ -43,6 +50,10 @@ class IrRemoteTest : public CppUnit::TestFixture
             ADD_TEST("testImplicitInclude", testImplicitInclude);
             ADD_TEST("testRawSorting", testRawSorting);
             ADD_TEST("testManualSorting", testManualSorting);
+            ADD_TEST("testCodeIndex", testCodeIndex);
+            ADD_TEST("testConfigCache", testConfigCache);
+            ADD_TEST("testBitKernel", testBitKernel);
+            ADD_TEST("testRawIndex", testRawIndex);
             return testSuite;
         };
 
@@ -174,6 +185,314 @@ class IrRemoteTest : public CppUnit::TestFixture
             CPPUNIT_ASSERT(string(last) == "Melectronic_PP3600");
         }
 
+        struct ir_remote* read_remotes(const char* path)
+        {
+            FILE* fp;
+            struct ir_remote* remotes;
+
+            fp = fopen(path, "r");
+            CPPUNIT_ASSERT(fp != NULL);
+            remotes = read_config(fp, path);
+            fclose(fp);
+            CPPUNIT_ASSERT(remotes != NULL && remotes != (void*) -1);
+            return remotes;
+        }
+
+        /** Index in remote->codes of get_code() result, -1 if none. */
+        int lookup(struct ir_remote* remote,
+                   ir_code pre, ir_code code, int repeat, ir_code* state)
+        {
+            struct ir_ncode* found;
+
+            found = get_code(remote, pre, code, remote->post_data,
+                             &repeat, state);
+            return found == NULL ? -1 : found - remote->codes;
+        }
+
+        /**
+         * Look up code in both remotes, check that the results and
+         * the sequence states agree. Returns the result.
+         */
+        int compare_lookup(struct ir_remote* indexed,
+                           struct ir_remote* linear,
+                           ir_code pre, ir_code code, int repeat)
+        {
+            ir_code state1 = 0;
+            ir_code state2 = 0;
+            int r;
+            int i;
+
+            r = lookup(indexed, pre, code, repeat, &state1);
+            CPPUNIT_ASSERT_EQUAL(r,
+                                 lookup(linear, pre, code, repeat, &state2));
+            CPPUNIT_ASSERT_EQUAL(state1, state2);
+            for (i = 0; indexed->codes[i].name != NULL; i++)
+                CPPUNIT_ASSERT_EQUAL(indexed->codes[i].current == NULL,
+                                     linear->codes[i].current == NULL);
+            return r;
+        }
+
+        void testCodeIndex()
+        {
+            static const char* const path = "etc/lircd.conf.code_index";
+            // toggle_bit_mask, ignore_mask and repeat_mask bits of the
+            // code part, and combined.
+            static const ir_code variants[] =
+                { 0, 0x8000, 0x0001, 0x4000, 0xC001 };
+            struct ir_remote* indexed;
+            struct ir_remote* linear;
+            struct ir_ncode* code;
+            struct ir_code_node* node;
+            ir_code pre;
+            unsigned int v;
+            int repeat;
+            int pass;
+
+            std_setup();
+            CPPUNIT_ASSERT(acer_config->code_index != NULL);
+            free_code_index(acer_config);
+            CPPUNIT_ASSERT(acer_config->code_index == NULL);
+
+            indexed = read_remotes(path);
+            linear = read_remotes(path);
+            CPPUNIT_ASSERT(indexed->code_index != NULL);
+            free_code_index(linear);
+            CPPUNIT_ASSERT(linear->code_index == NULL);
+            pre = indexed->pre_data;
+
+            // Masked bits select the first code in file order.
+            CPPUNIT_ASSERT_EQUAL(0, compare_lookup(indexed, linear,
+                                                   pre, 0x1231, 0));
+            CPPUNIT_ASSERT_EQUAL(4, compare_lookup(indexed, linear,
+                                                   pre ^ 0x01, 0xB000, 0));
+            CPPUNIT_ASSERT_EQUAL(7, compare_lookup(indexed, linear,
+                                                   pre, 0x0004, 0));
+            CPPUNIT_ASSERT_EQUAL(6, compare_lookup(indexed, linear,
+                                                   pre, 0x0004, 1));
+            // Missing code and bad pre data.
+            CPPUNIT_ASSERT_EQUAL(-1, compare_lookup(indexed, linear,
+                                                    pre, 0x5555, 0));
+            CPPUNIT_ASSERT_EQUAL(-1, compare_lookup(indexed, linear,
+                                                    pre ^ 0x02, 0x1230, 0));
+            // KEY_SEQ completes on its second code, KEY_B matches
+            // the first one meanwhile.
+            CPPUNIT_ASSERT_EQUAL(3, compare_lookup(indexed, linear,
+                                                   pre, 0x2000, 0));
+            CPPUNIT_ASSERT_EQUAL(2, compare_lookup(indexed, linear,
+                                                   pre, 0x2002, 0));
+
+            // Every code and sequence step in every masked variant,
+            // twice so the sequence state wraps around.
+            for (pass = 0; pass < 2; pass++) {
+                for (code = indexed->codes; code->name != NULL; code++) {
+                    for (v = 0; v < sizeof(variants) / sizeof(*variants);
+                         v++) {
+                        for (repeat = 0; repeat < 2; repeat++) {
+                            compare_lookup(indexed, linear, pre,
+                                           code->code ^ variants[v],
+                                           repeat);
+                            for (node = code->next; node != NULL;
+                                 node = node->next)
+                                compare_lookup(indexed, linear, pre,
+                                               node->code ^ variants[v],
+                                               repeat);
+                        }
+                    }
+                }
+            }
+            free_config(indexed);
+            free_config(linear);
+        }
+
+        string dump(const struct ir_remote* remotes)
+        {
+            char* buf;
+            size_t size;
+            FILE* out;
+            string s;
+
+            out = open_memstream(&buf, &size);
+            for (; remotes != NULL; remotes = remotes->next) {
+                fprint_remote_head(out, remotes);
+                fprint_remote_signals(out, remotes);
+            }
+            fclose(out);
+            s = string(buf);
+            free(buf);
+            return s;
+        }
+
+        void copy_file(const string& from, const string& to)
+        {
+            ifstream in(from.c_str(), ios::binary);
+            ofstream out(to.c_str(), ios::binary);
+
+            CPPUNIT_ASSERT(in && out);
+            out << in.rdbuf();
+            CPPUNIT_ASSERT(out.good());
+        }
+
+        /** Set access and modification time of path to age s ago. */
+        void set_age(const string& path, time_t age)
+        {
+            struct timeval tv[2];
+
+            gettimeofday(&tv[0], NULL);
+            tv[0].tv_sec -= age;
+            tv[1] = tv[0];
+            CPPUNIT_ASSERT(utimes(path.c_str(), tv) == 0);
+        }
+
+        /**
+         * Copy NAME and the files in etc/lircd.conf.d it includes to
+         * a new directory below var/. Returns the directory.
+         */
+        string copy_config(vector<string>* files)
+        {
+            char tmpl[] = "var/config-cache.XXXXXX";
+            string dir;
+            DIR* d;
+            struct dirent* ent;
+
+            CPPUNIT_ASSERT(mkdtemp(tmpl) != NULL);
+            dir = tmpl;
+            CPPUNIT_ASSERT(mkdir((dir + "/lircd.conf.d").c_str(), 0755) == 0);
+            copy_file(NAME, dir + "/lircd.conf");
+            d = opendir("etc/lircd.conf.d");
+            CPPUNIT_ASSERT(d != NULL);
+            while ((ent = readdir(d)) != NULL) {
+                if (ent->d_name[0] == '.')
+                    continue;
+                files->push_back(dir + "/lircd.conf.d/" + ent->d_name);
+                copy_file(string("etc/lircd.conf.d/") + ent->d_name,
+                          files->back());
+            }
+            closedir(d);
+            return dir;
+        }
+
+        void testConfigCache()
+        {
+            vector<string> included;
+            string dir;
+            string conf;
+            string cache;
+            struct ir_remote* cached;
+            FILE* empty;
+            unsigned int i;
+
+            std_setup();
+            dir = copy_config(&included);
+            conf = dir + "/lircd.conf";
+            cache = dir + "/config.cache";
+
+            // Recently modified files are not cached.
+            set_age(conf, 3600);
+            set_age(dir + "/lircd.conf.d", 3600);
+            for (i = 0; i < included.size(); i++)
+                set_age(included[i], 3600);
+            fclose(f);
+            f = fopen(conf.c_str(), "r");
+            cached = read_config_cached(f, conf.c_str(), cache.c_str());
+            CPPUNIT_ASSERT(access(cache.c_str(), R_OK) == 0);
+            CPPUNIT_ASSERT(dump(cached) == dump(config));
+            free_config(cached);
+
+            // A valid cache is used without reading the file.
+            empty = fopen("/dev/null", "r");
+            cached = read_config_cached(empty, conf.c_str(), cache.c_str());
+            CPPUNIT_ASSERT(cached != NULL && cached != (void*)-1);
+            CPPUNIT_ASSERT(dump(cached) == dump(config));
+            CPPUNIT_ASSERT(cached->next->code_index != NULL);
+            free_config(cached);
+
+            // ... but not if an included file has changed.
+            for (i = 0; i < included.size(); i++)
+                set_age(included[i], 60);
+            rewind(empty);
+            cached = read_config_cached(empty, conf.c_str(), cache.c_str());
+            CPPUNIT_ASSERT(cached == NULL);
+            fclose(empty);
+
+            unlink(cache.c_str());
+            unlink(conf.c_str());
+            for (i = 0; i < included.size(); i++)
+                unlink(included[i].c_str());
+            rmdir((dir + "/lircd.conf.d").c_str());
+            rmdir(dir.c_str());
+        }
+
+        bool window_matches(const struct ir_remote* remote,
+                            const struct ir_window* w, lirc_t val)
+        {
+            return expect(remote, w->min, val)
+                && !expect(remote, w->min - 1, val)
+                && expect(remote, w->max, val)
+                && !expect(remote, w->max + 1, val);
+        }
+
+        void testBitKernel()
+        {
+            struct ir_remote* irc;
+            const struct ir_bit_kernel* k;
+
+            std_setup();
+            CPPUNIT_ASSERT(acer_config->bit_kernel.type == BIT_KERNEL_GENERIC);
+            for (irc = config; irc != NULL; irc = irc->next)
+                if (string(irc->name) == "pioneer")
+                    break;
+            CPPUNIT_ASSERT(irc != NULL);
+            CPPUNIT_ASSERT(bit_kernel_is_current(irc));
+            k = &irc->bit_kernel;
+            CPPUNIT_ASSERT(k->type == BIT_KERNEL_PULSE_SPACE);
+            CPPUNIT_ASSERT(window_matches(irc, &k->pone, irc->pone));
+            CPPUNIT_ASSERT(window_matches(irc, &k->sone, irc->sone));
+            CPPUNIT_ASSERT(window_matches(irc, &k->pzero, irc->pzero));
+            CPPUNIT_ASSERT(window_matches(irc, &k->szero, irc->szero));
+
+            // Modified timings are detected.
+            irc->sone += 100;
+            CPPUNIT_ASSERT(!bit_kernel_is_current(irc));
+            set_bit_kernel(irc);
+            CPPUNIT_ASSERT(window_matches(irc, &k->sone, irc->sone));
+        }
+
+        void testRawIndex()
+        {
+            struct ir_remote* irc;
+            const struct ir_raw_node* root;
+            const struct ir_raw_node* node;
+            struct ir_ncode* code;
+            int i;
+
+            std_setup();
+            CPPUNIT_ASSERT(get_raw_index(acer_config) == NULL);
+            for (irc = config; irc != NULL; irc = irc->next)
+                if (string(irc->name) == "Melectronic_PP3600")
+                    break;
+            CPPUNIT_ASSERT(irc != NULL);
+            root = get_raw_index(irc);
+            CPPUNIT_ASSERT(root != NULL);
+            CPPUNIT_ASSERT(root->first == irc->codes);
+
+            // Each code is found along the path of its own signals.
+            for (code = irc->codes; code->name != NULL; code++) {
+                node = root;
+                for (i = 0; i < code->length; i++) {
+                    const struct ir_raw_node* child = root + node->child;
+                    int j;
+
+                    for (j = 0; j < node->n_children; j++, child++)
+                        if (code->signals[i] >= child->min
+                            && code->signals[i] <= child->max)
+                            break;
+                    CPPUNIT_ASSERT(j < node->n_children);
+                    node = child;
+                }
+                CPPUNIT_ASSERT(node->code != NULL && node->code <= code);
+            }
+        }
+
 
 };
 
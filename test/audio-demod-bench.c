@@ -0,0 +1,281 @@
+/*
+ * Compare the block demodulator in plugins/audio_common.c with the
+ * original sample-by-sample loop from audio_alsa.c.
+ *
+ * Usage: audio-demod-bench [-r rate] [-n rounds] [-o file] durations
+ *        audio-demod-bench [-r rate] [-n rounds] -p file.raw
+ *
+ * The PCM fixture is either a recording (-p: unsigned 8-bit mono, as
+ * "arecord -c1 -f U8 -t raw" writes it) or synthesized from a
+ * durations file in irsimsend's "pulse N" / "space N" format. The
+ * synthesized signal mimics an IR receiver module on a line input: a
+ * square wave with AC coupling droop and one bit of noise. -o saves it
+ * so it can be fed back with -p.
+ *
+ * Both implementations must produce identical edges; the cpu time of
+ * each is reported.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audio_common.h"
+
+#define U8_ABSDIFF(s1, s2) (((s1) >= (s2)) ? ((s1) - (s2)) : ((s2) - (s1)))
+
+/* The loop from audio_alsa.c before the block demodulator. */
+static size_t scalar_run(struct audio_demod* d, const unsigned char* buff,
+			 size_t count, lirc_t* out)
+{
+	unsigned char ps = d->ps;
+	unsigned sample_count = d->sample_count;
+	unsigned signal_level = d->signal_level;
+	unsigned signal_state = d->signal_state;
+	unsigned char signal_max = d->signal_max, signal_min = d->signal_min;
+	char waiting_zerox = d->waiting_zerox;
+	unsigned mulconst = d->mulconst;
+	unsigned maxcount = d->maxcount;
+	size_t found = 0;
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		unsigned char cs, as, sl, sz, xz;
+
+		cs = buff[i];
+		sz = (signal_min + signal_max) / 2;
+		if (cs <= sz)
+			signal_min = (signal_min * 7 + cs) / 8;
+		if (cs >= sz)
+			signal_max = (signal_max * 7 + cs) / 8;
+		as = U8_ABSDIFF(cs, sz);
+		signal_level = (signal_level * 7 + as) / 8;
+		sl = signal_level;
+		if (sl < 16)
+			sl = 16;
+		xz = ((cs - sz) ^ (ps - sz)) & 0x80;
+		if (waiting_zerox && !xz)
+			waiting_zerox--;
+		if ((abs(cs - ps) > sl / 2) && xz)
+			waiting_zerox = 2;
+		if (waiting_zerox && xz) {
+			lirc_t x;
+
+			waiting_zerox = 0;
+			if (sample_count >= maxcount) {
+				x = PULSE_MASK;
+				sample_count = 0;
+			} else {
+				int delta = (((int)sz - (int)cs) << 8) / ((int)cs - (int)ps);
+
+				x = (((long long)sample_count + delta) * mulconst) >> 16;
+				sample_count = -delta;
+			}
+			if ((x > 20000) && signal_state)
+				signal_state = 0;
+			out[found++] = x | signal_state;
+			signal_state ^= PULSE_BIT;
+		}
+		ps = cs;
+		if ((sample_count < UINT_MAX - 0x400)
+		    || (sample_count > UINT_MAX - 0x200))
+			sample_count += 0x100;
+	}
+	d->ps = ps;
+	d->sample_count = sample_count;
+	d->signal_level = signal_level;
+	d->signal_state = signal_state;
+	d->signal_max = signal_max;
+	d->signal_min = signal_min;
+	d->waiting_zerox = waiting_zerox;
+	return found;
+}
+
+
+/* Append usec of signal at the given level to pcm. */
+static size_t synth(unsigned char* pcm, size_t pos, unsigned rate,
+		    long usec, int pulse, double* droop)
+{
+	size_t n = (size_t)usec * rate / 1000000;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		double v = 0x80 + (pulse ? 100 : -100) * *droop;
+		int noise = (rand() % 8 == 0) ? rand() % 3 - 1 : 0;
+
+		/* AC coupling: the level decays towards the middle */
+		*droop *= 0.9995;
+		pcm[pos + i] = (unsigned char)(v + noise);
+	}
+	return pos + n;
+}
+
+
+static unsigned char* load_durations(const char* path, unsigned rate,
+				     size_t* size)
+{
+	FILE* f = fopen(path, "r");
+	char kind[16];
+	long usec;
+	size_t cap = rate;
+	size_t pos = 0;
+	unsigned char* pcm;
+	double droop = 0;
+	int last = -1;
+
+	if (f == NULL) {
+		perror(path);
+		exit(1);
+	}
+	pcm = malloc(cap);
+	while (fscanf(f, "%15s %ld", kind, &usec) == 2) {
+		int pulse = strcmp(kind, "pulse") == 0;
+		size_t need = pos + (size_t)usec * rate / 1000000 + 1;
+
+		if (need > cap) {
+			cap = need * 2;
+			pcm = realloc(pcm, cap);
+		}
+		if (pulse != last)
+			droop = 1.0;
+		last = pulse;
+		pos = synth(pcm, pos, rate, usec, pulse, &droop);
+	}
+	fclose(f);
+	*size = pos;
+	return pcm;
+}
+
+
+static unsigned char* load_raw(const char* path, size_t* size)
+{
+	FILE* f = fopen(path, "rb");
+	unsigned char* pcm;
+	long len;
+
+	if (f == NULL) {
+		perror(path);
+		exit(1);
+	}
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	rewind(f);
+	pcm = malloc(len);
+	if (fread(pcm, 1, len, f) != (size_t)len) {
+		perror(path);
+		exit(1);
+	}
+	fclose(f);
+	*size = len;
+	return pcm;
+}
+
+
+/* Run the demodulator over pcm in ALSA sized blocks. */
+static double run(int block, const unsigned char* pcm, size_t size,
+		  unsigned rate, int rounds, lirc_t* edges, size_t* found)
+{
+	struct audio_demod d;
+	const size_t period = 2048;
+	clock_t start = clock();
+	int r;
+	size_t i;
+
+	for (r = 0; r < rounds; r++) {
+		audio_demod_init(&d, rate);
+		*found = 0;
+		for (i = 0; i < size; i += period) {
+			size_t n = size - i < period ? size - i : period;
+
+			if (block)
+				*found += audio_demod_run(&d, pcm + i, n,
+							  edges + *found);
+			else
+				*found += scalar_run(&d, pcm + i, n,
+						     edges + *found);
+		}
+	}
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+int main(int argc, char** argv)
+{
+	unsigned rate = 96000;
+	int rounds = 20;
+	const char* raw = NULL;
+	const char* save = NULL;
+	unsigned char* pcm;
+	size_t size;
+	lirc_t* ref;
+	lirc_t* got;
+	size_t nref = 0;
+	size_t ngot = 0;
+	size_t i;
+	double tref, tgot;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "r:n:p:o:")) != -1) {
+		switch (opt) {
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		case 'n':
+			rounds = atoi(optarg);
+			break;
+		case 'p':
+			raw = optarg;
+			break;
+		case 'o':
+			save = optarg;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-r rate] [-n rounds]"
+				" [-o file] durations | -p file.raw\n", argv[0]);
+			return 1;
+		}
+	}
+	if (raw != NULL) {
+		pcm = load_raw(raw, &size);
+	} else if (optind < argc) {
+		pcm = load_durations(argv[optind], rate, &size);
+	} else {
+		fprintf(stderr, "No durations or PCM file given\n");
+		return 1;
+	}
+	if (save != NULL) {
+		FILE* f = fopen(save, "wb");
+
+		if (f == NULL || fwrite(pcm, 1, size, f) != size) {
+			perror(save);
+			return 1;
+		}
+		fclose(f);
+	}
+
+	ref = malloc(size * sizeof(lirc_t));
+	got = malloc(size * sizeof(lirc_t));
+	tref = run(0, pcm, size, rate, rounds, ref, &nref);
+	tgot = run(1, pcm, size, rate, rounds, got, &ngot);
+
+	printf("%u Hz, %zu samples, %zu edges\n", rate, size, nref);
+	printf("scalar: %8.2f ns/sample\n", tref * 1e9 / size / rounds);
+	printf("block:  %8.2f ns/sample (%.1fx)\n",
+	       tgot * 1e9 / size / rounds, tgot > 0 ? tref / tgot : 0);
+	if (nref != ngot) {
+		printf("MISMATCH: %zu vs %zu edges\n", nref, ngot);
+		return 1;
+	}
+	for (i = 0; i < nref; i++) {
+		if (ref[i] != got[i]) {
+			printf("MISMATCH at edge %zu: %u vs %u\n",
+			       i, (unsigned)ref[i], (unsigned)got[i]);
+			return 1;
+		}
+	}
+	printf("edges identical\n");
+	return 0;
+}
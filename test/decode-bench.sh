@@ -0,0 +1,91 @@
+#!/bin/bash
+#
+# Measure decode latency against the number of remotes in lircd.conf.
+#
+# For each count N, a config is built with N - 1 filler remotes followed
+# by the target remote (manual_sort keeps this order, so decode_all()
+# reaches the target last). The target's keys are simulated using
+# irsimsend and decoded again using irsimreceive; the cpu time per
+# decoded key is reported (wall time is dominated by the file driver
+# sleeping at EOF).
+#
+# Usage: decode-bench.sh [-t target.conf] [-r rounds] [counts...]
+#
+# Run from the top of a built source tree. The filler remotes are
+# synthetic NEC-style remotes with distinct header timings.
+
+TOP=$(pwd)
+TARGET=$TOP/remotes/animax/lircd.conf.animax
+COUNTS="1 5 10 20 40 80"
+ROUNDS=20
+
+while getopts "t:r:" opt; do
+    case $opt in
+        t) TARGET=$(readlink -f $OPTARG) ;;
+        r) ROUNDS=$OPTARG ;;
+        *) echo "Usage: $0 [-t target.conf] [-r rounds] [counts...]"
+           exit 1 ;;
+    esac
+done
+shift $(( OPTIND - 1 ))
+test -n "$*" && COUNTS="$*"
+
+export LD_LIBRARY_PATH=$TOP/lib/.libs
+export LIRC_PLUGIN_PATH=$TOP/plugins/.libs
+
+WORK=$(mktemp -d /tmp/decode-bench.XXXXXX)
+trap "rm -rf $WORK" EXIT
+cd $WORK
+
+
+function filler()
+# Print a filler remote with header pulse derived from $1
+{
+    local head=$(( 2000 + 250 * $1 ))
+    cat << EOF
+begin remote
+  name          filler_$1
+  bits          16
+  flags         SPACE_ENC|CONST_LENGTH
+  eps           30
+  aeps          100
+  header        $head  $(( head / 2 ))
+  one           560  1690
+  zero          560  560
+  ptrail        560
+  pre_data_bits 16
+  pre_data      0x$(printf "%04x" $1)
+  gap           108000
+  manual_sort   1
+  begin codes
+    KEY_1       0x00FF
+    KEY_2       0x807F
+    KEY_3       0x40BF
+  end codes
+end remote
+
+EOF
+}
+
+
+$TOP/tools/irsimsend -c 2 $TARGET > /dev/null || exit 1
+for (( i = 0; i < ROUNDS; i++ )); do
+    cat simsend.out
+done > durations
+
+TIMEFORMAT="%3U %3S"
+printf "%8s %10s %14s\n" remotes "cpu [ms]" "per key [us]"
+for n in $COUNTS; do
+    : > lircd.conf
+    for (( i = 1; i < n; i++ )); do
+        filler $i >> lircd.conf
+    done
+    cat $TARGET >> lircd.conf
+    cpu=$( { time $TOP/tools/irsimreceive lircd.conf durations \
+                 > decoded 2>/dev/null; } 2>&1 )
+    decoded=$(grep -vc "__EOF" decoded)
+    usec=$(echo $cpu | awk '{ print int(($1 + $2) * 1000000) }')
+    printf "%8d %10d %14d\n" $n $(( usec / 1000 )) \
+        $(( usec / (decoded > 0 ? decoded : 1) ))
+done
+echo "($decoded keys decoded per run)"
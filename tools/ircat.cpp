@@ -58,6 +58,7 @@ int main(int argc, char* argv[])
 {
 	struct lirc_config* config;
 	char* config_file = NULL;
+	int fd;
 
 	while (1) {
 		int c;
@@ -91,22 +92,24 @@ int main(int argc, char* argv[])
 		return EXIT_FAILURE;
 	}
 
-	if (lirc_init(argv[argc - 1], 1) == -1)
+	fd = lirc_init(argv[argc - 1], 1);
+	if (fd == -1)
 		exit(EXIT_FAILURE);
 
 	if (lirc_readconfig(config_file, &config, NULL) == 0) {
-		char* code;
+		lirc_code_ctx ctx;
+		struct lirc_code_event event;
 		char* c;
 		int ret;
 
-		while (lirc_nextcode(&code) == 0) {
-			if (code == NULL)
+		lirc_code_start(&ctx, fd);
+		while ((ret = lirc_code_read(&ctx, &event)) >= 0) {
+			if (ret == 0)
 				continue;
-			while ((ret = lirc_code2char(config, code, &c)) == 0 && c != NULL) {
+			while ((ret = lirc_code2char(config, event.line, &c)) == 0 && c != NULL) {
 				printf("%s\n", c);
 				fflush(stdout);
 			}
-			free(code);
 			if (ret == -1)
 				break;
 		}
@@ -93,21 +93,22 @@ static void run_command(const char* cmd)
 
 
 /** Get buttonclick messages from lircd socket and process them. */
-static void process_input(struct lirc_config* config)
+static void process_input(struct lirc_config* config, int fd)
 {
-	char* code;
+	lirc_code_ctx ctx;
+	struct lirc_code_event event;
 	char* c;
 	int r;
 
-	while (lirc_nextcode(&code) == 0) {
-		if (code == NULL)
+	lirc_code_start(&ctx, fd);
+	while ((r = lirc_code_read(&ctx, &event)) >= 0) {
+		if (r == 0)
 			continue;
-		r = lirc_code2char(config, code, &c);
+		r = lirc_code2char(config, event.line, &c);
 		while (r == 0 && c != NULL) {
 			run_command(c);
-			r = lirc_code2char(config, code, &c);
+			r = lirc_code2char(config, event.line, &c);
 		}
-		free(code);
 		if (r == -1)
 			break;
 	}
@@ -117,6 +118,7 @@ static void process_input(struct lirc_config* config)
 int irexec(const char* configfile)
 {
 	struct lirc_config* config;
+	int fd;
 
 	if (opt_daemonize) {
 		if (daemon(0, 0) == -1) {
@@ -133,9 +135,10 @@ int irexec(const char* configfile)
 	lirc_log_set_file(path);
 	lirc_log_open("irexec", 1, opt_loglevel);
 
-	if (lirc_init(opt_progname, opt_daemonize ? 0 : 1) == -1)
+	fd = lirc_init(opt_progname, opt_daemonize ? 0 : 1);
+	if (fd == -1)
 		return EXIT_FAILURE;
-	process_input(config);
+	process_input(config, fd);
 	lirc_deinit();
 
 	lirc_freeconfig(config);
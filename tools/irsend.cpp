@@ -26,7 +26,10 @@
 
 #include <getopt.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
+#include <sys/time.h>
 
 #include "lirc_log.h"
 #include "lirc_client.h"
@@ -39,15 +42,25 @@ static const char* const help =
 	"    irsend [options] LIST remote\n"
 	"    irsend [options] SET_TRANSMITTERS remote num [num...]\n"
 	"    irsend [options] SIMULATE \"scancode repeat keysym remote\"\n"
+	"    irsend [options] --batch=file\n"
 	"Options:\n"
 	"    -h --help\t\t\tdisplay usage summary\n"
 	"    -v --version\t\tdisplay version\n"
 	"    -d --device\t\t\tuse given lircd socket [" LIRCD "]\n"
 	"    -a --address=host[:port]\tconnect to lircd at this address\n"
-	"    -# --count=n\t\tsend command n times\n";
+	"    -# --count=n\t\tsend command n times\n"
+	"    -b --batch=file\t\tpipeline SEND_* commands from file, - for stdin\n";
 
 const char* prog;
 
+/** A command read from a --batch file. */
+struct batch_cmd {
+	lirc_cmd_ctx	ctx;    /**< The command, must be first. */
+	int		line;   /**< Line number in file. */
+	int		status; /**< Status from lircd. */
+	int		done;   /**< True when the reply is received. */
+};
+
 int send_packet(lirc_cmd_ctx* ctx, int fd)
 {
 	int r;
@@ -81,7 +94,176 @@ void reformat_simarg(char* code, char buffer[])
 }
 
 
+/**
+ * Parse a batch line like "SEND_ONCE remote code [count]" into cmd.
+ * Return 1 if a command is stored, 0 for empty lines, else -1.
+ */
+static int parse_batch_line(char* line, struct batch_cmd* cmd,
+			    unsigned long count)
+{
+	static const char* const WS = " \t\r\n";
+	char* directive;
+	char* remote;
+	char* code;
+	char* reps;
+	char* end;
+	int r;
+
+	directive = strtok(line, WS);
+	if (directive == NULL || directive[0] == '#')
+		return 0;
+	if (strcasecmp(directive, "SEND_ONCE") != 0
+	    && strcasecmp(directive, "SEND_START") != 0
+	    && strcasecmp(directive, "SEND_STOP") != 0) {
+		fprintf(stderr, "%s: unsupported batch directive: %s\n",
+			prog, directive);
+		return -1;
+	}
+	remote = strtok(NULL, WS);
+	code = strtok(NULL, WS);
+	reps = strtok(NULL, WS);
+	if (code == NULL || strtok(NULL, WS) != NULL) {
+		fprintf(stderr, "%s: invalid argument count\n", prog);
+		return -1;
+	}
+	if (reps != NULL) {
+		strtoul(reps, &end, 10);
+		if (strcasecmp(directive, "SEND_ONCE") != 0 || *end) {
+			fprintf(stderr, "%s: invalid count value: %s\n",
+				prog, reps);
+			return -1;
+		}
+		r = lirc_command_init(&cmd->ctx, "%s %s %s %s\n",
+				      directive, remote, code, reps);
+	} else if (strcasecmp(directive, "SEND_ONCE") == 0 && count > 1) {
+		r = lirc_command_init(&cmd->ctx, "%s %s %s %lu\n",
+				      directive, remote, code, count);
+	} else {
+		r = lirc_command_init(&cmd->ctx, "%s %s %s\n",
+				      directive, remote, code);
+	}
+	if (r != 0) {
+		fprintf(stderr, "%s: input too long\n", prog);
+		return -1;
+	}
+	cmd->status = 0;
+	cmd->done = 0;
+	return 1;
+}
+
+
+/** Read all commands in a batch file, exit on errors. */
+static struct batch_cmd* read_batch(const char* path, unsigned long count,
+				    int* size)
+{
+	struct batch_cmd* cmds = NULL;
+	struct batch_cmd* p;
+	char buffer[PACKET_SIZE + 1];
+	FILE* f;
+	int line = 0;
+	int n = 0;
+	int r;
+
+	f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+	if (f == NULL) {
+		fprintf(stderr, "%s: cannot open %s: %s\n",
+			prog, path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	while (fgets(buffer, sizeof(buffer), f) != NULL) {
+		line++;
+		p = (struct batch_cmd*)realloc(cmds, (n + 1) * sizeof(*cmds));
+		if (p == NULL) {
+			fprintf(stderr, "%s: out of memory\n", prog);
+			exit(EXIT_FAILURE);
+		}
+		cmds = p;
+		r = parse_batch_line(buffer, &cmds[n], count);
+		if (r == -1) {
+			fprintf(stderr, "%s: %s:%d: bad command\n",
+				prog, path, line);
+			exit(EXIT_FAILURE);
+		}
+		if (r == 1)
+			cmds[n++].line = line;
+	}
+	if (f != stdin)
+		fclose(f);
+	*size = n;
+	return cmds;
+}
+
+
+/**
+ * Pipeline all commands on fd, then report the replies in input
+ * order, and the total time used.
+ */
+static int run_batch(int fd, struct batch_cmd* cmds, int n)
+{
+	lirc_cmd_pipe conn;
+	lirc_cmd_ctx* ctx;
+	struct batch_cmd* cmd;
+	struct pollfd pfd;
+	struct timeval start;
+	struct timeval end;
+	int submitted = 0;
+	int printed = 0;
+	int failed = 0;
+	int status;
+	int r;
 
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	gettimeofday(&start, NULL);
+	lirc_command_pipe(&conn, fd);
+	while (printed < n) {
+		while (submitted < n
+		       && lirc_command_submit(&conn, &cmds[submitted].ctx) == 0)
+			submitted++;
+		pfd.fd = fd;
+		pfd.events = lirc_command_events(&conn);
+		if (poll(&pfd, 1, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			perror(prog);
+			return EXIT_FAILURE;
+		}
+		if (pfd.revents & POLLOUT) {
+			r = lirc_command_flush(&conn);
+			if (r != 0) {
+				fprintf(stderr, "%s: %s\n", prog, strerror(r));
+				return EXIT_FAILURE;
+			}
+		}
+		if (!(pfd.revents & (POLLIN | POLLHUP | POLLERR)))
+			continue;
+		while ((r = lirc_command_reply(&conn, &ctx, &status)) == 1) {
+			cmd = (struct batch_cmd*)ctx;
+			cmd->status = status;
+			cmd->done = 1;
+		}
+		if (r == -1) {
+			fprintf(stderr, "%s: lost connection to lircd: %s\n",
+				prog, strerror(errno));
+			return EXIT_FAILURE;
+		}
+		for (; printed < n && cmds[printed].done; printed++) {
+			cmd = &cmds[printed];
+			if (cmd->status == 0) {
+				printf("%d: ok: %s", cmd->line, cmd->ctx.packet);
+				continue;
+			}
+			failed++;
+			printf("%d: error: %s", cmd->line, cmd->ctx.packet);
+			if (cmd->ctx.reply[0] != '\0')
+				printf("%d: %s\n", cmd->line, cmd->ctx.reply);
+		}
+	}
+	gettimeofday(&end, NULL);
+	printf("%d commands, %d failed, %.1f ms\n", n, failed,
+	       (end.tv_sec - start.tv_sec) * 1000.0
+	       + (end.tv_usec - start.tv_usec) / 1000.0);
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
 
 
 int main(int argc, char** argv)
@@ -90,6 +272,9 @@ int main(int argc, char** argv)
 	char* remote;
 	char* code;
 	const char* lircd = NULL;
+	const char* batch = NULL;
+	struct batch_cmd* cmds = NULL;
+	int ncmds = 0;
 	char* address = NULL;
 	unsigned short port = LIRC_INET_PORT;
 	unsigned long count = 1;
@@ -108,9 +293,10 @@ int main(int argc, char** argv)
 			{ "device",  required_argument, NULL, 'd' },
 			{ "address", required_argument, NULL, 'a' },
 			{ "count",   required_argument, NULL, '#' },
+			{ "batch",   required_argument, NULL, 'b' },
 			{ 0,	     0,			0,    0	  }
 		};
-		c = getopt_long(argc, argv, "hvd:a:#:", long_options, NULL);
+		c = getopt_long(argc, argv, "hvd:a:#:b:", long_options, NULL);
 		if (c == -1)
 			break;
 		switch (c) {
@@ -157,11 +343,20 @@ int main(int argc, char** argv)
 			}
 			break;
 		}
+		case 'b':
+			batch = optarg;
+			break;
 		default:
 			return EXIT_FAILURE;
 		}
 	}
-	if (optind + 2 > argc) {
+	if (batch != NULL) {
+		if (optind != argc) {
+			fprintf(stderr, "%s: invalid argument count\n", prog);
+			return EXIT_FAILURE;
+		}
+		cmds = read_batch(batch, count, &ncmds);
+	} else if (optind + 2 > argc) {
 		fprintf(stderr, "%s: not enough arguments\n", prog);
 		return EXIT_FAILURE;
 	}
@@ -182,6 +377,13 @@ int main(int argc, char** argv)
 		free(address);
 	address = NULL;
 
+	if (batch != NULL) {
+		r = run_batch(fd, cmds, ncmds);
+		free(cmds);
+		close(fd);
+		return r;
+	}
+
 	directive = argv[optind++];
 
 	if (strcasecmp(directive, "set_transmitters") == 0) {